@@ -0,0 +1,154 @@
+// ==============================================================================
+//                            Batch Lookup Benchmark
+// ==============================================================================
+//
+// Description: Compares resolving a shuffled batch of keys one htable_get call
+// at a time against htable_get_many, which hashes the batch first and prefetches
+// the buckets and first nodes so the cache misses overlap. Run with an optional
+// key count, the table should be well beyond the last level cache for the
+// prefetching to pay off.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "htable.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// --- Helpers --- //
+
+static unsigned long hash_ulong (const void *key) {
+    // SplitMix64 finalizer.
+    unsigned long long x = *(const unsigned long *) key;
+    x = (x ^ (x >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27U)) * 0x94D049BB133111EBULL;
+    return (unsigned long) (x ^ (x >> 31U));
+}
+
+static int compare_ulong (const void *key1, const void *key2) {
+    return *(const unsigned long *) key1 == *(const unsigned long *) key2;
+}
+
+static double now_sec (void) {
+    struct timespec ts;
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ULL;
+
+static unsigned long long rng_next (void) {
+    // xorshift64*
+    rng_state ^= rng_state >> 12U;
+    rng_state ^= rng_state << 25U;
+    rng_state ^= rng_state >> 27U;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+// --- Benchmark --- //
+
+static void run (const char *name, enum htable_engine engine, const unsigned long *keys, const void **queries, void **values, size_t n) {
+
+    struct htable_opts opts = { .engine = engine, .flags = HTABLE_SLAB };
+    htable_t *map = htable_create_ex(n, hash_ulong, compare_ulong, NULL, &opts);
+
+    if (map == NULL) {
+        (void) fprintf(stderr, "%s: allocation failed\n", name);
+        return;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        (void) htable_insert(map, &keys[i], &keys[i]);
+    }
+
+    // Scalar loop, every lookup waits for its own bucket and node misses.
+    size_t found = 0;
+    double start = now_sec();
+
+    for (size_t i = 0; i < n; i++) {
+        found += htable_get(map, queries[i]) != NULL;
+    }
+
+    const double scalar = now_sec() - start;
+
+    // Batched lookups.
+    start = now_sec();
+    found += htable_get_many(map, queries, n, values);
+
+    const double batch = now_sec() - start;
+
+    (void) printf("%-12s scalar %7.1f ns/op   get_many %7.1f ns/op   speedup %.2fx   (%zu hits)\n",
+        name, scalar * 1e9 / (double) n, batch * 1e9 / (double) n, scalar / batch, found);
+
+    htable_destroy(map);
+}
+
+int main (int argc, char **argv) {
+
+    size_t n = 1U << 22U;
+
+    // Accepts the --max option of the benchmark suite, so both can share BENCH_ARGS.
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--max") == 0) {
+            n = strtoul(argv[i + 1], NULL, 10);
+        }
+    }
+
+    unsigned long *keys = malloc(n * sizeof(*keys));
+    const void **queries = malloc(n * sizeof(*queries));
+    void **values = malloc(n * sizeof(*values));
+
+    if (n == 0 || keys == NULL || queries == NULL || values == NULL) {
+        (void) fprintf(stderr, "usage: %s [--max keys]\n", argv[0]);
+        return 1;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        keys[i] = rng_next();
+        queries[i] = &keys[i];
+    }
+
+    // Shuffle the queries so consecutive lookups touch unrelated buckets.
+    for (size_t i = n - 1; i > 0; i--) {
+        const size_t j = (size_t) (rng_next() % (i + 1));
+        const void *tmp = queries[i];
+        queries[i] = queries[j];
+        queries[j] = tmp;
+    }
+
+    (void) printf("%zu keys, batches of %u\n", n, HTABLE_BATCH_SIZE);
+
+    run("chain", HTABLE_ENGINE_CHAIN, keys, queries, values, n);
+    run("robin_hood", HTABLE_ENGINE_ROBIN_HOOD, keys, queries, values, n);
+    run("swiss", HTABLE_ENGINE_SWISS, keys, queries, values, n);
+
+    free(keys);
+    free(queries);
+    free(values);
+
+    return 0;
+}
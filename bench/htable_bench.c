@@ -0,0 +1,496 @@
+// ==============================================================================
+//                          Hash table Benchmark Suite
+// ==============================================================================
+//
+// Description: Benchmark driver covering inserts, hit and miss lookups,
+// removals, a mixed workload and churn for every engine, over integer and string
+// keys drawn uniformly or from a Zipfian distribution. Each run reports
+// throughput, p50/p99/p999 latency of a sample of the operations and the heap
+// bytes per entry after the table has been filled.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+//
+// Usage: htable_bench [--min N] [--max N] [--engine NAME] [--keys int|string] [--dist uniform|zipf]
+//
+// Key counts run from --min to --max in steps of ten (1K to 1M by default, up to 100M and beyond when
+// requested). Latencies are measured on every LATENCY_SAMPLE-th operation only, so the clock overhead
+// does not dominate the throughput numbers, and the median cost of reading the clock is subtracted.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "htable.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__GLIBC__)
+    #include <malloc.h>
+#endif
+
+// --- Macros --- //
+
+#define LATENCY_SAMPLE 16U      // Every n-th operation is timed individually.
+#define HIST_SUB_BITS 4U        // Sub-buckets per power of two of the latency histogram.
+#define HIST_BUCKETS (64U << HIST_SUB_BITS)
+#define ZIPF_THETA 0.99         // Skew of the Zipfian distribution, as used by YCSB.
+#define STRING_KEY_LEN 32U      // Bytes reserved per string key, including the terminator.
+
+// --- Structures --- //
+
+/// @brief Engine configuration under test.
+struct bench_engine {
+    const char *name;
+    struct htable_opts opts;
+};
+
+/// @brief Latency histogram with logarithmic buckets of HIST_SUB_BITS precision.
+struct histogram {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+};
+
+/// @brief Key set of a run, both hits and misses.
+struct key_set {
+    const void **hits;      // Keys inserted into the table.
+    const void **misses;    // Keys never inserted.
+    void *storage;          // Backing memory of the keys.
+    size_t n;               // Number of keys in each set.
+};
+
+/// @brief Zipfian generator state (Gray et al., "Quickly generating billion-record synthetic databases").
+struct zipf {
+    size_t n;
+    double theta;
+    double alpha;
+    double zetan;
+    double eta;
+};
+
+static const struct bench_engine engines[] = {
+    { "chain", { .engine = HTABLE_ENGINE_CHAIN } },
+    { "chain_slab", { .engine = HTABLE_ENGINE_CHAIN, .flags = HTABLE_SLAB | HTABLE_POW2 | HTABLE_MIX_HASH } },
+    { "robin_hood", { .engine = HTABLE_ENGINE_ROBIN_HOOD } },
+    { "swiss", { .engine = HTABLE_ENGINE_SWISS } },
+    { "compact", { .engine = HTABLE_ENGINE_COMPACT } },
+};
+
+// --- Hash functions for integer and string keys --- //
+
+static unsigned long hash_u64 (const void *key) {
+    // SplitMix64 finalizer.
+    uint64_t x = *(const uint64_t *) key;
+    x = (x ^ (x >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27U)) * 0x94D049BB133111EBULL;
+    return (unsigned long) (x ^ (x >> 31U));
+}
+
+static int compare_u64 (const void *key1, const void *key2) {
+    return *(const uint64_t *) key1 == *(const uint64_t *) key2;
+}
+
+static unsigned long hash_str (const void *key) {
+    // FNV-1a.
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (const unsigned char *str = key; *str; str++) {
+        hash = (hash ^ *str) * 0x100000001B3ULL;
+    }
+    return (unsigned long) hash;
+}
+
+static int compare_str (const void *key1, const void *key2) {
+    return strcmp(key1, key2) == 0;
+}
+
+// --- Helpers --- //
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rng_next (void) {
+    // xorshift64*
+    rng_state ^= rng_state >> 12U;
+    rng_state ^= rng_state << 25U;
+    rng_state ^= rng_state >> 27U;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static double rng_unit (void) {
+    return (double) (rng_next() >> 11U) * (1.0 / 9007199254740992.0);
+}
+
+static uint64_t now_ns (void) {
+    struct timespec ts;
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/// @brief Bytes currently allocated from the heap, 0 if unknown.
+static size_t heap_bytes (void) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    const struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+static void zipf_init (struct zipf *zipf, size_t n, double theta) {
+
+    double zeta2 = 0.0;
+
+    zipf->n = n;
+    zipf->theta = theta;
+    zipf->zetan = 0.0;
+
+    for (size_t i = 1; i <= n; i++) {
+        zipf->zetan += 1.0 / pow((double) i, theta);
+        zeta2 += i <= 2 ? 1.0 / pow((double) i, theta) : 0.0;
+    }
+
+    zipf->alpha = 1.0 / (1.0 - theta);
+    zipf->eta = (1.0 - pow(2.0 / (double) n, 1.0 - theta)) / (1.0 - zeta2 / zipf->zetan);
+}
+
+static size_t zipf_next (const struct zipf *zipf) {
+
+    const double u = rng_unit();
+    const double uz = u * zipf->zetan;
+
+    if (uz < 1.0) {
+        return 0;
+    }
+
+    if (uz < 1.0 + pow(0.5, zipf->theta)) {
+        return zipf->n > 1 ? 1 : 0;
+    }
+
+    const size_t rank = (size_t) ((double) zipf->n * pow(zipf->eta * u - zipf->eta + 1.0, zipf->alpha));
+
+    return rank < zipf->n ? rank : zipf->n - 1U;
+}
+
+/// @brief Median cost of reading the clock twice, subtracted from every sampled latency.
+static uint64_t timer_overhead;
+
+static void hist_record (struct histogram *hist, uint64_t ns) {
+
+    ns = ns > timer_overhead ? ns - timer_overhead : 0U;
+
+    size_t idx = (size_t) ns;
+
+    // Values below 2^HIST_SUB_BITS are exact, larger ones keep HIST_SUB_BITS bits of mantissa.
+    if (ns >= (1U << HIST_SUB_BITS)) {
+        unsigned int exp = 63U - (unsigned int) __builtin_clzll(ns);
+        idx = ((exp - HIST_SUB_BITS + 1U) << HIST_SUB_BITS) + (size_t) ((ns >> (exp - HIST_SUB_BITS)) & ((1U << HIST_SUB_BITS) - 1U));
+    }
+
+    hist->counts[idx < HIST_BUCKETS ? idx : HIST_BUCKETS - 1U]++;
+    hist->total++;
+}
+
+static uint64_t hist_value (size_t idx) {
+
+    if (idx < (1U << HIST_SUB_BITS)) {
+        return idx;
+    }
+
+    const unsigned int exp = (unsigned int) (idx >> HIST_SUB_BITS) + HIST_SUB_BITS - 1U;
+    const uint64_t mantissa = (1U << HIST_SUB_BITS) | (idx & ((1U << HIST_SUB_BITS) - 1U));
+
+    return mantissa << (exp - HIST_SUB_BITS);
+}
+
+static uint64_t hist_percentile (const struct histogram *hist, double pct) {
+
+    const uint64_t target = (uint64_t) ceil(pct * (double) hist->total);
+    uint64_t seen = 0;
+
+    for (size_t idx = 0; idx < HIST_BUCKETS; idx++) {
+        seen += hist->counts[idx];
+        if (seen >= target && hist->counts[idx] != 0) {
+            return hist_value(idx);
+        }
+    }
+
+    return 0;
+}
+
+static void calibrate_timer (void) {
+
+    static struct histogram hist;
+
+    for (int i = 0; i < 100000; i++) {
+        const uint64_t start = now_ns();
+        hist_record(&hist, now_ns() - start);
+    }
+
+    timer_overhead = hist_percentile(&hist, 0.50);
+}
+
+// --- Key generation --- //
+
+static int keys_create (struct key_set *set, size_t n, int strings) {
+
+    const size_t stride = strings ? STRING_KEY_LEN : sizeof(uint64_t);
+
+    set->n = n;
+    set->hits = malloc(n * sizeof(*set->hits));
+    set->misses = malloc(n * sizeof(*set->misses));
+    set->storage = malloc(2U * n * stride);
+
+    if (set->hits == NULL || set->misses == NULL || set->storage == NULL) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < 2U * n; i++) {
+
+        char *slot = (char *) set->storage + i * stride;
+
+        // Odd values are inserted and even values are misses, so the two sets never overlap.
+        const uint64_t value = (rng_next() & ~1ULL) | (i < n ? 1U : 0U);
+
+        if (strings) {
+            (void) snprintf(slot, STRING_KEY_LEN, "session:%016llx", (unsigned long long) value);
+        } else {
+            memcpy(slot, &value, sizeof(value));
+        }
+
+        if (i < n) {
+            set->hits[i] = slot;
+        } else {
+            set->misses[i - n] = slot;
+        }
+    }
+
+    return 0;
+}
+
+static void keys_destroy (struct key_set *set) {
+    free(set->hits);
+    free(set->misses);
+    free(set->storage);
+}
+
+// --- Workloads --- //
+
+enum workload { INSERT, HIT, MISS, REMOVE, MIXED, CHURN, WORKLOADS };
+
+static const char *const workload_names[WORKLOADS] = { "insert", "hit", "miss", "remove", "mixed", "churn" };
+
+/// @brief Draw a key index according to the distribution of the run.
+static size_t draw (const struct zipf *zipf, size_t n) {
+    return zipf != NULL ? zipf_next(zipf) : (size_t) (rng_next() % n);
+}
+
+/// @brief Execute one operation of a workload.
+static void run_op (htable_t *map, const struct key_set *set, const struct zipf *zipf, enum workload workload, size_t i, size_t *churn) {
+
+    const size_t n = set->n;
+    volatile void *sink;
+
+    switch (workload) {
+        case INSERT:
+            (void) htable_insert(map, set->hits[i], set->hits[i]);
+            break;
+        case HIT:
+            sink = htable_get(map, set->hits[draw(zipf, n)]);
+            break;
+        case MISS:
+            sink = htable_get(map, set->misses[draw(zipf, n)]);
+            break;
+        case REMOVE:
+            (void) htable_remove(map, set->hits[i]);
+            break;
+        case MIXED: {
+            // 80% lookups, 15% overwrites, 5% remove and reinsert.
+            const size_t key = draw(zipf, n);
+            const uint64_t roll = rng_next() % 100U;
+
+            if (roll < 80U) {
+                sink = htable_get(map, set->hits[key]);
+            } else if (roll < 95U) {
+                (void) htable_insert(map, set->hits[key], set->hits[key]);
+            } else {
+                (void) htable_remove(map, set->hits[key]);
+                (void) htable_insert(map, set->hits[key], set->hits[key]);
+            }
+            break;
+        }
+        case CHURN: {
+            // Steady state: swap a resident key for one of the misses and back again.
+            const size_t key = (*churn)++ % n;
+            const void *const *from = (*churn / n) % 2U == 0 ? set->hits : set->misses;
+            const void *const *to = from == set->hits ? set->misses : set->hits;
+
+            (void) htable_remove(map, from[key]);
+            (void) htable_insert(map, to[key], to[key]);
+            break;
+        }
+        default:
+            break;
+    }
+
+    (void) sink;
+}
+
+static void report (const char *engine, const char *keys, const char *dist, size_t n, enum workload workload, uint64_t elapsed, const struct histogram *hist, double bytes) {
+
+    (void) printf("%-11s %-7s %-8s %10zu %-7s %9.2f Mops/s  p50 %6llu  p99 %6llu  p999 %7llu ns",
+        engine, keys, dist, n, workload_names[workload], (double) n * 1e3 / (double) (elapsed ? elapsed : 1U),
+        (unsigned long long) hist_percentile(hist, 0.50), (unsigned long long) hist_percentile(hist, 0.99),
+        (unsigned long long) hist_percentile(hist, 0.999));
+
+    if (bytes > 0.0) {
+        (void) printf("  %6.1f B/entry", bytes);
+    }
+
+    (void) puts("");
+}
+
+static void run (const struct bench_engine *engine, int strings, int zipfian, size_t n) {
+
+    struct key_set set;
+    struct zipf zipf;
+
+    if (keys_create(&set, n, strings) != 0) {
+        (void) fprintf(stderr, "%zu keys: allocation failed\n", n);
+        keys_destroy(&set);
+        return;
+    }
+
+    if (zipfian) {
+        zipf_init(&zipf, n, ZIPF_THETA);
+    }
+
+    const size_t heap_before = heap_bytes();
+
+    htable_t *map = htable_create_ex(16, strings ? hash_str : hash_u64, strings ? compare_str : compare_u64, NULL, &engine->opts);
+
+    static struct histogram hist;
+    size_t churn = 0;
+
+    for (enum workload workload = INSERT; workload < WORKLOADS; workload++) {
+
+        // Removal empties the table, refill it for the workloads that follow.
+        if (workload == MIXED) {
+            for (size_t i = 0; i < n; i++) {
+                (void) htable_insert(map, set.hits[i], set.hits[i]);
+            }
+        }
+
+        memset(&hist, 0, sizeof(hist));
+
+        const uint64_t start = now_ns();
+
+        for (size_t i = 0; i < n; i++) {
+
+            if (i % LATENCY_SAMPLE != 0) {
+                run_op(map, &set, zipfian ? &zipf : NULL, workload, i, &churn);
+                continue;
+            }
+
+            const uint64_t op_start = now_ns();
+            run_op(map, &set, zipfian ? &zipf : NULL, workload, i, &churn);
+            hist_record(&hist, now_ns() - op_start);
+        }
+
+        const uint64_t elapsed = now_ns() - start;
+
+        // Heap growth caused by the table only, the keys were allocated up front.
+        const size_t heap_after = workload == INSERT ? heap_bytes() : 0;
+        const double bytes = heap_after > heap_before ? (double) (heap_after - heap_before) / (double) n : 0.0;
+
+        report(engine->name, strings ? "string" : "int", zipfian ? "zipf" : "uniform", n, workload, elapsed, &hist, bytes);
+    }
+
+    htable_destroy(map);
+    keys_destroy(&set);
+}
+
+// --- Main function to run the benchmarks --- //
+
+int main (int argc, char **argv) {
+
+    size_t min_keys = 1000;
+    size_t max_keys = 1000000;
+    const char *engine = NULL;
+    const char *keys = NULL;
+    const char *dist = NULL;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--min") == 0) {
+            min_keys = strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "--max") == 0) {
+            max_keys = strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "--engine") == 0) {
+            engine = argv[i + 1];
+        } else if (strcmp(argv[i], "--keys") == 0) {
+            keys = argv[i + 1];
+        } else if (strcmp(argv[i], "--dist") == 0) {
+            dist = argv[i + 1];
+        } else {
+            (void) fprintf(stderr, "usage: %s [--min N] [--max N] [--engine NAME] [--keys int|string] [--dist uniform|zipf]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (min_keys == 0 || max_keys < min_keys) {
+        (void) fprintf(stderr, "invalid key range\n");
+        return 1;
+    }
+
+    calibrate_timer();
+
+    (void) printf("%-11s %-7s %-8s %10s %-7s %16s  latency sampled 1/%u, %llu ns timer overhead subtracted\n",
+        "engine", "keys", "dist", "n", "op", "throughput", LATENCY_SAMPLE, (unsigned long long) timer_overhead);
+
+    for (size_t n = min_keys; n <= max_keys; n *= 10U) {
+        for (size_t e = 0; e < sizeof(engines) / sizeof(*engines); e++) {
+
+            if (engine != NULL && strcmp(engine, engines[e].name) != 0) {
+                continue;
+            }
+
+            for (int strings = 0; strings <= 1; strings++) {
+
+                if (keys != NULL && strcmp(keys, strings ? "string" : "int") != 0) {
+                    continue;
+                }
+
+                for (int zipfian = 0; zipfian <= 1; zipfian++) {
+
+                    if (dist != NULL && strcmp(dist, zipfian ? "zipf" : "uniform") != 0) {
+                        continue;
+                    }
+
+                    run(&engines[e], strings, zipfian, n);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,156 @@
+// ==============================================================================
+//                           Hash Function Benchmark
+// ==============================================================================
+//
+// Description: Compares the byte-at-a-time djb2 string hash used by the tests
+// against the built-in htable_hash_str at key lengths from 8 to 128 bytes, first
+// as raw hashing cost and then as string-keyed chaining lookups where the hash
+// is part of every get.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "htable.h"
+#include "htable_hash.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define KEYS 65536U
+#define ROUNDS 16U
+
+// --- Helpers --- //
+
+static unsigned long hash_djb2 (const void *key) {
+    const unsigned char *str = key;
+    unsigned long hash = 5381;
+    int c;
+
+    while ((c = *str++)) {
+        hash = ((hash << 5U) + hash) + (unsigned long) c;
+    }
+
+    return hash;
+}
+
+static double now_sec (void) {
+    struct timespec ts;
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ULL;
+
+static unsigned long long rng_next (void) {
+    // xorshift64*
+    rng_state ^= rng_state >> 12U;
+    rng_state ^= rng_state << 25U;
+    rng_state ^= rng_state >> 27U;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+// --- Benchmark --- //
+
+static double time_hash (htable_hash_t hash, char **keys) {
+
+    volatile unsigned long sink = 0;
+    const double start = now_sec();
+
+    for (size_t round = 0; round < ROUNDS; round++) {
+        for (size_t i = 0; i < KEYS; i++) {
+            sink = sink + hash(keys[i]);
+        }
+    }
+
+    return (now_sec() - start) * 1e9 / (double) (KEYS * ROUNDS);
+}
+
+static double time_get (htable_hash_t hash, char **keys) {
+
+    htable_t *map = htable_create(KEYS, hash, htable_keq_str, NULL);
+
+    if (map == NULL) {
+        return 0.0;
+    }
+
+    for (size_t i = 0; i < KEYS; i++) {
+        (void) htable_insert(map, keys[i], keys[i]);
+    }
+
+    size_t found = 0;
+    const double start = now_sec();
+
+    for (size_t round = 0; round < ROUNDS; round++) {
+        for (size_t i = 0; i < KEYS; i++) {
+            found += htable_get(map, keys[i]) != NULL;
+        }
+    }
+
+    const double elapsed = now_sec() - start;
+    htable_destroy(map);
+
+    return found == KEYS * ROUNDS ? elapsed * 1e9 / (double) (KEYS * ROUNDS) : 0.0;
+}
+
+int main (void) {
+
+    static const size_t lengths[] = { 8, 16, 40, 64, 100, 128 };
+    char **keys = malloc(KEYS * sizeof(*keys));
+
+    if (keys == NULL) {
+        return 1;
+    }
+
+    (void) printf("%zu keys, ns per hash and per get\n", (size_t) KEYS);
+
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+
+        const size_t len = lengths[l];
+
+        // Random printable keys with a shared prefix, like the identifiers of a real workload.
+        for (size_t i = 0; i < KEYS; i++) {
+            keys[i] = malloc(len + 1U);
+
+            for (size_t j = 0; j < len; j++) {
+                keys[i][j] = j < len / 2U ? 'k' : (char) ('a' + rng_next() % 26U);
+            }
+
+            keys[i][len] = '\0';
+        }
+
+        (void) printf("len %3zu   djb2 %6.1f / %6.1f   htable_hash_str %6.1f / %6.1f\n", len,
+            time_hash(hash_djb2, keys), time_get(hash_djb2, keys),
+            time_hash(htable_hash_str, keys), time_get(htable_hash_str, keys));
+
+        for (size_t i = 0; i < KEYS; i++) {
+            free(keys[i]);
+        }
+    }
+
+    free(keys);
+
+    return 0;
+}
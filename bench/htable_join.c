@@ -0,0 +1,150 @@
+// ==============================================================================
+//                             Hash Join Benchmark
+// ==============================================================================
+//
+// Description: Probe side of a hash join: a column of keys with precomputed
+// hashes, half of them matching, resolved by a scalar htable_get loop, by
+// htable_probe_batch against one table and by htable_part_probe_batch against a
+// radix-partitioned build.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "htable.h"
+#include "htable_part.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// --- Helpers --- //
+
+static unsigned long hash_ulong (const void *key) {
+    // SplitMix64 finalizer.
+    unsigned long long x = *(const unsigned long *) key;
+    x = (x ^ (x >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27U)) * 0x94D049BB133111EBULL;
+    return (unsigned long) (x ^ (x >> 31U));
+}
+
+static int compare_ulong (const void *key1, const void *key2) {
+    return *(const unsigned long *) key1 == *(const unsigned long *) key2;
+}
+
+static double now_sec (void) {
+    struct timespec ts;
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ULL;
+
+static unsigned long long rng_next (void) {
+    // xorshift64*
+    rng_state ^= rng_state >> 12U;
+    rng_state ^= rng_state << 25U;
+    rng_state ^= rng_state >> 27U;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+// --- Benchmark --- //
+
+int main (int argc, char **argv) {
+
+    size_t n = 1U << 22U;
+
+    // Accepts the --max option of the benchmark suite, so both can share BENCH_ARGS.
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--max") == 0) {
+            n = strtoul(argv[i + 1], NULL, 10);
+        }
+    }
+
+    unsigned long *keys = malloc(2U * n * sizeof(*keys));
+    const void **build = malloc(n * sizeof(*build));
+    const void **probes = malloc(n * sizeof(*probes));
+    unsigned long *hashes = malloc(n * sizeof(*hashes));
+    size_t *sel = malloc(n * sizeof(*sel));
+    void **values = malloc(n * sizeof(*values));
+
+    if (n == 0 || keys == NULL || build == NULL || probes == NULL || hashes == NULL || sel == NULL || values == NULL) {
+        (void) fprintf(stderr, "usage: %s [--max keys]\n", argv[0]);
+        return 1;
+    }
+
+    // The build side holds the first n keys, the probe side draws from all 2n, so about half of it matches.
+    for (size_t i = 0; i < 2U * n; i++) {
+        keys[i] = rng_next();
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        build[i] = &keys[i];
+        probes[i] = &keys[rng_next() % (2U * n)];
+        hashes[i] = hash_ulong(probes[i]);
+    }
+
+    htable_t *map = htable_build(build, build, n, hash_ulong, compare_ulong, NULL, NULL);
+    htable_part_t *part = htable_part_build(build, build, n, hash_ulong, compare_ulong, NULL, NULL, 0);
+
+    if (map == NULL || part == NULL) {
+        (void) fprintf(stderr, "allocation failed\n");
+        return 1;
+    }
+
+    (void) printf("%zu build keys, %zu probes, %zu partitions\n", n, n, part->partitions);
+
+    // Scalar loop, every probe chases its own bucket and node pointers.
+    size_t found = 0;
+    double start = now_sec();
+
+    for (size_t i = 0; i < n; i++) {
+        found += htable_get(map, probes[i]) != NULL;
+    }
+
+    const double scalar = now_sec() - start;
+
+    start = now_sec();
+    const size_t batch_found = htable_probe_batch(map, probes, hashes, n, sel, values);
+    const double batch = now_sec() - start;
+
+    start = now_sec();
+    const size_t part_found = htable_part_probe_batch(part, probes, hashes, n, sel, values);
+    const double partitioned = now_sec() - start;
+
+    (void) printf("scalar %7.1f ns/op   probe_batch %7.1f ns/op   part_probe_batch %7.1f ns/op   (%zu/%zu/%zu hits)\n",
+        scalar * 1e9 / (double) n, batch * 1e9 / (double) n, partitioned * 1e9 / (double) n, found, batch_found, part_found);
+
+    htable_destroy(map);
+    htable_part_destroy(part);
+
+    free(keys);
+    free(build);
+    free(probes);
+    free(hashes);
+    free(sel);
+    free(values);
+
+    return 0;
+}
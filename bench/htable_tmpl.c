@@ -0,0 +1,182 @@
+// ==============================================================================
+//                       Type-specialized Table Benchmark
+// ==============================================================================
+//
+// Description: Compares lookups in an int to int map through the generic void
+// pointer API against a table generated by HTABLE_DEFINE, with the hash and
+// comparison inlined and the keys stored by value.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "htable.h"
+#include "htable_tmpl.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// --- Helpers --- //
+
+static unsigned long hash_int (const void *key) {
+    return (unsigned long) *(const int *) key;
+}
+
+static int compare_int (const void *key1, const void *key2) {
+    return *(const int *) key1 == *(const int *) key2;
+}
+
+static inline unsigned long hash_int_inline (int key) {
+    return (unsigned long) key;
+}
+
+#define EQ_INT(a, b) ((a) == (b))
+
+HTABLE_DEFINE(imap, int, int, hash_int_inline, EQ_INT)
+
+static double now_sec (void) {
+    struct timespec ts;
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ULL;
+
+static unsigned long long rng_next (void) {
+    // xorshift64*
+    rng_state ^= rng_state >> 12U;
+    rng_state ^= rng_state << 25U;
+    rng_state ^= rng_state >> 27U;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+// --- Benchmark --- //
+
+static void run_generic (const char *name, enum htable_engine engine, const int *keys, const int *queries, size_t n, double *best) {
+
+    struct htable_opts opts = { .engine = engine, .flags = HTABLE_SLAB | HTABLE_POW2 | HTABLE_MIX_HASH };
+    htable_t *map = htable_create_ex(n, hash_int, compare_int, NULL, &opts);
+
+    if (map == NULL) {
+        (void) fprintf(stderr, "%s: allocation failed\n", name);
+        return;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        (void) htable_insert(map, &keys[i], &keys[i]);
+    }
+
+    long sum = 0;
+    const double start = now_sec();
+
+    for (size_t i = 0; i < n; i++) {
+        const int *value = htable_get(map, &queries[i]);
+        sum += value != NULL ? *value : 0;
+    }
+
+    const double elapsed = now_sec() - start;
+
+    (void) printf("%-14s %7.1f ns/op   (checksum %ld)\n", name, elapsed * 1e9 / (double) n, sum);
+
+    if (*best == 0 || elapsed < *best) {
+        *best = elapsed;
+    }
+
+    htable_destroy(map);
+}
+
+static double run_tmpl (const int *keys, const int *queries, size_t n) {
+
+    imap_t *map = imap_create(n);
+
+    if (map == NULL) {
+        (void) fprintf(stderr, "imap: allocation failed\n");
+        return 0;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        (void) imap_insert(map, keys[i], keys[i]);
+    }
+
+    long sum = 0;
+    const double start = now_sec();
+
+    for (size_t i = 0; i < n; i++) {
+        const int *value = imap_get(map, queries[i]);
+        sum += value != NULL ? *value : 0;
+    }
+
+    const double elapsed = now_sec() - start;
+
+    (void) printf("%-14s %7.1f ns/op   (checksum %ld)\n", "HTABLE_DEFINE", elapsed * 1e9 / (double) n, sum);
+
+    imap_destroy(map);
+
+    return elapsed;
+}
+
+int main (int argc, char **argv) {
+
+    size_t n = 1U << 20U;
+
+    // Accepts the --max option of the benchmark suite, so all benchmarks can share BENCH_ARGS.
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--max") == 0) {
+            n = strtoul(argv[i + 1], NULL, 10);
+        }
+    }
+
+    int *keys = malloc(n * sizeof(*keys));
+    int *queries = malloc(n * sizeof(*queries));
+
+    if (n == 0 || keys == NULL || queries == NULL) {
+        (void) fprintf(stderr, "usage: %s [--max keys]\n", argv[0]);
+        return 1;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        keys[i] = (int) i;
+        queries[i] = (int) (rng_next() % n);
+    }
+
+    (void) printf("%zu int keys, random hits\n", n);
+
+    double best = 0;
+
+    run_generic("chain", HTABLE_ENGINE_CHAIN, keys, queries, n, &best);
+    run_generic("robin_hood", HTABLE_ENGINE_ROBIN_HOOD, keys, queries, n, &best);
+    run_generic("swiss", HTABLE_ENGINE_SWISS, keys, queries, n, &best);
+
+    const double tmpl = run_tmpl(keys, queries, n);
+
+    if (tmpl > 0) {
+        (void) printf("speedup over the best generic engine %.2fx\n", best / tmpl);
+    }
+
+    free(keys);
+    free(queries);
+
+    return 0;
+}
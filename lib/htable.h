@@ -36,21 +36,90 @@
     // --- Standard Libraries --- //
 
     #include <stddef.h>     // For NULL definition.
+    #include <stdint.h>     // For the 32-bit indices of the compact engine, uint32_t.
     #include <stdlib.h>     // For memory allocation oeprations, e.g. malloc(3), free(3).
 
     // --- TypeDefs --- //
 
     typedef unsigned long (*htable_hash_t)(const void *key);
+    typedef unsigned long (*htable_hash_n_t)(const void *key, size_t len);
+    typedef unsigned long (*htable_seeded_hash_t)(const void *key, unsigned long long seed);
     typedef int (*htable_keq_t)(const void *keyA, const void *keyB);
 
     typedef void *(*htable_cpy_t)(const void *src);
     typedef void (*htable_free_t)(void *src);
+    typedef size_t (*htable_size_t)(const void *src);
+    typedef void (*htable_scan_t)(const void *key, void *value, void *ctx);
+    typedef void (*htable_update_t)(void **value, void *ctx);
+    typedef void (*htable_evict_t)(const void *key, void *value, void *ctx);
+
+    typedef void *(*htable_alloc_t)(void *ctx, size_t size);
+    typedef void (*htable_dealloc_t)(void *ctx, void *ptr, size_t size);
+    typedef void (*htable_release_t)(void *ctx);
+
+    // --- Constants --- //
+
+    /// @brief Default maximum load factor, i.e. the ratio of elements to buckets above which the table grows.
+    #define HTABLE_DEFAULT_MAX_LOAD 1.0f
+
+    /// @brief Default number of objects carved from each chunk of a slab allocator.
+    #define HTABLE_SLAB_CHUNK 1024U
+
+    /// @brief Number of buckets migrated by each operation while the table is being rehashed.
+    #define HTABLE_REHASH_STEP 4U
+
+    /// @brief Number of keys hashed and prefetched ahead of being resolved by the batch operations.
+    #define HTABLE_BATCH_SIZE 16U
+
+    /// @brief Default maximum load factor of the open-addressing engines, which must stay below 1.
+    #define HTABLE_DEFAULT_OA_MAX_LOAD 0.875f
+
+    /// @brief Maximum number of threads hashing the keys of htable_build.
+    #define HTABLE_BUILD_THREADS 8U
+
+    /// @brief Number of keys below which htable_build hashes on the calling thread only.
+    #define HTABLE_BUILD_PARALLEL_MIN 65536U
+
+    /// @brief Number of buckets of the probe length histogram of struct htable_stats.
+    #define HTABLE_STATS_PROBES 16U
+
+    /// @brief Initial capacity of the value array of a key of an HTABLE_MULTI table.
+    #define HTABLE_MULTI_MIN 4U
+
+    /// @brief Largest slot array of the compact engine, so that every slot index plus one fits 32 bits.
+    #define HTABLE_COMPACT_MAX_SIZE ((size_t) 1U << 31U)
+
+    /// @brief Longest time to live accepted by htable_insert_ttl, in milliseconds (about 24.8 days).
+    #define HTABLE_TTL_MAX_MS 0x7FFFFFFFULL
 
     /// @brief Hash node structure.
     struct htable_node {
         void *key;              // The key for the hash node.
         void *value;            // The value for the hash node.
+        unsigned long hash;     // The full hash value of the key, reused by comparisons and rehashing.
         struct htable_node *next; // The next hash node in the linked list.
+        unsigned int key_len;   // The length of a key inserted by htable_insert_n, compared before its bytes.
+        unsigned int ref;       // The CLOCK reference bit, set by hits of a capacity-bounded table.
+        unsigned long long expires; // The millisecond tick the entry expires at, 0 if it never expires.
+        _Alignas(max_align_t) unsigned char data[]; // Inline key and value storage, see struct htable_opts inline_size.
+    };
+
+    /// @brief Open-addressing slot structure, entries are stored inline in the slot array.
+    struct htable_slot {
+        void *key;              // The key for the slot.
+        void *value;            // The value for the slot.
+        unsigned long hash;     // The full hash value of the key.
+        unsigned int dist;      // The probe distance from the home slot plus one, 0 if the slot is empty (Robin Hood), or the
+                                // index of the next slot of the chain plus one, 0 at its end (compact).
+        unsigned int ref;       // The CLOCK reference bit, set by hits of a capacity-bounded table.
+    };
+
+    /// @brief The values of a key of an HTABLE_MULTI table, stored back to back in insertion order.
+    /// It is the value htable_get, htable_take and the iteration functions see for the key.
+    struct htable_values {
+        size_t count;           // The number of values.
+        size_t cap;             // The capacity of the value array.
+        void *items[];          // The values, as copied by vcpy.
     };
 
     struct callbacks {
@@ -58,16 +127,130 @@
         htable_cpy_t vcpy;
         htable_free_t kfree;
         htable_free_t vfree;
+        htable_size_t ksize;    // Optional, size in bytes of a key, required to store keys inline.
+        htable_size_t vsize;    // Optional, size in bytes of a value, required to store values inline.
     };
 
+    /// @brief Memory allocator for the hash nodes of the chaining engine.
+    struct htable_allocator {
+        htable_alloc_t alloc;       // Allocate a hash node, NULL on failure.
+        htable_dealloc_t free;      // Free a single hash node.
+        htable_release_t release;   // Optional, free every hash node at once when the table is destroyed.
+        void *ctx;                  // User context passed to every allocator function.
+    };
+
+    /// @brief Slab allocator carving fixed-size objects out of large chunks.
+    typedef struct htable_slab {
+        size_t obj_size;        // The size of each object, rounded up to the maximum alignment.
+        size_t chunk_objs;      // The number of objects carved from each chunk.
+        void *chunks;           // The allocated chunks, linked through their first word.
+        void *freelist;         // The freed objects, linked through their first word.
+        char *bump;             // The next object of the newest chunk that was never handed out.
+        char *bump_end;         // The end of the newest chunk.
+    } htable_slab_t;
+
+    /// @brief Hash table flags.
+    enum htable_flags {
+        HTABLE_FIXED_SIZE = 1U << 0,    // Never grow the hash table automatically.
+        HTABLE_SLAB = 1U << 1,          // Allocate hash nodes from a slab owned by the hash table.
+        HTABLE_POW2 = 1U << 2,          // Round the bucket count up to a power of two and index with a mask.
+        HTABLE_MIX_HASH = 1U << 3,      // Pass the user hash through the fmix64 finalizer, for weak low bits.
+        HTABLE_UNIQUE_KEYS = 1U << 4,   // The keys given to htable_build are distinct, skip the duplicate check.
+        HTABLE_MULTI = 1U << 5,         // Keep every value of a key in a struct htable_values, chaining engine only.
+    };
+
+    /// @brief Storage engines for the hash table.
+    enum htable_engine {
+        HTABLE_ENGINE_CHAIN = 0,        // Separate chaining with a linked list per bucket.
+        HTABLE_ENGINE_ROBIN_HOOD,       // Open addressing with Robin Hood linear probing.
+        HTABLE_ENGINE_SWISS,            // Open addressing with SIMD matching of one byte control tags.
+        HTABLE_ENGINE_IMAGE,            // Read-only image mapped by htable_open_mmap, not accepted by htable_create_ex.
+        HTABLE_ENGINE_COMPACT,          // Chaining through 32-bit indices into a dense slot array, with 32-bit bucket heads.
+    };
+
+    /// @brief Optional configuration of the hash table, zero-initialized fields select the defaults.
+    struct htable_opts {
+        float max_load;         // The maximum load factor before the table grows, 0 for the default.
+        unsigned flags;         // Bitwise OR of the hash table flags.
+        enum htable_engine engine; // The storage engine of the hash table.
+        const struct htable_allocator *allocator; // The hash node allocator, NULL for malloc(3) or HTABLE_SLAB.
+        size_t inline_size;     // Keys and values up to this many bytes are copied into the hash node, 0 to disable (chaining only).
+        htable_hash_n_t hash_n; // The hash function of the length-aware functions, NULL for htable_hash_bytes keyed by the table seed.
+        size_t capacity;        // The maximum number of entries, inserting beyond it evicts one by CLOCK, 0 for unbounded.
+        htable_evict_t evict;   // Optional, called with every evicted entry before it is freed through the callbacks.
+        void *evict_ctx;        // User context passed to evict.
+        htable_seeded_hash_t seeded_hash; // Optional, hash function keyed by the seed of the table, replaces hash.
+        unsigned long long seed; // The seed passed to seeded_hash, 0 for a random one.
+        size_t max_chain;       // Chains longer than this re-seed the table, 0 to disable (chaining with seeded_hash and the default hash_n only).
+    };
+
+    /// @brief Snapshot of the statistics of a hash table, collected only when built with HTABLE_STATS defined.
+    struct htable_stats {
+        unsigned long long lookups;     // The number of lookups through htable_get and htable_get_many.
+        unsigned long long hits;        // The number of lookups that found their key.
+        unsigned long long misses;      // The number of lookups that did not.
+        unsigned long long searches;    // The number of key searches of every operation, lookups included.
+        unsigned long long keq_calls;   // The number of keq calls made by the searches.
+        unsigned long long probes[HTABLE_STATS_PROBES]; // Searches by nodes, slots or groups examined, the last bucket collects the longer ones.
+        unsigned long long resizes;     // The number of times the table started growing or rebuilt its slots.
+        unsigned long long resize_ns;   // The time spent allocating and migrating during resizes, in nanoseconds.
+        unsigned long long evictions;   // The number of entries evicted by a capacity-bounded table.
+        unsigned long long reseeds;     // The number of times a chain longer than max_chain re-seeded the table.
+        double avg_probes;              // The average number of nodes, slots or groups examined per search.
+        double avg_keq;                 // The average number of keq calls per search.
+    };
+
+    /// @brief Live statistics counters, opaque.
+    struct htable_stats_counters;
+
+    /// @brief Timing wheel of the entries with a time to live, opaque.
+    struct htable_wheel;
+
+    /// @brief Copy-on-write snapshot of a hash table, opaque.
+    typedef struct htable_snapshot htable_snapshot_t;
+
     /// @brief Hash table structure.
     typedef struct hash_map {
         struct htable_node **table; // The hash table.
         size_t size;                // The size of the hash table.
         size_t count;               // The number of elements in the hash table.
         htable_hash_t hash;         // The hash function for the keys.
+        htable_hash_n_t hash_n;     // The hash function for the keys of the length-aware functions.
         htable_keq_t keq;           // The comparison function for the keys.
         struct callbacks cbs;       // The callback functions for the hash table.
+        struct htable_node **rehash_table; // The previous hash table being migrated, NULL if not rehashing.
+        size_t rehash_size;         // The size of the previous hash table.
+        size_t rehash_idx;          // The next bucket of the previous hash table to migrate.
+        int rehash_rekey;           // Non-zero if the previous hash table is hashed with the setup below.
+        htable_hash_t rehash_hash;  // The hash function of the previous hash table.
+        htable_seeded_hash_t rehash_seeded_hash; // The seeded hash function of the previous hash table.
+        unsigned long long rehash_seed; // The seed of the previous hash table.
+        float max_load;             // The maximum load factor before the table grows.
+        unsigned flags;             // The hash table flags.
+        enum htable_engine engine;  // The storage engine of the hash table.
+        struct htable_slot *slots;  // The slot array of the open-addressing engines, NULL for chaining.
+        unsigned char *ctrl;        // The control bytes of the SwissTable engine.
+        size_t tombstones;          // The number of deleted slots of the SwissTable engine.
+        struct htable_allocator alloc; // The allocator of the hash nodes.
+        htable_slab_t *slab;        // The slab owned by the hash table, NULL unless HTABLE_SLAB is set.
+        size_t inline_size;         // The inline storage reserved for each of the key and the value of a hash node.
+        size_t node_size;           // The size of a hash node including its inline storage.
+        const unsigned char *image; // The mapped image of the image engine, NULL otherwise.
+        size_t image_size;          // The size of the mapped image.
+        struct htable_stats_counters *stats; // The statistics counters, NULL unless built with HTABLE_STATS.
+        size_t capacity;            // The maximum number of entries, 0 for unbounded.
+        htable_evict_t evict;       // The eviction notification hook, NULL for none.
+        void *evict_ctx;            // The user context of the eviction hook.
+        size_t clock_hand;          // The next bucket or slot the CLOCK hand examines.
+        size_t clock_depth;         // The position of the CLOCK hand within the chain of its bucket.
+        struct htable_wheel *wheel; // The timing wheel, NULL until the first htable_insert_ttl.
+        htable_snapshot_t *snapshots; // The snapshots still sharing buckets with the table, NULL for none.
+        htable_seeded_hash_t seeded_hash; // The seeded hash function for the keys, NULL to use hash.
+        unsigned long long seed;    // The seed passed to seeded_hash.
+        size_t max_chain;           // The longest chain tolerated before re-seeding, 0 for no limit.
+        size_t reseed_size;         // The table size at the last re-seed, chains are not checked again until it grows.
+        int reseed_pending;         // Non-zero once an insert found a chain longer than max_chain.
+        uint32_t *heads;            // The bucket heads of the compact engine, slot index plus one, 0 for an empty bucket.
     } htable_t;
 
     // --- Function Prototypes --- //
@@ -79,15 +262,36 @@
     /// @return Pointer to the allocated hash table, NULL on failure.
     htable_t *htable_create (size_t size, htable_hash_t hash, htable_keq_t keq, const struct callbacks *cbs);
 
+    /// @brief Create a hash table with the specified size and configuration.
+    /// @param size Initial number of buckets in the hash table.
+    /// @param hash User-defined hash function for the keys, may be NULL if opts provides a seeded_hash.
+    /// @param keq User-defined comparison function for the keys.
+    /// @param cbs Optional callback functions, NULL for the defaults.
+    /// @param opts Optional configuration, NULL for the defaults.
+    /// @return Pointer to the allocated hash table, NULL on failure.
+    htable_t *htable_create_ex (size_t size, htable_hash_t hash, htable_keq_t keq, const struct callbacks *cbs, const struct htable_opts *opts);
+
     /// @brief Destroy the hash table and free resources.
     /// @param table The hash table to destroy.
     void htable_destroy (htable_t *table);
 
+    /// @brief Destroy the hash table on a background thread, returning at once.
+    /// The table must not be used by anyone once the call is made. Its nodes are freed through the callbacks
+    /// by a detached thread, and a table owning a slab frees its chunks in bulk there. Snapshots of the table are
+    /// detached before the call returns, so they can be read while the teardown runs.
+    /// @param table The hash table to destroy.
+    /// @return 0 if the teardown runs in the background, 1 if no thread could be started and the table was destroyed
+    /// on the calling thread instead.
+    int htable_destroy_async (htable_t *table);
+
+    /// @brief Wait until every teardown started by htable_destroy_async has finished, e.g. before exiting.
+    void htable_destroy_wait (void);
+
     /// @brief Insert a key-value pair into the hash table.
     /// @param table The hash table to insert the key-value pair into.
     /// @param key The key for the hash node.
     /// @param value The value for the hash node.
-    /// @return 0 on success, -1 on invalid input, -2 on memory allocation failure.
+    /// @return 0 on success, -1 on invalid input, -2 on memory allocation failure or a full fixed-size table.
     int htable_insert (htable_t *table, const void *key, const void *value);
 
     /// @brief Remove a key-value pair from the hash table.
@@ -102,4 +306,306 @@
     /// @return Pointer to the value on success, NULL on failure.
     void *htable_get (htable_t *table, const void *key);
 
+    /// @brief Insert a key-value pair, taking ownership of both instead of running the copy callbacks.
+    /// The table frees them through kfree and vfree like copies. If the key is already present, the stored key is
+    /// kept and the one handed over is freed, along with the previous value. With the chaining engine the key is
+    /// never copied into the inline storage.
+    /// @param table The hash table to insert the key-value pair into.
+    /// @param key The key for the hash node, owned by the table on success.
+    /// @param value The value for the hash node, owned by the table on success.
+    /// @return 0 on success, -1 on invalid input, -2 on memory allocation failure or a full fixed-size table, in
+    /// which case the caller still owns the key and value.
+    int htable_insert_owned (htable_t *table, void *key, void *value);
+
+    /// @brief Unlink a key-value pair and hand the stored key and value to the caller instead of freeing them.
+    /// Keys and values stored inline are handed out as malloc(3) copies.
+    /// @param table The hash table to remove the key-value pair from.
+    /// @param key The key to look up, it may differ from the stored key that is returned.
+    /// @param key_out Output pointer receiving the stored key, NULL to free it through kfree instead.
+    /// @param value_out Output pointer receiving the stored value, NULL to free it through vfree instead.
+    /// @return 0 on success, -1 on failure, -2 on memory allocation failure, in which case the table is unchanged.
+    int htable_take (htable_t *table, const void *key, void **key_out, void **value_out);
+
+    /// @brief Find the value slot of a key, inserting the key if it is absent, with a single hash and probe.
+    /// A newly inserted key has a NULL value that the caller must replace before the next operation on the table,
+    /// the value stored in the slot is owned by the table as if it had gone through the value copy callback.
+    /// The slot stays valid until the next insertion or removal.
+    /// @param table The hash table to search.
+    /// @param key The key for the hash node, copied through the key copy callback when it is inserted.
+    /// @param slot Output pointer receiving the address of the value of the key.
+    /// @return 1 if the key was inserted, 0 if it was present, -1 on invalid input, -2 on memory allocation
+    /// failure or a full fixed-size table.
+    int htable_get_or_insert (htable_t *table, const void *key, void ***slot);
+
+    /// @brief Modify the value of a key in place, inserting the key if it is absent.
+    /// @param table The hash table to update.
+    /// @param key The key for the hash node.
+    /// @param fn Function called with the address of the value, NULL for a newly inserted key. It may replace the
+    /// value, freeing the previous one if the table owns it, and leaving NULL removes the key. It must not
+    /// access the table.
+    /// @param ctx User context passed to fn.
+    /// @return 1 if the key was inserted, 0 if it was present, -1 on invalid input, -2 on memory allocation
+    /// failure or a full fixed-size table.
+    int htable_update (htable_t *table, const void *key, htable_update_t fn, void *ctx);
+
+    /// @brief Insert a key-value pair whose key is a byte string of the given length, chaining engine only.
+    /// The key is hashed by the hash_n function of struct htable_opts and compared by length, then byte by byte,
+    /// so the keq function is never called. Keys inserted this way must be looked up and removed with
+    /// htable_get_n and htable_remove_n. Keys that fit the inline storage are copied into the hash node,
+    /// longer ones are copied with malloc(3) by their length, the key copy and free callbacks are not used.
+    /// @param table The hash table to insert the key-value pair into.
+    /// @param key The key for the hash node.
+    /// @param key_len The length of the key in bytes, at least 1 and below UINT_MAX.
+    /// @param value The value for the hash node.
+    /// @return 0 on success, -1 on invalid input, -2 on memory allocation failure or a full fixed-size table.
+    int htable_insert_n (htable_t *table, const void *key, size_t key_len, const void *value);
+
+    /// @brief Remove a key-value pair inserted by htable_insert_n.
+    /// @param table The hash table to remove the key-value pair from.
+    /// @param key The key for the hash node.
+    /// @param key_len The length of the key in bytes, at least 1.
+    /// @return 0 on success, -1 on failure.
+    int htable_remove_n (htable_t *table, const void *key, size_t key_len);
+
+    /// @brief Retrieve a value inserted by htable_insert_n.
+    /// @param table The hash table to retrieve the value from.
+    /// @param key The key for the hash node.
+    /// @param key_len The length of the key in bytes, at least 1.
+    /// @return Pointer to the value on success, NULL on failure.
+    void *htable_get_n (htable_t *table, const void *key, size_t key_len);
+
+    /// @brief Retrieve the values of a batch of keys, overlapping their cache misses.
+    /// @param table The hash table to retrieve the values from.
+    /// @param keys The keys to look up.
+    /// @param n The number of keys.
+    /// @param values Output array of n values, NULL for every key that is not present.
+    /// @return The number of keys found.
+    size_t htable_get_many (htable_t *table, const void *const *keys, size_t n, void **values);
+
+    /// @brief Probe a column of keys whose hashes are already known, emitting a selection vector of the matches.
+    /// The hashes must be those the table computes, i.e. passed through fmix64 when HTABLE_MIX_HASH is set.
+    /// @param table The hash table to probe.
+    /// @param keys The keys to look up.
+    /// @param hashes The hash value of every key.
+    /// @param n The number of keys.
+    /// @param sel Output array of up to n entries, receiving the index of every key found in ascending order.
+    /// @param values Optional output array of up to n entries, receiving the value of every key found, NULL to skip.
+    /// @return The number of keys found, i.e. of entries written to sel.
+    size_t htable_probe_batch (htable_t *table, const void *const *keys, const unsigned long *hashes, size_t n, size_t *sel, void **values);
+
+    /// @brief Insert a batch of key-value pairs into the hash table, overlapping their cache misses.
+    /// @param table The hash table to insert the key-value pairs into.
+    /// @param keys The keys for the hash nodes.
+    /// @param values The values for the hash nodes.
+    /// @param n The number of key-value pairs.
+    /// @return 0 on success, -1 on invalid input, -2 on memory allocation failure or a full fixed-size table.
+    /// Pairs preceding a failing one stay inserted.
+    int htable_insert_many (htable_t *table, const void *const *keys, const void *const *values, size_t n);
+
+    /// @brief Create a hash table sized for and filled with an array of key-value pairs.
+    /// The keys are hashed in parallel, so the hash function must be thread-safe. With the chaining engine
+    /// the pairs are partitioned by bucket and the hash nodes of every bucket are laid out contiguously,
+    /// in a single slab chunk unless a custom allocator is given.
+    /// @param keys The keys for the hash nodes.
+    /// @param values The values for the hash nodes, a later duplicate key overwrites the earlier value.
+    /// @param n The number of key-value pairs, at most the capacity of opts if one is set.
+    /// @param hash User-defined hash function for the keys.
+    /// @param keq User-defined comparison function for the keys.
+    /// @param cbs Optional callback functions, NULL for the defaults.
+    /// @param opts Optional configuration, NULL for the defaults, HTABLE_UNIQUE_KEYS skips the duplicate check.
+    /// @return Pointer to the allocated hash table, NULL on failure.
+    htable_t *htable_build (const void *const *keys, const void *const *values, size_t n, htable_hash_t hash, htable_keq_t keq, const struct callbacks *cbs, const struct htable_opts *opts);
+
+    /// @brief Read the statistics of the hash table.
+    /// @param table The hash table to read the statistics of.
+    /// @param out Output structure receiving a snapshot of the statistics.
+    /// @return 0 on success, -1 on invalid input or if the library was built without HTABLE_STATS.
+    int htable_stats (const htable_t *table, struct htable_stats *out);
+
+    // --- Capacity --- //
+
+    /// @brief Grow the hash table ahead of time, so that it holds n entries without resizing.
+    /// The chaining engine migrates every bucket before returning, so none of the cost is left for later operations.
+    /// @param table The hash table to grow.
+    /// @param n The number of entries to hold.
+    /// @return 0 on success, -1 on invalid input, -2 on memory allocation failure.
+    int htable_reserve (htable_t *table, size_t n);
+
+    /// @brief Shrink the bucket or slot array to the smallest size that holds the current entries.
+    /// The size is only ever halved, so cursors of htable_scan stay valid. The chaining engine moves the remaining
+    /// hash nodes over incrementally and frees the previous bucket array once they have all moved.
+    /// @param table The hash table to shrink.
+    /// @return 0 on success, -1 on invalid input, -2 on memory allocation failure.
+    int htable_shrink_to_fit (htable_t *table);
+
+    /// @brief Replace the hash function of the hash table and rehash every key with it.
+    /// Keys inserted by htable_insert_n keep their hash_n hashes. A scan in progress does not survive the rehash.
+    /// A table created with a seeded_hash drops it in favour of the new hash function. The chaining engine rehashes
+    /// the keys as the incremental migration moves them, probing the previous bucket array with the previous hash
+    /// function until then. The open-addressing engines rebuild their slot array at once.
+    /// @param table The hash table to rehash.
+    /// @param hash The new hash function for the keys.
+    /// @return 0 on success, -1 on invalid input, -2 on memory allocation failure, in which case the table
+    /// keeps the previous hash function.
+    int htable_rehash (htable_t *table, htable_hash_t hash);
+
+    /// @brief Draw a new random seed for the seeded hash function and rehash every key with it.
+    /// Tables with max_chain set do this on their own when an insert finds a chain longer than max_chain.
+    /// The keys are rehashed like htable_rehash does, the chaining engine spreading the work over the migration.
+    /// @param table The hash table to re-seed, created with a seeded_hash.
+    /// @return 0 on success, -1 on invalid input, -2 on memory allocation failure, in which case the table
+    /// keeps the previous seed.
+    int htable_reseed (htable_t *table);
+
+    // --- Expiry --- //
+
+    /// @brief Insert or update a key-value pair that expires after the given time to live.
+    /// Expired entries are never returned by lookups, and the next write to their key frees them. htable_expire
+    /// frees the others. A plain insert of the key afterwards keeps it for good. Chaining engine only.
+    /// @param table The hash table to insert the key-value pair into.
+    /// @param key The key for the hash node.
+    /// @param value The value for the hash node.
+    /// @param ttl_ms The time to live in milliseconds, from 1 to HTABLE_TTL_MAX_MS.
+    /// @return 0 on success, -1 on invalid input, -2 on memory allocation failure.
+    int htable_insert_ttl (htable_t *table, const void *key, const void *value, unsigned long long ttl_ms);
+
+    /// @brief Free every entry whose time to live has passed, through the kfree and vfree callbacks.
+    /// The timing wheel is advanced to the current time, only the slots of the elapsed ticks are visited, so the
+    /// cost follows the number of expirations and not the size of the table.
+    /// @param table The hash table to expire entries of.
+    /// @return The number of entries freed.
+    size_t htable_expire (htable_t *table);
+
+    // --- Multimap --- //
+
+    /// @brief Add a value to a key of an HTABLE_MULTI table, keeping the values it already has.
+    /// The values of a key are kept in one array that doubles as it fills, so they are scanned contiguously.
+    /// htable_remove drops the key with all its values. Keys are copied once, when their first value is added.
+    /// @param table The hash table to insert the value into.
+    /// @param key The key for the hash node.
+    /// @param value The value to add.
+    /// @return 0 on success, -1 on invalid input or a table without HTABLE_MULTI, -2 on memory allocation failure.
+    int htable_insert_multi (htable_t *table, const void *key, const void *value);
+
+    /// @brief Retrieve every value of a key of an HTABLE_MULTI table.
+    /// The span stays valid until the next value is added to the key or the key is removed.
+    /// @param table The hash table to search.
+    /// @param key The key for the hash node.
+    /// @param n Set to the number of values, 0 if the key is not present.
+    /// @return Pointer to the values in insertion order, NULL if the key is not present.
+    void *const *htable_get_all (htable_t *table, const void *key, size_t *n);
+
+    /// @brief Count the values of a key of an HTABLE_MULTI table.
+    /// @param table The hash table to search.
+    /// @param key The key for the hash node.
+    /// @return The number of values, 0 if the key is not present.
+    size_t htable_count_key (htable_t *table, const void *key);
+
+    // --- Iteration --- //
+
+    /// @brief Visit a few buckets of the hash table, resuming from a cursor, like Redis SCAN.
+    /// A scan starts with cursor 0 and feeds every returned cursor back until 0 is returned. It visits every
+    /// key that stays in the table for the whole scan at least once, even when the table grows between calls.
+    /// Keys may be visited more than once. With the open-addressing engines the cursor is a slot index and the
+    /// guarantee only holds while the table is not modified.
+    /// @param table The hash table to scan, fn must not modify it.
+    /// @param cursor 0 to start a scan, the cursor returned by the previous call otherwise.
+    /// @param count The number of buckets to visit, at least one.
+    /// @param fn Function called with every key and value visited.
+    /// @param ctx User context passed to fn.
+    /// @return The cursor to resume the scan from, 0 once it is complete.
+    size_t htable_scan (const htable_t *table, size_t cursor, size_t count, htable_scan_t fn, void *ctx);
+
+    /// @brief Visit every key-value pair, splitting the buckets or slots into one range per thread.
+    /// @param table The hash table to traverse, it must not be modified until the call returns.
+    /// @param threads The number of threads, 0 for the number of online processors.
+    /// @param fn Function called with every key and value, concurrently from several threads.
+    /// @param ctx User context passed to fn.
+    /// @return 0 on success, -1 on invalid input.
+    int htable_for_each_parallel (const htable_t *table, size_t threads, htable_scan_t fn, void *ctx);
+
+    // --- Snapshots --- //
+
+    /// @brief Take a point-in-time snapshot of the hash table, sharing its buckets and hash nodes.
+    /// Nothing is copied up front. The first write to a bucket after the snapshot copies that bucket's chain into
+    /// the snapshot, keys and values through kcpy and vcpy. The table does not grow on its own while snapshotted, an
+    /// explicit resize or destroying the table first copies every bucket still shared. Snapshots are not synchronized with the table. Chaining engine only.
+    /// @param table The hash table to snapshot. A migration in progress is finished first. Its kcpy and vcpy must really
+    /// copy whatever kfree and vfree free, the default copy callbacks with custom free callbacks are rejected.
+    /// @return Pointer to the snapshot, NULL on invalid input, copy callbacks that do not copy or memory allocation failure.
+    htable_snapshot_t *htable_snapshot (htable_t *table);
+
+    /// @brief Release a snapshot and the chains it copied, which may outlive its hash table.
+    /// @param snap The snapshot to release.
+    void htable_snapshot_release (htable_snapshot_t *snap);
+
+    /// @brief Retrieve the value a key had when the snapshot was taken, expiry is not checked again.
+    /// @param snap The snapshot to search.
+    /// @param key The key to look up.
+    /// @return The value of the key, NULL if it was not present.
+    void *htable_snapshot_get (const htable_snapshot_t *snap, const void *key);
+
+    /// @brief Count the entries of the snapshot.
+    /// @param snap The snapshot to count.
+    /// @return The number of entries when the snapshot was taken.
+    size_t htable_snapshot_count (const htable_snapshot_t *snap);
+
+    /// @brief Visit every key-value pair of the snapshot.
+    /// @param snap The snapshot to traverse, the hash table must not be modified until the call returns.
+    /// @param fn Function called with every key and value.
+    /// @param ctx User context passed to fn.
+    void htable_snapshot_for_each (const htable_snapshot_t *snap, htable_scan_t fn, void *ctx);
+
+    // --- Persistence --- //
+
+    /// @brief Write a position-independent image of the hash table that htable_open_mmap can map.
+    /// Keys and values are copied byte for byte, as sized by the ksize and vsize callbacks, so they must not
+    /// contain pointers. Lookups in the image run the same hash and comparison functions on the copies.
+    /// Entries whose time to live has passed are left out.
+    /// @param table The hash table to save, of any engine, not created with a seeded_hash or HTABLE_MULTI.
+    /// @param fd The file descriptor to write the image to, at its current offset.
+    /// @return 0 on success, -1 on invalid input, a seeded table, a multimap or missing size callbacks, -2 on memory allocation or I/O failure.
+    int htable_save (const htable_t *table, int fd);
+
+    /// @brief Map an image written by htable_save read-only, ready for htable_get without deserialization.
+    /// The returned table rejects inserts and removals, values point into the mapping and must not be written.
+    /// @param path The path of the image file.
+    /// @param hash The hash function the image was saved with.
+    /// @param keq The comparison function for the keys.
+    /// @return Pointer to the hash table, NULL on failure or if the file is not a valid image.
+    htable_t *htable_open_mmap (const char *path, htable_hash_t hash, htable_keq_t keq);
+
+    // --- Slab Allocator --- //
+
+    /// @brief Create a slab allocator for objects of the specified size.
+    /// @param obj_size The size of each object.
+    /// @param chunk_objs The number of objects carved from each chunk, 0 for HTABLE_SLAB_CHUNK.
+    /// @return Pointer to the allocated slab, NULL on failure.
+    htable_slab_t *htable_slab_create (size_t obj_size, size_t chunk_objs);
+
+    /// @brief Destroy the slab, freeing every chunk and thereby every object at once.
+    /// @param slab The slab to destroy.
+    void htable_slab_destroy (htable_slab_t *slab);
+
+    /// @brief Allocate an object from the slab.
+    /// @param slab The slab to allocate from.
+    /// @return Pointer to the object, NULL on memory allocation failure.
+    void *htable_slab_alloc (htable_slab_t *slab);
+
+    /// @brief Make sure the next objs objects carved by the slab are contiguous, starting a chunk if needed.
+    /// @param slab The slab to reserve objects in.
+    /// @param objs The number of objects to reserve.
+    /// @return 0 on success, -2 on memory allocation failure.
+    int htable_slab_reserve (htable_slab_t *slab, size_t objs);
+
+    /// @brief Return an object to the freelist of the slab.
+    /// @param slab The slab the object was allocated from.
+    /// @param ptr The object to free, may be NULL.
+    void htable_slab_free (htable_slab_t *slab, void *ptr);
+
+    /// @brief Wrap the slab into an allocator usable as struct htable_opts allocator.
+    /// @param slab The slab to allocate hash nodes from, its object size must fit a hash node and its inline storage.
+    /// @return The allocator structure.
+    struct htable_allocator htable_slab_allocator (htable_slab_t *slab);
+
 #endif // HASH_MAP_H_
\ No newline at end of file
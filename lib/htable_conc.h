@@ -0,0 +1,98 @@
+// ==============================================================================
+//                            Concurrent Hash table
+// ==============================================================================
+//
+// Description: Thread-safe front-end for the generic hash table using lock
+// striping. Keys are spread over independent stripes by the high bits of their
+// mixed hash, and every stripe pairs a reader/writer lock with an ordinary hash
+// table. Readers of a stripe run in parallel and never modify it, while writers
+// take the stripe exclusively and also drive its incremental rehash, so a resize
+// only ever blocks the stripe that grows.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#ifndef HTABLE_CONC_H_
+#define HTABLE_CONC_H_
+
+    // --- Libraries --- //
+
+    #include "htable.h"
+
+    // --- Constants --- //
+
+    /// @brief Default number of stripes of a concurrent hash table.
+    #define HTABLE_CONC_STRIPES 64U
+
+    // --- TypeDefs --- //
+
+    /// @brief Concurrent hash table, opaque so that this header does not depend on pthread.h.
+    typedef struct htable_conc htable_conc_t;
+
+    typedef void (*htable_visit_t)(void *value, void *ctx);
+
+    // --- Function Prototypes --- //
+
+    /// @brief Create a concurrent hash table.
+    /// @param size Total number of buckets, split evenly over the stripes.
+    /// @param stripes Number of stripes rounded up to a power of two, 0 for HTABLE_CONC_STRIPES.
+    /// @param hash User-defined hash function for the keys.
+    /// @param keq User-defined comparison function for the keys.
+    /// @param cbs Optional callback functions, NULL for the defaults.
+    /// @param opts Optional configuration of every stripe, NULL for the defaults. A custom allocator must be thread-safe.
+    /// Every stripe shares one seed, max_chain is ignored and a capacity or HTABLE_MULTI is rejected.
+    /// @return Pointer to the allocated hash table, NULL on failure.
+    htable_conc_t *htable_conc_create (size_t size, size_t stripes, htable_hash_t hash, htable_keq_t keq, const struct callbacks *cbs, const struct htable_opts *opts);
+
+    /// @brief Destroy the concurrent hash table, no other thread may access it anymore.
+    /// @param table The hash table to destroy.
+    void htable_conc_destroy (htable_conc_t *table);
+
+    /// @brief Insert a key-value pair, taking the stripe of the key exclusively.
+    /// @return 0 on success, -1 on invalid input, -2 on memory allocation failure or a full fixed-size table.
+    int htable_conc_insert (htable_conc_t *table, const void *key, const void *value);
+
+    /// @brief Remove a key-value pair, taking the stripe of the key exclusively.
+    /// @return 0 on success, -1 on failure.
+    int htable_conc_remove (htable_conc_t *table, const void *key);
+
+    /// @brief Retrieve a value under a shared lock of the stripe of the key.
+    /// The value is only guaranteed to stay alive until another thread replaces or removes the key, use
+    /// htable_conc_visit when values are owned by the hash table.
+    /// @return Pointer to the value on success, NULL on failure.
+    void *htable_conc_get (htable_conc_t *table, const void *key);
+
+    /// @brief Call a function on the value of a key while holding the shared lock of its stripe.
+    /// @param table The hash table to retrieve the value from.
+    /// @param key The key for the hash node.
+    /// @param visit Function called with the value if the key is present, it must not modify the table.
+    /// @param ctx User context passed to the function.
+    /// @return 0 if the key was visited, -1 on failure.
+    int htable_conc_visit (htable_conc_t *table, const void *key, htable_visit_t visit, void *ctx);
+
+    /// @brief Count the elements of every stripe, a snapshot that may be stale by the time it returns.
+    /// @param table The hash table to count.
+    /// @return The number of elements.
+    size_t htable_conc_count (htable_conc_t *table);
+
+#endif // HTABLE_CONC_H_
@@ -0,0 +1,110 @@
+// ==============================================================================
+//                           Built-in Hash Functions
+// ==============================================================================
+//
+// Description: Ready-made hash and comparison functions for integer, fixed-size
+// byte and string keys, usable as htable_hash_t and htable_keq_t. Hashing
+// follows wyhash, 64-bit multiply-and-fold mixing over 16 and 48 byte blocks,
+// with an AES-NI path for long keys when the library is compiled with AES
+// support.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#ifndef HTABLE_HASH_H_
+#define HTABLE_HASH_H_
+
+    // --- Libraries --- //
+
+    #include "htable.h"
+
+    #include <stdint.h>     // For fixed width integer types, e.g. uint64_t.
+    #include <string.h>     // For memory comparison, e.g. memcmp(3).
+
+    // --- Constants --- //
+
+    /// @brief Seed of the built-in hash functions.
+    #define HTABLE_HASH_SEED 0x9E3779B97F4A7C15ULL
+
+    /// @brief Key length from which the AES-NI path takes over, when compiled in.
+    #define HTABLE_HASH_AES_MIN 64U
+
+    // --- Types --- //
+
+    /// @brief Length-prefixed string key, the bytes need no terminator.
+    struct htable_lpstr {
+        uint32_t len;           // The number of bytes of the string.
+        char data[];            // The bytes of the string.
+    };
+
+    // --- Macros --- //
+
+    /// @brief Define name##_hash and name##_keq for keys that are exactly size bytes long.
+    #define HTABLE_DEFINE_HASH_FIXED(name, size)                                                   \
+        static inline unsigned long name##_hash (const void *key) {                                \
+            return (unsigned long) htable_hash_bytes(key, (size), HTABLE_HASH_SEED);               \
+        }                                                                                          \
+        static inline int name##_keq (const void *keyA, const void *keyB) {                        \
+            return memcmp(keyA, keyB, (size)) == 0;                                                \
+        }
+
+    // --- Function Prototypes --- //
+
+    /// @brief Hash a byte string.
+    /// The AES-NI path produces different values than the portable one, so hashes are only stable between
+    /// builds that agree on __AES__, which matters for images written by htable_save.
+    /// @param data The bytes to hash.
+    /// @param len The number of bytes.
+    /// @param seed The seed of the hash.
+    /// @return The 64-bit hash value.
+    uint64_t htable_hash_bytes (const void *data, size_t len, uint64_t seed);
+
+    /// @brief Hash and compare uint32_t keys.
+    unsigned long htable_hash_u32 (const void *key);
+    int htable_keq_u32 (const void *keyA, const void *keyB);
+
+    /// @brief Hash and compare uint64_t keys.
+    unsigned long htable_hash_u64 (const void *key);
+    int htable_keq_u64 (const void *keyA, const void *keyB);
+
+    /// @brief Hash and compare NUL-terminated string keys.
+    unsigned long htable_hash_str (const void *key);
+    int htable_keq_str (const void *keyA, const void *keyB);
+
+    /// @brief Hash and compare struct htable_lpstr keys.
+    unsigned long htable_hash_lpstr (const void *key);
+    int htable_keq_lpstr (const void *keyA, const void *keyB);
+
+    /// @brief Seeded variants of the built-in hash functions, usable as the seeded_hash of struct htable_opts.
+    unsigned long htable_hash_u32_seeded (const void *key, unsigned long long seed);
+    unsigned long htable_hash_u64_seeded (const void *key, unsigned long long seed);
+    unsigned long htable_hash_str_seeded (const void *key, unsigned long long seed);
+    unsigned long htable_hash_lpstr_seeded (const void *key, unsigned long long seed);
+
+    /// @brief Sizes of the built-in key types, usable as the ksize and vsize callbacks.
+    size_t htable_size_u32 (const void *key);
+    size_t htable_size_u64 (const void *key);
+    size_t htable_size_str (const void *key);
+    size_t htable_size_lpstr (const void *key);
+
+#endif // HTABLE_HASH_H_
@@ -0,0 +1,95 @@
+// ==============================================================================
+//                            Partitioned Hash table
+// ==============================================================================
+//
+// Description: Radix-partitioned build of read-mostly tables for hash joins and
+// aggregation. The pairs are split by the high bits of their mixed hash into
+// partitions small enough to stay in the L2 cache, each built as its own table.
+// Batches of probe keys are partitioned the same way and resolved one partition
+// at a time, so every probe runs against a cache-resident table.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#ifndef HTABLE_PART_H_
+#define HTABLE_PART_H_
+
+    // --- Libraries --- //
+
+    #include "htable.h"
+
+    // --- Constants --- //
+
+    /// @brief Target size of one partition built by htable_part_build, about the L2 cache of one core.
+    #define HTABLE_PART_BYTES 262144U
+
+    /// @brief Maximum number of partition bits, i.e. at most 4096 partitions.
+    #define HTABLE_PART_MAX_BITS 12U
+
+    // --- TypeDefs --- //
+
+    /// @brief Partitioned hash table, one independent hash table per partition.
+    typedef struct htable_part {
+        htable_t **tables;      // The hash table of every partition.
+        size_t partitions;      // The number of partitions, 2^bits.
+        unsigned int bits;      // The number of high bits of the mixed hash selecting the partition.
+    } htable_part_t;
+
+    // --- Function Prototypes --- //
+
+    /// @brief Create a partitioned hash table filled with an array of key-value pairs.
+    /// Every key is hashed once, the pairs are radix-partitioned by their hashes and each partition is built like
+    /// htable_build, the last of duplicate keys winning.
+    /// @param keys The keys for the hash nodes.
+    /// @param values The values for the hash nodes.
+    /// @param n The number of key-value pairs.
+    /// @param hash User-defined hash function for the keys.
+    /// @param keq User-defined comparison function for the keys.
+    /// @param cbs Optional callback functions, NULL for the defaults.
+    /// @param opts Optional configuration of every partition, NULL for the defaults.
+    /// @param bits The number of partition bits up to HTABLE_PART_MAX_BITS, 0 to size partitions by HTABLE_PART_BYTES.
+    /// @return Pointer to the allocated partitioned hash table, NULL on failure.
+    htable_part_t *htable_part_build (const void *const *keys, const void *const *values, size_t n, htable_hash_t hash, htable_keq_t keq, const struct callbacks *cbs, const struct htable_opts *opts, unsigned int bits);
+
+    /// @brief Destroy the partitioned hash table and every partition.
+    /// @param part The partitioned hash table to destroy.
+    void htable_part_destroy (htable_part_t *part);
+
+    /// @brief Retrieve the value of a key.
+    /// @param part The partitioned hash table to search.
+    /// @param key The key to look up.
+    /// @return The value of the key, NULL if it is not present.
+    void *htable_part_get (htable_part_t *part, const void *key);
+
+    /// @brief Probe a column of keys whose hashes are already known, like htable_probe_batch.
+    /// The batch is radix-partitioned first, so the probes of every partition run together against its table.
+    /// @param part The partitioned hash table to probe.
+    /// @param keys The keys to look up.
+    /// @param hashes The hash value of every key.
+    /// @param n The number of keys.
+    /// @param sel Output array of up to n entries, receiving the index of every key found in ascending order.
+    /// @param values Optional output array of up to n entries, receiving the value of every key found, NULL to skip.
+    /// @return The number of keys found, i.e. of entries written to sel.
+    size_t htable_part_probe_batch (htable_part_t *part, const void *const *keys, const unsigned long *hashes, size_t n, size_t *sel, void **values);
+
+#endif // HTABLE_PART_H_
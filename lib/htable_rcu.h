@@ -0,0 +1,111 @@
+// ==============================================================================
+//                         Read-Copy-Update Hash table
+// ==============================================================================
+//
+// Description: Read-mostly concurrent variant of the generic hash table. Readers
+// never take a lock nor perform an atomic read-modify-write: they announce the
+// epoch they run in with a plain store, then walk chains that writers only ever
+// change with atomic pointer publication. Writers are serialized by a mutex,
+// never modify a node a reader may see in place, and hand unlinked nodes,
+// replaced values and old bucket arrays to epoch-based reclamation instead of
+// freeing them immediately.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#ifndef HTABLE_RCU_H_
+#define HTABLE_RCU_H_
+
+    // --- Libraries --- //
+
+    #include "htable.h"
+
+    // --- Constants --- //
+
+    /// @brief Number of retired objects that triggers an attempt to reclaim memory.
+    #define HTABLE_RCU_RECLAIM 64U
+
+    // --- TypeDefs --- //
+
+    /// @brief Read-copy-update hash table, opaque so that this header does not depend on pthread.h.
+    typedef struct htable_rcu htable_rcu_t;
+
+    /// @brief Per-thread reader registration of a read-copy-update hash table.
+    typedef struct htable_rcu_reader htable_rcu_reader_t;
+
+    // --- Function Prototypes --- //
+
+    /// @brief Create a read-copy-update hash table.
+    /// @param size Initial number of buckets in the hash table.
+    /// @param hash User-defined hash function for the keys.
+    /// @param keq User-defined comparison function for the keys.
+    /// @param cbs Optional callback functions, NULL for the defaults.
+    /// @param opts Optional configuration, only max_load, HTABLE_FIXED_SIZE and HTABLE_MIX_HASH apply.
+    /// @return Pointer to the allocated hash table, NULL on failure.
+    htable_rcu_t *htable_rcu_create (size_t size, htable_hash_t hash, htable_keq_t keq, const struct callbacks *cbs, const struct htable_opts *opts);
+
+    /// @brief Destroy the hash table and free resources, every reader must have been unregistered.
+    /// @param table The hash table to destroy.
+    void htable_rcu_destroy (htable_rcu_t *table);
+
+    /// @brief Register the calling thread as a reader, once per thread.
+    /// @param table The hash table to read from.
+    /// @return The reader registration, NULL on memory allocation failure.
+    htable_rcu_reader_t *htable_rcu_register (htable_rcu_t *table);
+
+    /// @brief Unregister a reader, which must not be inside a read-side critical section.
+    /// @param reader The reader registration to release.
+    void htable_rcu_unregister (htable_rcu_reader_t *reader);
+
+    /// @brief Enter a read-side critical section, critical sections may be nested.
+    /// @param reader The reader registration of the calling thread.
+    void htable_rcu_read_lock (htable_rcu_reader_t *reader);
+
+    /// @brief Leave a read-side critical section.
+    /// @param reader The reader registration of the calling thread.
+    void htable_rcu_read_unlock (htable_rcu_reader_t *reader);
+
+    /// @brief Retrieve a value without locking, the caller must be inside a read-side critical section.
+    /// @param table The hash table to retrieve the value from.
+    /// @param key The key for the hash node.
+    /// @return Pointer to the value, valid until the critical section is left, NULL on failure.
+    void *htable_rcu_get (htable_rcu_t *table, const void *key);
+
+    /// @brief Insert or replace a key-value pair, replaced values are freed once no reader can see them.
+    /// @return 0 on success, -1 on invalid input, -2 on memory allocation failure.
+    int htable_rcu_insert (htable_rcu_t *table, const void *key, const void *value);
+
+    /// @brief Remove a key-value pair, the key and value are freed once no reader can see them.
+    /// @return 0 on success, -1 on failure.
+    int htable_rcu_remove (htable_rcu_t *table, const void *key);
+
+    /// @brief Wait until everything retired so far has been freed, must not be called inside a read-side critical section.
+    /// @param table The hash table to synchronize.
+    void htable_rcu_synchronize (htable_rcu_t *table);
+
+    /// @brief Number of elements in the hash table.
+    /// @param table The hash table to count.
+    /// @return The number of elements.
+    size_t htable_rcu_count (htable_rcu_t *table);
+
+#endif // HTABLE_RCU_H_
@@ -0,0 +1,134 @@
+// ==============================================================================
+//                              Sharded Hash table
+// ==============================================================================
+//
+// Description: Thread-safe front-end that splits keys over independent hash
+// tables by the high bits of their mixed hash. Unlike the stripes of
+// htable_conc_t, every shard is a separate allocation with its own lock, hash
+// node slab and bucket array, and can be placed on a NUMA node: its memory is
+// then allocated and first touched by a thread bound to the CPUs of that node,
+// and threads can bind themselves to the node of the shards they work on.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#ifndef HTABLE_SHARD_H_
+#define HTABLE_SHARD_H_
+
+    // --- Libraries --- //
+
+    #include "htable.h"
+
+    // --- Constants --- //
+
+    /// @brief Default number of shards of a sharded hash table.
+    #define HTABLE_SHARDS 16U
+
+    /// @brief Highest NUMA node number considered when placing shards.
+    #define HTABLE_SHARD_MAX_NODES 64U
+
+    // --- TypeDefs --- //
+
+    /// @brief Sharded hash table, opaque so that this header does not depend on pthread.h.
+    typedef struct htable_shard htable_shard_t;
+
+    /// @brief Sharded hash table flags.
+    enum htable_shard_flags {
+        HTABLE_SHARD_NUMA = 1U << 0,    // Spread the shards over the NUMA nodes and allocate them node-locally.
+    };
+
+    /// @brief Optional configuration of a sharded hash table, zero-initialized fields select the defaults.
+    struct htable_shard_opts {
+        size_t shards;          // The number of shards rounded up to a power of two, 0 for HTABLE_SHARDS.
+        unsigned flags;         // Bitwise OR of the sharded hash table flags.
+    };
+
+    /// @brief Statistics aggregated over every shard.
+    struct htable_shard_stats {
+        size_t count;               // The number of elements of all shards.
+        size_t max_count;           // The number of elements of the fullest shard, compared to count / shards it shows imbalance.
+        size_t buckets;             // The number of buckets or slots of all shards.
+        int collected;              // Non-zero if table holds counters, which requires HTABLE_STATS.
+        struct htable_stats table;  // The summed counters of the shards, averages weighted by their searches.
+    };
+
+    // --- Function Prototypes --- //
+
+    /// @brief Create a sharded hash table.
+    /// @param size Total number of buckets, split evenly over the shards.
+    /// @param hash User-defined hash function for the keys.
+    /// @param keq User-defined comparison function for the keys.
+    /// @param cbs Optional callback functions, NULL for the defaults.
+    /// @param opts Optional configuration of every shard, NULL for the defaults. Shards own a slab for their hash
+    /// nodes unless a custom allocator is given, which must then be thread-safe. Every shard shares one seed,
+    /// max_chain is ignored and a capacity or HTABLE_MULTI is rejected.
+    /// @param shard_opts Optional sharding configuration, NULL for the defaults.
+    /// @return Pointer to the allocated hash table, NULL on failure.
+    htable_shard_t *htable_shard_create (size_t size, htable_hash_t hash, htable_keq_t keq, const struct callbacks *cbs, const struct htable_opts *opts, const struct htable_shard_opts *shard_opts);
+
+    /// @brief Destroy the sharded hash table, no other thread may access it anymore.
+    /// @param table The hash table to destroy.
+    void htable_shard_destroy (htable_shard_t *table);
+
+    /// @brief Insert a key-value pair, taking the lock of its shard exclusively.
+    /// @return 0 on success, -1 on invalid input, -2 on memory allocation failure or a full fixed-size table.
+    int htable_shard_insert (htable_shard_t *table, const void *key, const void *value);
+
+    /// @brief Remove a key-value pair, taking the lock of its shard exclusively.
+    /// @return 0 on success, -1 on failure.
+    int htable_shard_remove (htable_shard_t *table, const void *key);
+
+    /// @brief Retrieve a value under a shared lock of the shard of the key.
+    /// The value is only guaranteed to stay alive until another thread replaces or removes the key.
+    /// @return Pointer to the value on success, NULL on failure.
+    void *htable_shard_get (htable_shard_t *table, const void *key);
+
+    /// @brief Count the elements of every shard, a snapshot that may be stale by the time it returns.
+    size_t htable_shard_count (htable_shard_t *table);
+
+    /// @brief Aggregate the statistics of every shard.
+    /// @param table The hash table to read the statistics of.
+    /// @param out Output structure receiving the aggregated snapshot.
+    /// @return 0 on success, -1 on invalid input.
+    int htable_shard_stats (htable_shard_t *table, struct htable_shard_stats *out);
+
+    // --- Affinity Hints --- //
+
+    /// @brief Number of shards of the hash table.
+    size_t htable_shard_shards (const htable_shard_t *table);
+
+    /// @brief Shard a key belongs to, so that work can be routed to threads near it.
+    /// @return The index of the shard.
+    size_t htable_shard_of (const htable_shard_t *table, const void *key);
+
+    /// @brief NUMA node a shard was placed on.
+    /// @return The node number, -1 if the shard was not placed on a node.
+    int htable_shard_node (const htable_shard_t *table, size_t shard);
+
+    /// @brief Bind the calling thread to the CPUs of the NUMA node of a shard.
+    /// Memory the shard allocates while growing is placed on the node of the thread that inserts, keeping the
+    /// writers of a shard on its node keeps the shard node-local.
+    /// @return 0 on success, -1 if the shard was not placed on a node or binding failed.
+    int htable_shard_bind (const htable_shard_t *table, size_t shard);
+
+#endif // HTABLE_SHARD_H_
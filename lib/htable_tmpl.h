@@ -0,0 +1,227 @@
+// ==============================================================================
+//                     Type-specialized Hash table Template
+// ==============================================================================
+//
+// Description: Header-only generator for hash tables specialized to a key and
+// value type. HTABLE_DEFINE emits a table type and static inline functions that
+// store keys and values by value in a flat Robin Hood slot array, with the hash
+// and comparison functions inlined at every call site instead of being called
+// through function pointers, and no pointers to user-owned keys to chase.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+//
+// Example:
+//
+//     static inline unsigned long hash_i (int key) { return (unsigned long) key; }
+//     static inline int eq_i (int a, int b) { return a == b; }
+//
+//     HTABLE_DEFINE(imap, int, int, hash_i, eq_i)
+//
+//     imap_t *map = imap_create(16);
+//     imap_insert(map, 42, 100);
+//     int *value = imap_get(map, 42);
+//     imap_destroy(map);
+//
+// hash_fn(key_t) must return an unsigned integer, it is passed through a finalizer so identity hashes are fine.
+// eq_fn(key_t, key_t) must return non-zero when the keys are equal. Both may be functions or macros.
+
+#ifndef HTABLE_TMPL_H_
+#define HTABLE_TMPL_H_
+
+    // --- Standard Libraries --- //
+
+    #include <stddef.h>     // For NULL definition and size_t.
+    #include <stdint.h>     // For fixed width integer types, e.g. uint32_t.
+    #include <stdlib.h>     // For memory allocation operations, e.g. calloc(3), free(3).
+
+    // --- Constants --- //
+
+    /// @brief Maximum load factor of generated tables, as a fraction of HTABLE_TMPL_LOAD_DEN.
+    #define HTABLE_TMPL_LOAD_NUM 7U
+    #define HTABLE_TMPL_LOAD_DEN 8U
+
+    // --- Helpers --- //
+
+    /// @brief MurmurHash3 fmix64 finalizer applied to every user hash.
+    static inline uint64_t htable_tmpl_mix (uint64_t h) {
+        h ^= h >> 33U;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33U;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33U;
+        return h;
+    }
+
+    // --- Generator --- //
+
+    /// @brief Define a hash table type name##_t mapping key_t to val_t and its functions:
+    /// name##_create, name##_destroy, name##_insert, name##_get, name##_remove and name##_count.
+    #define HTABLE_DEFINE(name, key_t, val_t, hash_fn, eq_fn)                                                  \
+                                                                                                               \
+        /* Slot storing the key and value inline. */                                                           \
+        typedef struct name##_slot {                                                                           \
+            key_t key;                                                                                         \
+            val_t value;                                                                                       \
+        } name##_slot_t;                                                                                       \
+                                                                                                               \
+        /* Hash table structure, dist holds the probe distance plus one of every slot, 0 if empty. */          \
+        typedef struct name {                                                                                  \
+            name##_slot_t *slots;                                                                              \
+            uint32_t *dist;                                                                                    \
+            size_t size;                                                                                       \
+            size_t count;                                                                                      \
+        } name##_t;                                                                                            \
+                                                                                                               \
+        /* Home slot of the key, the user hash is finalized so the low bits are usable as an index. */         \
+        static inline size_t name##_home (const name##_t *table, key_t key) {                                  \
+            return (size_t) htable_tmpl_mix((uint64_t) hash_fn(key)) & (table->size - 1U);                     \
+        }                                                                                                      \
+                                                                                                               \
+        /* Create a table with at least size slots, NULL on failure. */                                        \
+        static inline name##_t *name##_create (size_t size) {                                                  \
+            name##_t *table = calloc(1U, sizeof(*table));                                                      \
+            if (table == NULL) {                                                                               \
+                return NULL;                                                                                   \
+            }                                                                                                  \
+            for (table->size = 8U; table->size < size; table->size <<= 1U) {}                                  \
+            table->slots = malloc(table->size * sizeof(*table->slots));                                        \
+            table->dist = calloc(table->size, sizeof(*table->dist));                                           \
+            if (table->slots == NULL || table->dist == NULL) {                                                 \
+                free(table->slots);                                                                            \
+                free(table->dist);                                                                             \
+                free(table);                                                                                   \
+                return NULL;                                                                                   \
+            }                                                                                                  \
+            return table;                                                                                      \
+        }                                                                                                      \
+                                                                                                               \
+        /* Destroy the table, keys and values are stored by value and need no freeing. */                      \
+        static inline void name##_destroy (name##_t *table) {                                                  \
+            if (table != NULL) {                                                                               \
+                free(table->slots);                                                                            \
+                free(table->dist);                                                                             \
+                free(table);                                                                                   \
+            }                                                                                                  \
+        }                                                                                                      \
+                                                                                                               \
+        /* Index of the slot holding the key, table->size if the key is not present. */                        \
+        static inline size_t name##_find (const name##_t *table, key_t key) {                                  \
+            const size_t mask = table->size - 1U;                                                              \
+            size_t idx = name##_home(table, key);                                                              \
+            for (unsigned int dist = 1U; table->dist[idx] >= dist; dist++, idx = (idx + 1U) & mask) {          \
+                if (eq_fn(table->slots[idx].key, key)) {                                                       \
+                    return idx;                                                                                \
+                }                                                                                              \
+            }                                                                                                  \
+            return table->size;                                                                                \
+        }                                                                                                      \
+                                                                                                               \
+        /* Retrieve a pointer to the value of the key, valid until the next insert or remove. */               \
+        static inline val_t *name##_get (const name##_t *table, key_t key) {                                   \
+            const size_t idx = name##_find(table, key);                                                        \
+            return idx < table->size ? &table->slots[idx].value : NULL;                                        \
+        }                                                                                                      \
+                                                                                                               \
+        /* Place an absent entry with Robin Hood displacement, the table must have a free slot. */             \
+        static inline void name##_place (name##_t *table, name##_slot_t entry) {                               \
+            const size_t mask = table->size - 1U;                                                              \
+            size_t idx = name##_home(table, entry.key);                                                        \
+            unsigned int dist = 1U;                                                                            \
+            for (; table->dist[idx] != 0; dist++, idx = (idx + 1U) & mask) {                                   \
+                if (table->dist[idx] < dist) {                                                                 \
+                    const name##_slot_t displaced = table->slots[idx];                                         \
+                    const unsigned int displaced_dist = table->dist[idx];                                      \
+                    table->slots[idx] = entry;                                                                 \
+                    table->dist[idx] = (uint32_t) dist;                                                        \
+                    entry = displaced;                                                                         \
+                    dist = displaced_dist;                                                                     \
+                }                                                                                              \
+            }                                                                                                  \
+            table->slots[idx] = entry;                                                                         \
+            table->dist[idx] = (uint32_t) dist;                                                                \
+        }                                                                                                      \
+                                                                                                               \
+        /* Move every entry into a table of the given size, -2 on memory allocation failure. */                \
+        static inline int name##_resize (name##_t *table, size_t size) {                                       \
+            name##_t resized = { NULL, NULL, size, 0 };                                                        \
+            resized.slots = malloc(size * sizeof(*resized.slots));                                             \
+            resized.dist = calloc(size, sizeof(*resized.dist));                                                \
+            if (resized.slots == NULL || resized.dist == NULL) {                                               \
+                free(resized.slots);                                                                           \
+                free(resized.dist);                                                                            \
+                return -2;                                                                                     \
+            }                                                                                                  \
+            for (size_t idx = 0; idx < table->size; idx++) {                                                   \
+                if (table->dist[idx] != 0) {                                                                   \
+                    name##_place(&resized, table->slots[idx]);                                                 \
+                }                                                                                              \
+            }                                                                                                  \
+            free(table->slots);                                                                                \
+            free(table->dist);                                                                                 \
+            table->slots = resized.slots;                                                                      \
+            table->dist = resized.dist;                                                                        \
+            table->size = size;                                                                                \
+            return 0;                                                                                          \
+        }                                                                                                      \
+                                                                                                               \
+        /* Insert or overwrite a key-value pair, 0 on success, -2 on memory allocation failure. */             \
+        static inline int name##_insert (name##_t *table, key_t key, val_t value) {                            \
+            val_t *existing = name##_get(table, key);                                                          \
+            if (existing != NULL) {                                                                            \
+                *existing = value;                                                                             \
+                return 0;                                                                                      \
+            }                                                                                                  \
+            if ((table->count + 1U) * HTABLE_TMPL_LOAD_DEN > table->size * HTABLE_TMPL_LOAD_NUM                \
+                && name##_resize(table, table->size * 2U) != 0) {                                              \
+                return -2;                                                                                     \
+            }                                                                                                  \
+            const name##_slot_t entry = { key, value };                                                        \
+            name##_place(table, entry);                                                                        \
+            table->count++;                                                                                    \
+            return 0;                                                                                          \
+        }                                                                                                      \
+                                                                                                               \
+        /* Remove a key with backward-shift deletion, 0 on success, -1 if the key is not present. */           \
+        static inline int name##_remove (name##_t *table, key_t key) {                                         \
+            const size_t mask = table->size - 1U;                                                              \
+            size_t idx = name##_find(table, key);                                                              \
+            if (idx == table->size) {                                                                          \
+                return -1;                                                                                     \
+            }                                                                                                  \
+            for (size_t next = (idx + 1U) & mask; table->dist[next] > 1U; next = (next + 1U) & mask) {         \
+                table->slots[idx] = table->slots[next];                                                        \
+                table->dist[idx] = table->dist[next] - 1U;                                                     \
+                idx = next;                                                                                    \
+            }                                                                                                  \
+            table->dist[idx] = 0;                                                                              \
+            table->count--;                                                                                    \
+            return 0;                                                                                          \
+        }                                                                                                      \
+                                                                                                               \
+        /* Number of elements in the table. */                                                                 \
+        static inline size_t name##_count (const name##_t *table) {                                            \
+            return table->count;                                                                               \
+        }
+
+#endif // HTABLE_TMPL_H_
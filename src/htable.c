@@ -30,33 +30,891 @@
 // SOFTWARE.
 // ==============================================================================
 
-#include "htable.h"
+#include "htable_internal.h"
+
+#include "htable_hash.h"
+
+#include <limits.h>     // For the longest length-aware key, UINT_MAX.
+#include <stdint.h>     // For SIZE_MAX.
+#include <string.h>     // For memory operations, e.g. memcpy(3).
+
+// --- Macros --- //
+
+// Length passed to the internal searches when the key comes from the plain functions and is compared by keq.
+#define KEY_LEN_NONE SIZE_MAX
 
 // --- Static Function Definitions --- //
 
-/// @brief Retrieve the hash value for the key.
-/// @param table The hash table to retrieve the hash value from.
-/// @param key The key for the hash node.
-/// @return The hash value for the key.
-static size_t get_hash (const htable_t *table, const void *key) {
-    return table->hash(key) % table->size;
+static void *htable_default_copy (const void *src) {
+    return (void *) src;
+}
+
+static void htable_default_free (void *src) {
+    (void) src;
+    return;
+}
+
+static void *htable_default_alloc (void *ctx, size_t size) {
+    (void) ctx;
+    return malloc(size);
+}
+
+static void htable_default_dealloc (void *ctx, void *ptr, size_t size) {
+    (void) ctx;
+    (void) size;
+    free(ptr);
+}
+
+static void htable_release_slab (void *ctx) {
+    htable_slab_destroy(ctx);
+}
+
+static unsigned long htable_default_hash_n (const void *key, size_t len) {
+    return (unsigned long) htable_hash_bytes(key, len, HTABLE_HASH_SEED);
+}
+
+
+/// @brief Allocate a hash node through the allocator of the hash table.
+static struct htable_node *alloc_node (const htable_t *table) {
+    return table->alloc.alloc(table->alloc.ctx, table->node_size);
+}
+
+/// @brief Free a hash node through the allocator of the hash table.
+static void free_node (const htable_t *table, struct htable_node *node) {
+    table->alloc.free(table->alloc.ctx, node, table->node_size);
+}
+
+/// @brief Copy a key or value into the hash node if it fits its inline storage.
+void *htable_store_inline (const htable_t *table, unsigned char *storage, const void *src, htable_size_t size, htable_cpy_t cpy) {
+
+    if (size != NULL && table->inline_size > 0) {
+        const size_t len = size(src);
+
+        if (len <= table->inline_size) {
+            memcpy(storage, src, len);
+            return storage;
+        }
+    }
+
+    return cpy(src);
+}
+
+/// @brief Hash a length-aware key with the hash_n function, finalized if HTABLE_MIX_HASH is set.
+unsigned long htable_hash_key_n (const htable_t *table, const void *key, size_t len) {
+
+    // The default hash_n takes the seed of a seeded table, so length-aware keys cannot be flooded either.
+    const unsigned long hash = table->hash_n == htable_default_hash_n && table->seeded_hash != NULL
+        ? (unsigned long) htable_hash_bytes(key, len, table->seed) : table->hash_n(key, len);
+
+    return (table->flags & HTABLE_MIX_HASH) ? (unsigned long) htable_fmix64(hash) : hash;
+}
+
+/// @brief Hash the key of a hash node with the current hashing setup of its table.
+unsigned long htable_node_hash (const htable_t *table, const struct htable_node *node) {
+    return node->key_len == 0 ? htable_hash_key(table, node->key) : htable_hash_key_n(table, node->key, node->key_len);
+}
+
+/// @brief Hash a key with the hashing setup of the previous hash table, for probing it during a rehash.
+/// @param table The hash table being searched.
+/// @param key The key to hash.
+/// @param len The length of a length-aware key, KEY_LEN_NONE for a key hashed by hash or seeded_hash.
+/// @param hash The hash value of the key under the current hashing setup.
+/// @return The hash value the hash nodes of the previous hash table were stored with.
+static unsigned long previous_hash (const htable_t *table, const void *key, size_t len, unsigned long hash) {
+
+    if (!table->rehash_rekey) {
+        return hash;
+    }
+
+    if (len != KEY_LEN_NONE) {
+        hash = table->hash_n == htable_default_hash_n && table->rehash_seeded_hash != NULL
+            ? (unsigned long) htable_hash_bytes(key, len, table->rehash_seed) : table->hash_n(key, len);
+    } else {
+        hash = table->rehash_seeded_hash != NULL ? table->rehash_seeded_hash(key, table->rehash_seed) : table->rehash_hash(key);
+    }
+
+    return (table->flags & HTABLE_MIX_HASH) ? (unsigned long) htable_fmix64(hash) : hash;
+}
+
+/// @brief Check whether a hash table frees keys or values that its copy callbacks do not copy.
+int htable_copies_shared (const htable_t *table) {
+    return (table->cbs.kcpy == htable_default_copy && table->cbs.kfree != htable_default_free)
+        || (table->cbs.vcpy == htable_default_copy && table->cbs.vfree != htable_default_free);
+}
+
+/// @brief Free the key of a hash node, unless it is stored inline.
+static void free_key (const htable_t *table, struct htable_node *node) {
+    if (table->inline_size > 0 && node->key == (void *) node->data) {
+        return;
+    }
+
+    // Length-aware keys are copied with malloc(3), not with kcpy.
+    if (node->key_len != 0) {
+        free(node->key);
+    }
+    else {
+        table->cbs.kfree(node->key);
+    }
+}
+
+/// @brief Free the value of a hash node, unless it is stored inline.
+static void free_value (const htable_t *table, struct htable_node *node) {
+
+    // A multimap value is the list of values, every one of them copied by vcpy.
+    if (table->flags & HTABLE_MULTI) {
+        struct htable_values *values = node->value;
+
+        for (size_t idx = 0; values != NULL && idx < values->count; idx++) {
+            table->cbs.vfree(values->items[idx]);
+        }
+
+        free(values);
+        return;
+    }
+
+    if (table->inline_size == 0 || node->value != (void *) (node->data + table->inline_size)) {
+        table->cbs.vfree(node->value);
+    }
+}
+
+/// @brief Free the key, the value and the hash node of an unlinked hash node.
+void htable_free_node (const htable_t *table, struct htable_node *node) {
+    free_key(table, node);
+    free_value(table, node);
+    free_node(table, node);
+}
+
+/// @brief Free every hash node of a bucket array, and the array itself.
+/// @param table The hash table owning the bucket array.
+/// @param buckets The bucket array to free.
+/// @param size The number of buckets in the bucket array.
+static void free_buckets (const htable_t *table, struct htable_node **buckets, size_t size) {
+
+    // Nothing to do per node when the allocator releases them all at once and keys and values are not owned.
+    const int bulk = table->alloc.release != NULL;
+
+    if (bulk && table->cbs.kfree == htable_default_free && table->cbs.vfree == htable_default_free && !(table->flags & HTABLE_MULTI)) {
+        free(buckets);
+        return;
+    }
+
+    for (size_t idx = 0; idx < size; idx++) {
+
+        struct htable_node *current = buckets[idx];
+
+        // Traverse the linked list, empty buckets are skipped.
+        while (current != NULL) {
+            struct htable_node *next = current->next;
+
+            // Free the key and value.
+            free_key(table, current);
+            free_value(table, current);
+
+            // Free the hash node, unless the allocator releases every node at once.
+            if (!bulk) {
+                free_node(table, current);
+            }
+
+            current = next;
+        }
+    }
+
+    free(buckets);
+}
+
+/// @brief Migrate buckets from the previous hash table to the current one.
+void htable_rehash_step (htable_t *table, size_t steps) {
+
+    if (table->rehash_table == NULL) {
+        return;
+    }
+
+    HTABLE_STAT_CLOCK(start);
+
+    // Bound the number of empty buckets visited so sparse tables do not stall a single operation.
+    size_t empty_visits = steps * 10U;
+
+    while (steps > 0 && table->rehash_idx < table->rehash_size) {
+
+        struct htable_node *current = table->rehash_table[table->rehash_idx];
+
+        if (current == NULL) {
+            table->rehash_idx++;
+
+            if (--empty_visits == 0) {
+                break;
+            }
+            continue;
+        }
+
+        // Move every hash node of the bucket to the head of its new bucket, reusing the stored hash unless
+        // the migration rehashes the keys.
+        while (current != NULL) {
+            struct htable_node *next = current->next;
+
+            if (table->rehash_rekey) {
+                current->hash = htable_node_hash(table, current);
+            }
+
+            const size_t idx = htable_bucket_index(table, current->hash, table->size);
+
+            current->next = table->table[idx];
+            table->table[idx] = current;
+
+            current = next;
+        }
+
+        table->rehash_table[table->rehash_idx++] = NULL;
+        steps--;
+    }
+
+    // Release the previous hash table once every bucket has been migrated.
+    if (table->rehash_idx == table->rehash_size) {
+        free(table->rehash_table);
+        table->rehash_table = NULL;
+        table->rehash_size = 0;
+        table->rehash_idx = 0;
+
+        // The timers find their entries by hash. Rescheduling is best effort, entries it misses still expire lazily.
+        if (table->rehash_rekey) {
+            table->rehash_rekey = 0;
+            (void) htable_ttl_reschedule(table);
+        }
+    }
+
+    HTABLE_STAT_ELAPSED(table, start);
+}
+
+/// @brief Start migrating the chaining engine to a bucket array of the given size.
+int htable_chain_resize (htable_t *table, size_t size) {
+
+    // Finish the previous migration before starting another one.
+    while (table->rehash_table != NULL) {
+        htable_rehash_step(table, table->rehash_size);
+    }
+
+    // Moving hash nodes between buckets would change what the snapshots see.
+    if (table->snapshots != NULL && htable_snapshot_detach(table, 0) != 0) {
+        return -2;
+    }
+
+    struct htable_node **buckets = NULL;
+
+    HTABLE_STAT_RESIZE(table);
+    HTABLE_STAT_CLOCK(start);
+
+    if ((buckets = calloc(size, sizeof(*buckets))) == NULL) {
+        return -2;
+    }
+
+    table->rehash_table = table->table;
+    table->rehash_size = table->size;
+    table->rehash_idx = 0;
+
+    table->table = buckets;
+    table->size = size;
+
+    HTABLE_STAT_ELAPSED(table, start);
+
+    return 0;
+}
+
+/// @brief Start growing the hash table if the load factor has been exceeded.
+/// @param table The hash table to grow.
+static void grow_if_needed (htable_t *table) {
+
+    if (table->flags & HTABLE_FIXED_SIZE) {
+        return;
+    }
+
+    if ((float) table->count <= table->max_load * (float) table->size) {
+        return;
+    }
+
+    // Growing would copy every bucket into the snapshots at once, so the table runs at a higher load until they go.
+    if (table->snapshots != NULL) {
+        return;
+    }
+
+    // Growing is best effort, the table keeps working at a higher load on failure.
+    (void) htable_chain_resize(table, table->size * 2U);
+}
+
+/// @brief Check whether a hash node holds the key.
+/// @param table The hash table owning the hash node.
+/// @param node The hash node to compare, its hash already matches.
+/// @param key The key to compare against.
+/// @param len The length of a length-aware key, KEY_LEN_NONE to compare with keq.
+/// @return Non-zero if the hash node holds the key.
+static inline int node_matches (const htable_t *table, const struct htable_node *node, const void *key, size_t len) {
+
+    if (len == KEY_LEN_NONE) {
+        return table->keq(node->key, key);
+    }
+
+    // A length mismatch rejects the hash node before any byte is compared.
+    return node->key_len == len && memcmp(node->key, key, len) == 0;
+}
+
+/// @brief Locate the link referencing the hash node that holds the key.
+/// @param table The hash table to search.
+/// @param key The key for the hash node.
+/// @param len The length of a length-aware key, KEY_LEN_NONE to compare with keq.
+/// @param hash The hash value of the key.
+/// @return Pointer to the bucket or next pointer referencing the node, NULL if the key is not present.
+static struct htable_node **find_link (const htable_t *table, const void *key, size_t len, unsigned long hash) {
+
+    struct htable_node **link = &table->table[htable_bucket_index(table, hash, table->size)];
+    size_t probes = 0;
+    size_t keqs = 0;
+
+    // Traverse the linked list of the current hash table.
+    for (; *link != NULL; link = &(*link)->next) {
+        probes++;
+
+        if ((*link)->hash != hash) {
+            continue;
+        }
+
+        keqs++;
+
+        if (node_matches(table, *link, key, len)) {
+            HTABLE_CLOCK_REF(table, *link);
+            HTABLE_STAT_SEARCH(table, probes, keqs);
+            return link;
+        }
+    }
+
+    // Buckets of the previous hash table that have not been migrated yet, hashed the previous way during a rehash.
+    const unsigned long previous = table->rehash_table != NULL ? previous_hash(table, key, len, hash) : hash;
+
+    if (table->rehash_table != NULL && htable_bucket_index(table, previous, table->rehash_size) >= table->rehash_idx) {
+
+        for (link = &table->rehash_table[htable_bucket_index(table, previous, table->rehash_size)]; *link != NULL; link = &(*link)->next) {
+            probes++;
+
+            if ((*link)->hash != previous) {
+                continue;
+            }
+
+            keqs++;
+
+            if (node_matches(table, *link, key, len)) {
+                HTABLE_CLOCK_REF(table, *link);
+                HTABLE_STAT_SEARCH(table, probes, keqs);
+                return link;
+            }
+        }
+    }
+
+    HTABLE_STAT_SEARCH(table, probes, keqs);
+
+    return NULL;
+}
+
+/// @brief Check whether the time to live of a hash node has passed.
+static inline int node_expired (const htable_t *table, const struct htable_node *node) {
+    return node->expires != 0 && htable_ttl_due(node->expires, htable_ttl_now(table));
+}
+
+/// @brief Locate the link referencing the hash node that holds the key, freeing the node if it has expired.
+/// @return Pointer to the bucket or next pointer referencing the node, NULL if the key is not present or expired.
+static struct htable_node **find_live (htable_t *table, const void *key, size_t len, unsigned long hash) {
+
+    struct htable_node **link = find_link(table, key, len, hash);
+
+    if (link == NULL || !node_expired(table, *link)) {
+        return link;
+    }
+
+    struct htable_node *current = *link;
+
+    *link = current->next;
+    table->count--;
+
+    htable_free_node(table, current);
+
+    return NULL;
+}
+
+/// @brief Flag the table for a re-seed if the chain of a bucket has grown longer than max_chain.
+/// Once re-seeded, chains are only checked again after growth, so a table that stays overloaded re-seeds once.
+static void check_chain (htable_t *table, size_t idx) {
+
+    if (table->reseed_pending || table->reseed_size == table->size) {
+        return;
+    }
+
+    size_t length = 0;
+
+    for (const struct htable_node *node = table->table[idx]; node != NULL && length <= table->max_chain; node = node->next) {
+        length++;
+    }
+
+    table->reseed_pending = length > table->max_chain;
+}
+
+/// @brief Find the hash node of a key in the chaining engine, inserting it with a NULL value if it is absent.
+/// @param table The hash table to search.
+/// @param key The key for the hash node.
+/// @param len The length of a length-aware key, KEY_LEN_NONE for the plain functions.
+/// @param hash The hash value of the key.
+/// @param owned Non-zero to store the key itself, without copying it.
+/// @param inserted Set to 1 if the key was inserted, 0 if it was present.
+/// @return Pointer to the hash node, NULL on memory allocation failure.
+static struct htable_node *chain_upsert (htable_t *table, const void *key, size_t len, unsigned long hash, int owned, int *inserted) {
+
+    // The caller may write the value of a present key too.
+    if (htable_cow(table, hash) != 0) {
+        return NULL;
+    }
+
+    // Check if the key already exists in the hash table.
+    struct htable_node **link = find_live(table, key, len, hash);
+
+    if (link != NULL) {
+        *inserted = 0;
+        return *link;
+    }
+
+    // If the key does not exist, create a new hash node.
+    struct htable_node *new_node = NULL;
+
+    if ((new_node = alloc_node(table)) == NULL) {
+        return NULL;
+    }
+
+    // Owned keys are stored as is, length-aware keys need no size callback to be stored inline.
+    if (owned) {
+        new_node->key = (void *) key;
+        new_node->key_len = 0;
+    }
+    else if (len == KEY_LEN_NONE) {
+        new_node->key = htable_store_inline(table, new_node->data, key, table->cbs.ksize, table->cbs.kcpy);
+        new_node->key_len = 0;
+    }
+    else {
+        // kcpy has no length to go by, so longer length-aware keys get a copy of exactly their bytes.
+        new_node->key = len <= table->inline_size ? new_node->data : malloc(len);
+        new_node->key_len = (unsigned int) len;
+
+        if (new_node->key == NULL) {
+            free_node(table, new_node);
+            return NULL;
+        }
+
+        memcpy(new_node->key, key, len);
+    }
+
+    // A full capacity-bounded table makes room only once the insertion can no longer fail.
+    if (table->capacity > 0 && table->count >= table->capacity) {
+        htable_evict(table);
+    }
+
+    // Calculate the hash index, new hash nodes always go into the current hash table.
+    const size_t hashed_key = htable_bucket_index(table, hash, table->size);
+
+    new_node->value = NULL;
+    new_node->ref = 0;
+    new_node->expires = 0;
+    new_node->hash = hash;
+    new_node->next = table->table[hashed_key];
+
+    table->table[hashed_key] = new_node;
+    table->count++;
+
+    if (table->max_chain > 0) {
+        check_chain(table, hashed_key);
+    }
+
+    // Growing only moves hash nodes between buckets, the node itself stays put.
+    grow_if_needed(table);
+
+    *inserted = 1;
+
+    return new_node;
+}
+
+/// @brief Insert a key-value pair into the chaining engine.
+/// @param table The hash table to insert the key-value pair into.
+/// @param key The key for the hash node.
+/// @param len The length of a length-aware key, KEY_LEN_NONE for the plain functions.
+/// @param value The value for the hash node.
+/// @param hash The hash value of the key.
+/// @param expires The expiry tick of the hash node, 0 if it never expires.
+/// @return 0 on success, -2 on memory allocation failure.
+static int chain_insert (htable_t *table, const void *key, size_t len, const void *value, unsigned long hash, unsigned long long expires) {
+
+    int inserted = 0;
+    struct htable_node *node = chain_upsert(table, key, len, hash, 0, &inserted);
+
+    if (node == NULL) {
+        return -2;
+    }
+
+    // Free the previous value and update it with the new value.
+    if (!inserted) {
+        free_value(table, node);
+    }
+
+    node->value = htable_store_inline(table, node->data + table->inline_size, value, table->cbs.vsize, table->cbs.vcpy);
+    node->expires = expires;
+
+    return 0;
+}
+
+/// @brief Unlink the hash node holding the key from the chaining engine.
+/// @return Pointer to the unlinked hash node, NULL if the key is not present.
+static struct htable_node *chain_unlink (htable_t *table, const void *key, size_t len, unsigned long hash) {
+
+    struct htable_node **link = find_live(table, key, len, hash);
+
+    if (link == NULL) {
+        return NULL;
+    }
+
+    struct htable_node *current = *link;
+
+    // Link the previous hash node to the next hash node.
+    *link = current->next;
+
+    table->count--;
+
+    return current;
+}
+
+/// @brief Hand a key or value of a hash node over to the caller.
+/// Inline storage dies with the hash node, so it is handed out as a malloc(3) copy.
+/// @param table The hash table owning the hash node.
+/// @param part The stored key or value.
+/// @param storage The inline storage of the key or value.
+/// @param size The size callback of the key or value.
+/// @param out Output pointer receiving the key or value.
+/// @return 0 on success, -2 on memory allocation failure.
+static int take_part (const htable_t *table, void *part, unsigned char *storage, htable_size_t size, void **out) {
+
+    if (table->inline_size == 0 || part != (void *) storage) {
+        *out = part;
+        return 0;
+    }
+
+    const size_t len = size(part);
+
+    if ((*out = malloc(len > 0 ? len : 1U)) == NULL) {
+        return -2;
+    }
+
+    memcpy(*out, part, len);
+
+    return 0;
+}
+
+/// @brief Unlink a key-value pair from the chaining engine, handing it to the caller.
+/// @return 0 on success, -1 if the key is not present, -2 on memory allocation failure.
+static int chain_take (htable_t *table, const void *key, unsigned long hash, void **key_out, void **value_out) {
+
+    if (htable_cow(table, hash) != 0) {
+        return -2;
+    }
+
+    struct htable_node **link = find_live(table, key, KEY_LEN_NONE, hash);
+
+    if (link == NULL) {
+        return -1;
+    }
+
+    struct htable_node *current = *link;
+    void *stored_key = NULL;
+    void *stored_value = NULL;
+
+    // Copy inline parts out before anything is unlinked, so a failure leaves the table untouched.
+    if (key_out != NULL && take_part(table, current->key, current->data, table->cbs.ksize, &stored_key) != 0) {
+        return -2;
+    }
+
+    if (value_out != NULL && take_part(table, current->value, current->data + table->inline_size, table->cbs.vsize, &stored_value) != 0) {
+        if (stored_key != current->key) {
+            free(stored_key);
+        }
+        return -2;
+    }
+
+    *link = current->next;
+    table->count--;
+
+    // Free the parts that are not handed over.
+    if (key_out != NULL) {
+        *key_out = stored_key;
+    } else {
+        free_key(table, current);
+    }
+
+    if (value_out != NULL) {
+        *value_out = stored_value;
+    } else {
+        free_value(table, current);
+    }
+
+    free_node(table, current);
+
+    return 0;
+}
+
+/// @brief Remove a key-value pair from the chaining engine.
+/// @return 0 on success, -1 if the key is not present, -2 if a snapshot could not copy the bucket.
+static int chain_remove (htable_t *table, const void *key, size_t len, unsigned long hash) {
+
+    if (htable_cow(table, hash) != 0) {
+        return -2;
+    }
+
+    struct htable_node *current = chain_unlink(table, key, len, hash);
+
+    if (current == NULL) {
+        return -1;
+    }
+
+    htable_free_node(table, current);
+
+    return 0;
+}
+
+/// @brief Free what an owned insertion of an existing key replaces.
+/// The table already owns an equal key, so the one handed over is freed along with the previous value,
+/// unless the caller handed over the very same objects.
+/// @param table The hash table the key was inserted into.
+/// @param slot The value slot of the key as returned by htable_upsert_hashed.
+/// @param key The key handed over.
+/// @param value The value handed over.
+static void release_replaced (const htable_t *table, void **slot, void *key, void *value) {
+
+    if (table->engine == HTABLE_ENGINE_CHAIN) {
+        struct htable_node *node = (struct htable_node *) (void *) ((char *) slot - offsetof(struct htable_node, value));
+
+        if (node->key != key) {
+            table->cbs.kfree(key);
+        }
+
+        if (node->value != value) {
+            free_value(table, node);
+        }
+        return;
+    }
+
+    const struct htable_slot *entry = (const struct htable_slot *) (void *) ((char *) slot - offsetof(struct htable_slot, value));
+
+    if (entry->key != key) {
+        table->cbs.kfree(key);
+    }
+
+    if (entry->value != value) {
+        table->cbs.vfree(entry->value);
+    }
+}
+
+/// @brief Insert a key-value pair whose hash has already been computed.
+int htable_insert_hashed (htable_t *table, const void *key, const void *value, unsigned long hash) {
+
+    switch (table->engine) {
+        case HTABLE_ENGINE_ROBIN_HOOD:
+            return htable_robin_insert(table, key, value, hash);
+        case HTABLE_ENGINE_SWISS:
+            return htable_swiss_insert(table, key, value, hash);
+        case HTABLE_ENGINE_COMPACT:
+            return htable_compact_insert(table, key, value, hash);
+        default:
+            break;
+    }
+
+    return chain_insert(table, key, KEY_LEN_NONE, value, hash, 0);
+}
+
+/// @brief Find the value slot of a key whose hash has already been computed, inserting the key if it is absent.
+void **htable_upsert_hashed (htable_t *table, const void *key, unsigned long hash, int owned, int *inserted) {
+
+    switch (table->engine) {
+        case HTABLE_ENGINE_ROBIN_HOOD:
+            return htable_robin_upsert(table, key, hash, owned, inserted);
+        case HTABLE_ENGINE_SWISS:
+            return htable_swiss_upsert(table, key, hash, owned, inserted);
+        case HTABLE_ENGINE_COMPACT:
+            return htable_compact_upsert(table, key, hash, owned, inserted);
+        default:
+            break;
+    }
+
+    struct htable_node *node = chain_upsert(table, key, KEY_LEN_NONE, hash, owned, inserted);
+
+    return node != NULL ? &node->value : NULL;
+}
+
+/// @brief Unlink a key-value pair whose hash has already been computed, handing it to the caller.
+int htable_take_hashed (htable_t *table, const void *key, unsigned long hash, void **key_out, void **value_out) {
+
+    switch (table->engine) {
+        case HTABLE_ENGINE_ROBIN_HOOD:
+            return htable_robin_take(table, key, hash, key_out, value_out);
+        case HTABLE_ENGINE_SWISS:
+            return htable_swiss_take(table, key, hash, key_out, value_out);
+        case HTABLE_ENGINE_COMPACT:
+            return htable_compact_take(table, key, hash, key_out, value_out);
+        default:
+            return chain_take(table, key, hash, key_out, value_out);
+    }
+}
+
+/// @brief Retrieve a value whose key hash has already been computed.
+void *htable_get_hashed (const htable_t *table, const void *key, unsigned long hash) {
+
+    void *value = NULL;
+
+    switch (table->engine) {
+        case HTABLE_ENGINE_ROBIN_HOOD:
+            value = htable_robin_get(table, key, hash);
+            break;
+        case HTABLE_ENGINE_SWISS:
+            value = htable_swiss_get(table, key, hash);
+            break;
+        case HTABLE_ENGINE_COMPACT:
+            value = htable_compact_get(table, key, hash);
+            break;
+        case HTABLE_ENGINE_IMAGE:
+            value = htable_image_get(table, key, hash);
+            break;
+        default: {
+            struct htable_node **link = find_link(table, key, KEY_LEN_NONE, hash);
+            value = link != NULL && !node_expired(table, *link) ? (*link)->value : NULL;
+            break;
+        }
+    }
+
+    HTABLE_STAT_LOOKUP(table, value != NULL);
+
+    return value;
+}
+
+/// @brief Remove a key-value pair whose hash has already been computed.
+int htable_remove_hashed (htable_t *table, const void *key, unsigned long hash) {
+
+    switch (table->engine) {
+        case HTABLE_ENGINE_ROBIN_HOOD:
+            return htable_robin_remove(table, key, hash);
+        case HTABLE_ENGINE_SWISS:
+            return htable_swiss_remove(table, key, hash);
+        case HTABLE_ENGINE_COMPACT:
+            return htable_compact_remove(table, key, hash);
+        default:
+            break;
+    }
+
+    return chain_remove(table, key, KEY_LEN_NONE, hash);
 }
 
-static void *htable_default_copy (const void *src) {
-    return (void *) src;
+/// @brief Prefetch the bucket or slot a lookup of the hash touches first.
+/// @param table The hash table to prefetch from.
+/// @param hash The hash value of the key.
+static void prefetch_bucket (const htable_t *table, unsigned long hash) {
+
+    switch (table->engine) {
+        case HTABLE_ENGINE_ROBIN_HOOD:
+            htable_robin_prefetch(table, hash);
+            break;
+        case HTABLE_ENGINE_SWISS:
+            htable_swiss_prefetch(table, hash);
+            break;
+        case HTABLE_ENGINE_COMPACT:
+            htable_compact_prefetch(table, hash);
+            break;
+        case HTABLE_ENGINE_IMAGE:
+            htable_image_prefetch(table, hash);
+            break;
+        default:
+            HTABLE_PREFETCH(&table->table[htable_bucket_index(table, hash, table->size)]);
+            break;
+    }
 }
 
-static void htable_default_free (void *src) {
-    (void) src;
-    return;
+/// @brief Prefetch the first hash node of the bucket of the hash, chaining engine only.
+/// @param table The hash table to prefetch from.
+/// @param hash The hash value of the key.
+static void prefetch_node (const htable_t *table, unsigned long hash) {
+
+    if (table->engine == HTABLE_ENGINE_CHAIN) {
+        const struct htable_node *head = table->table[htable_bucket_index(table, hash, table->size)];
+
+        if (head != NULL) {
+            HTABLE_PREFETCH(head);
+        }
+    }
+}
+
+/// @brief Hash a block of keys and prefetch the memory their lookups touch.
+/// @param table The hash table the keys are looked up in.
+/// @param keys The keys of the block.
+/// @param hashes Output array receiving the hash value of every key.
+/// @param n The number of keys in the block, at most HTABLE_BATCH_SIZE.
+static void prefetch_block (const htable_t *table, const void *const *keys, unsigned long *hashes, size_t n) {
+
+    // Hash the whole block first so the bucket loads overlap instead of serializing.
+    for (size_t idx = 0; idx < n; idx++) {
+        hashes[idx] = htable_hash_key(table, keys[idx]);
+        prefetch_bucket(table, hashes[idx]);
+    }
+
+    for (size_t idx = 0; idx < n; idx++) {
+        prefetch_node(table, hashes[idx]);
+    }
 }
 
 // --- Function Definitions --- //
 
 /// @brief Create a hash table with the specified size.
 htable_t *htable_create (size_t size, htable_hash_t hash, htable_keq_t keq, const struct callbacks *cbs) {
+    return htable_create_ex(size, hash, keq, cbs, NULL);
+}
+
+/// @brief Create a hash table with the specified size and configuration.
+htable_t *htable_create_ex (size_t size, htable_hash_t hash, htable_keq_t keq, const struct callbacks *cbs, const struct htable_opts *opts) {
+
+    const htable_seeded_hash_t seeded_hash = opts != NULL ? opts->seeded_hash : NULL;
+
+    if (size == 0 || (hash == NULL && seeded_hash == NULL) || keq == NULL) {
+        return NULL;
+    }
+
+    const enum htable_engine engine = opts != NULL ? opts->engine : HTABLE_ENGINE_CHAIN;
+
+    if (engine != HTABLE_ENGINE_CHAIN && engine != HTABLE_ENGINE_ROBIN_HOOD && engine != HTABLE_ENGINE_SWISS && engine != HTABLE_ENGINE_COMPACT) {
+        return NULL;
+    }
 
-    if (size == 0 || hash == NULL || keq == NULL) {
+    const int open_addressing = engine == HTABLE_ENGINE_ROBIN_HOOD || engine == HTABLE_ENGINE_SWISS;
+
+    if (opts != NULL && opts->max_load < 0.0f) {
+        return NULL;
+    }
+
+    if (opts != NULL && opts->allocator != NULL && (opts->allocator->alloc == NULL || opts->allocator->free == NULL)) {
+        return NULL;
+    }
+
+    // Open addressing needs free slots to terminate its probe sequences, a compact slot holds one entry at most.
+    if (opts != NULL && (open_addressing ? opts->max_load >= 1.0f : engine == HTABLE_ENGINE_COMPACT && opts->max_load > 1.0f)) {
+        return NULL;
+    }
+
+    // Slots move during probing and resizing, only hash nodes can keep inline keys and values at a stable address.
+    if (opts != NULL && engine != HTABLE_ENGINE_CHAIN && opts->inline_size > 0) {
+        return NULL;
+    }
+
+    // Only hash nodes know how to free a list of values.
+    if (opts != NULL && engine != HTABLE_ENGINE_CHAIN && (opts->flags & HTABLE_MULTI)) {
+        return NULL;
+    }
+
+    // Re-seeding only helps hash functions that take the seed, a custom hash_n does not, and only chains have a length to bound.
+    if (opts != NULL && opts->max_chain > 0 && (engine != HTABLE_ENGINE_CHAIN || seeded_hash == NULL || opts->hash_n != NULL)) {
         return NULL;
     }
 
@@ -67,18 +925,82 @@ htable_t *htable_create (size_t size, htable_hash_t hash, htable_keq_t keq, cons
         return NULL;
     }
 
-    // Allocate memory for the hash table.;
-    if ((table->table = calloc(size, sizeof(*table->table))) == NULL) {
-        free(table);
-        return NULL;
+    table->engine = engine;
+    table->flags = opts != NULL ? opts->flags : 0U;
+
+    // Round the inline storage up so the value following the key stays aligned.
+    if (opts != NULL && opts->inline_size > 0) {
+        const size_t align = _Alignof(max_align_t);
+        table->inline_size = (opts->inline_size + align - 1U) / align * align;
     }
 
-    // Initialize the remaining fields of the hash table.
-    table->size = size;
+    table->node_size = sizeof(struct htable_node) + 2U * table->inline_size;
+
+    // Allocate the slot and bucket arrays of the compact engine, which loads its chains like the chaining engine.
+    if (engine == HTABLE_ENGINE_COMPACT) {
+        if (htable_compact_init(table, size) != 0) {
+            free(table);
+            return NULL;
+        }
+
+        table->max_load = HTABLE_DEFAULT_MAX_LOAD;
+    }
+    // Allocate the slot array of the open-addressing engines.
+    else if (engine != HTABLE_ENGINE_CHAIN) {
+        const int rc = engine == HTABLE_ENGINE_SWISS ? htable_swiss_init(table, size) : htable_robin_init(table, size);
+
+        if (rc != 0) {
+            free(table);
+            return NULL;
+        }
+
+        table->max_load = HTABLE_DEFAULT_OA_MAX_LOAD;
+    }
+    else {
+        // Round the size up so buckets can be indexed with a mask.
+        if (table->flags & HTABLE_POW2) {
+            size_t capacity = 1U;
+
+            while (capacity < size) {
+                capacity <<= 1U;
+            }
+
+            size = capacity;
+        }
+
+        // Allocate memory for the hash table.
+        if ((table->table = calloc(size, sizeof(*table->table))) == NULL) {
+            free(table);
+            return NULL;
+        }
+
+        table->size = size;
+        table->max_load = HTABLE_DEFAULT_MAX_LOAD;
+    }
+
+    // Configuration.
+    if (opts != NULL) {
+        table->max_load = opts->max_load > 0.0f ? opts->max_load : table->max_load;
+    }
+
+    // Capacity-bounded tables evict instead of growing past the bound.
+    if (opts != NULL) {
+        table->capacity = opts->capacity;
+        table->evict = opts->evict;
+        table->evict_ctx = opts->evict_ctx;
+    }
 
     // Callbacks.
     table->hash = hash;
     table->keq = keq;
+    table->seeded_hash = seeded_hash;
+    table->hash_n = opts != NULL && opts->hash_n != NULL ? opts->hash_n : htable_default_hash_n;
+
+    // A seed nobody outside the process knows, unless the caller needs reproducible hashes.
+    if (seeded_hash != NULL) {
+        table->seed = opts->seed != 0 ? opts->seed : htable_seed_random();
+        table->max_chain = opts->max_chain;
+    }
 
     table->cbs.kcpy = htable_default_copy;
     table->cbs.vcpy = htable_default_copy;
@@ -91,6 +1013,33 @@ htable_t *htable_create (size_t size, htable_hash_t hash, htable_keq_t keq, cons
         table->cbs.vcpy = cbs->vcpy ? cbs->vcpy : table->cbs.vcpy;
         table->cbs.kfree = cbs->kfree ? cbs->kfree : table->cbs.kfree;
         table->cbs.vfree = cbs->vfree ? cbs->vfree : table->cbs.vfree;
+        table->cbs.ksize = cbs->ksize;
+        table->cbs.vsize = cbs->vsize;
+    }
+
+    // Hash node allocator.
+    table->alloc.alloc = htable_default_alloc;
+    table->alloc.free = htable_default_dealloc;
+
+    if (opts != NULL && opts->allocator != NULL) {
+        table->alloc = *opts->allocator;
+    }
+
+    // Only the chaining engine allocates hash nodes.
+    if ((table->flags & HTABLE_SLAB) && engine == HTABLE_ENGINE_CHAIN) {
+        if ((table->slab = htable_slab_create(table->node_size, 0)) == NULL) {
+            htable_destroy(table);
+            return NULL;
+        }
+
+        // The slab is owned by the hash table, destroying it frees every hash node at once.
+        table->alloc = htable_slab_allocator(table->slab);
+        table->alloc.release = htable_release_slab;
+    }
+
+    if (htable_stats_attach(table) != 0) {
+        htable_destroy(table);
+        return NULL;
     }
 
     return table;
@@ -99,32 +1048,53 @@ htable_t *htable_create (size_t size, htable_hash_t hash, htable_keq_t keq, cons
 /// @brief Destroy the hash table and free resources.
 void htable_destroy (htable_t *table) {
 
-    if (table == NULL || table->table == NULL) {
+    if (table == NULL) {
         return;
     }
 
-    // Free the hash nodes.
-    for (size_t idx = 0; idx < table->size; idx++) {
+    htable_stats_detach(table);
+    htable_ttl_destroy(table);
 
-        struct htable_node *current = table->table[idx];
-
-        // Traverse the linked list.
-        do {
-            struct htable_node *next = current->next;
+    switch (table->engine) {
+        case HTABLE_ENGINE_ROBIN_HOOD:
+            htable_robin_destroy(table);
+            free(table);
+            return;
+        case HTABLE_ENGINE_SWISS:
+            htable_swiss_destroy(table);
+            free(table);
+            return;
+        case HTABLE_ENGINE_COMPACT:
+            htable_compact_destroy(table);
+            free(table);
+            return;
+        case HTABLE_ENGINE_IMAGE:
+            htable_image_destroy(table);
+            free(table);
+            return;
+        default:
+            break;
+    }
 
-            // Free the key and value.
-            table->cbs.kfree(current->key);
-            table->cbs.vfree(current->value);
+    if (table->table == NULL) {
+        return;
+    }
 
-            // Free the hash node.
-            free(current);
+    // Snapshots may outlive the table, they take over every bucket still shared.
+    (void) htable_snapshot_detach(table, 1);
 
-            current = next;
-        } while (current != NULL);
+    // Free the hash nodes of the previous hash table while a migration is in progress.
+    if (table->rehash_table != NULL) {
+        free_buckets(table, table->rehash_table, table->rehash_size);
     }
 
-    // Free the hash table array.
-    free(table->table);
+    // Free the hash nodes and the hash table array.
+    free_buckets(table, table->table, table->size);
+
+    // Release every hash node at once.
+    if (table->alloc.release != NULL) {
+        table->alloc.release(table->alloc.ctx);
+    }
 
     // Free the hash table.
     free(table);
@@ -133,125 +1103,373 @@ void htable_destroy (htable_t *table) {
 /// @brief Insert a key-value pair into the hash table.
 int htable_insert (htable_t *table, const void *key, const void *value) {
 
-    if (table == NULL || table->table == NULL || value == NULL) {
+    // The value of a key of a multimap is its value array, only htable_insert_multi writes it.
+    if (table == NULL || (table->table == NULL && table->slots == NULL) || value == NULL || (table->flags & HTABLE_MULTI)) {
         return -1;
     }
 
-    // Calculate the hash index.
-    const size_t hashed_key = get_hash(table, key);
+    htable_rehash_step(table, HTABLE_REHASH_STEP);
 
-    // Get the current hash node corresponding to the hashed key.
-    struct htable_node *current = table->table[hashed_key];
+    // A chain flooded by an earlier insert is broken up before this key is hashed.
+    htable_reseed_if_pending(table);
 
-    // Check if there is another hash node present already, if not, create a new one.
-    if (current == NULL) {
-        struct htable_node *new_node = NULL;
+    // Calculate the hash value once for both hash tables.
+    return htable_insert_hashed(table, key, value, htable_hash_key(table, key));
+}
 
-        if ((new_node = malloc(sizeof(*new_node))) == NULL) {
-            return -2;
-        }
+/// @brief Remove a key-value pair from the hash table.
+int htable_remove (htable_t *table, const void *key) {
+
+    if (table == NULL || (table->table == NULL && table->slots == NULL)) {
+        return -1;
+    }
+
+    htable_rehash_step(table, HTABLE_REHASH_STEP);
+
+    return htable_remove_hashed(table, key, htable_hash_key(table, key));
+}
 
-        new_node->key = table->cbs.kcpy(key);
-        new_node->value = table->cbs.vcpy(value);
-        new_node->next = NULL;
+/// @brief Get the hash node for the specified key.
+void *htable_get (htable_t *table, const void *key) {
 
-        table->table[hashed_key] = new_node;
+    if (table == NULL || (table->table == NULL && table->slots == NULL && table->image == NULL)) {
+        return NULL;
     }
-    // Traverse the linked list.
-    else {
-        struct htable_node *prev = NULL;
-        // Check if the key already exists in the current linked list.
-        do {
-            if (table->keq(current->key, key)) {
-                // Free the previous value and update it with the new value.
-                table->cbs.vfree(current->value);
-                current->value = table->cbs.vcpy(value);
-                return 0;
-            }
-            // Move to the next hash node.
-            prev = current;
-            current = current->next;
-        } while (current != NULL);
 
-        // If the key does not exist in the linked list, create a new hash node.
-        struct htable_node *new_node = NULL;
+    htable_rehash_step(table, HTABLE_REHASH_STEP);
+
+    return htable_get_hashed(table, key, htable_hash_key(table, key));
+}
+
+/// @brief Insert a key-value pair, taking ownership of both instead of copying them.
+int htable_insert_owned (htable_t *table, void *key, void *value) {
+
+    // The value of a key of a multimap is its value array, only htable_insert_multi writes it.
+    if (table == NULL || (table->table == NULL && table->slots == NULL) || value == NULL || (table->flags & HTABLE_MULTI)) {
+        return -1;
+    }
+
+    htable_rehash_step(table, HTABLE_REHASH_STEP);
+    htable_reseed_if_pending(table);
+
+    int inserted = 0;
+    void **slot = NULL;
+
+    if ((slot = htable_upsert_hashed(table, key, htable_hash_key(table, key), 1, &inserted)) == NULL) {
+        return -2;
+    }
+
+    if (!inserted) {
+        release_replaced(table, slot, key, value);
+    }
+
+    *slot = value;
+
+    return 0;
+}
+
+/// @brief Unlink a key-value pair and hand the stored key and value to the caller.
+int htable_take (htable_t *table, const void *key, void **key_out, void **value_out) {
+
+    if (table == NULL || (table->table == NULL && table->slots == NULL)) {
+        return -1;
+    }
+
+    htable_rehash_step(table, HTABLE_REHASH_STEP);
+
+    return htable_take_hashed(table, key, htable_hash_key(table, key), key_out, value_out);
+}
+
+/// @brief Find the value slot of a key, inserting the key if it is absent.
+int htable_get_or_insert (htable_t *table, const void *key, void ***slot) {
+
+    if (table == NULL || (table->table == NULL && table->slots == NULL) || slot == NULL || (table->flags & HTABLE_MULTI)) {
+        return -1;
+    }
+
+    htable_rehash_step(table, HTABLE_REHASH_STEP);
+    htable_reseed_if_pending(table);
+
+    int inserted = 0;
+
+    // One hash and one probe sequence for both the lookup and the insertion.
+    if ((*slot = htable_upsert_hashed(table, key, htable_hash_key(table, key), 0, &inserted)) == NULL) {
+        return -2;
+    }
+
+    return inserted;
+}
+
+/// @brief Modify the value of a key in place, inserting the key if it is absent.
+int htable_update (htable_t *table, const void *key, htable_update_t fn, void *ctx) {
+
+    if (table == NULL || (table->table == NULL && table->slots == NULL) || fn == NULL || (table->flags & HTABLE_MULTI)) {
+        return -1;
+    }
+
+    htable_rehash_step(table, HTABLE_REHASH_STEP);
+    htable_reseed_if_pending(table);
+
+    const unsigned long hash = htable_hash_key(table, key);
+    int inserted = 0;
+    void **slot = NULL;
+
+    if ((slot = htable_upsert_hashed(table, key, hash, 0, &inserted)) == NULL) {
+        return -2;
+    }
+
+    fn(slot, ctx);
+
+    // A NULL value removes the key, the only case that probes a second time.
+    if (*slot == NULL) {
+        (void) htable_remove_hashed(table, key, hash);
+    }
+
+    return inserted;
+}
+
+/// @brief Insert or update a key-value pair that expires after the given time to live.
+int htable_insert_ttl (htable_t *table, const void *key, const void *value, unsigned long long ttl_ms) {
+
+    if (table == NULL || table->table == NULL || value == NULL || ttl_ms == 0 || ttl_ms > HTABLE_TTL_MAX_MS || (table->flags & HTABLE_MULTI)) {
+        return -1;
+    }
 
-        if ((new_node = malloc(sizeof(*new_node))) == NULL) {
+    htable_rehash_step(table, HTABLE_REHASH_STEP);
+    htable_reseed_if_pending(table);
+
+    const unsigned long hash = htable_hash_key(table, key);
+    unsigned long long expires = 0;
+
+    // Schedule first, a timer left behind by a failed insertion finds nothing to expire.
+    if (htable_ttl_schedule(table, hash, ttl_ms, &expires) != 0) {
+        return -2;
+    }
+
+    return chain_insert(table, key, KEY_LEN_NONE, value, hash, expires);
+}
+
+/// @brief Add a value to a key of an HTABLE_MULTI table.
+int htable_insert_multi (htable_t *table, const void *key, const void *value) {
+
+    if (table == NULL || table->table == NULL || !(table->flags & HTABLE_MULTI) || value == NULL) {
+        return -1;
+    }
+
+    htable_rehash_step(table, HTABLE_REHASH_STEP);
+    htable_reseed_if_pending(table);
+
+    const unsigned long hash = htable_hash_key(table, key);
+    int inserted = 0;
+    struct htable_node *node = chain_upsert(table, key, KEY_LEN_NONE, hash, 0, &inserted);
+
+    if (node == NULL) {
+        return -2;
+    }
+
+    struct htable_values *values = node->value;
+
+    // Double the value array once it is full, a new key starts with HTABLE_MULTI_MIN values.
+    if (values == NULL || values->count == values->cap) {
+
+        const size_t cap = values != NULL ? values->cap * 2U : HTABLE_MULTI_MIN;
+        struct htable_values *grown = realloc(values, sizeof(*grown) + cap * sizeof(grown->items[0]));
+
+        if (grown == NULL) {
+            // A key without values is not left behind.
+            if (inserted) {
+                (void) chain_remove(table, key, KEY_LEN_NONE, hash);
+            }
             return -2;
         }
 
-        new_node->key = table->cbs.kcpy(key);
-        new_node->value = table->cbs.vcpy(value);
-        prev->next = new_node;
+        grown->count = values != NULL ? grown->count : 0;
+        grown->cap = cap;
+        node->value = values = grown;
     }
 
+    values->items[values->count++] = table->cbs.vcpy(value);
+
     return 0;
 }
 
-/// @brief Remove a key-value pair from the hash table.
-int htable_remove (htable_t *table, const void *key) {
+/// @brief Retrieve every value of a key of an HTABLE_MULTI table.
+void *const *htable_get_all (htable_t *table, const void *key, size_t *n) {
+
+    if (n != NULL) {
+        *n = 0;
+    }
+
+    if (table == NULL || table->table == NULL || !(table->flags & HTABLE_MULTI) || n == NULL) {
+        return NULL;
+    }
+
+    const struct htable_values *values = htable_get(table, key);
+
+    if (values == NULL) {
+        return NULL;
+    }
+
+    *n = values->count;
+
+    return values->items;
+}
+
+/// @brief Count the values of a key of an HTABLE_MULTI table.
+size_t htable_count_key (htable_t *table, const void *key) {
+
+    size_t n = 0;
+
+    (void) htable_get_all(table, key, &n);
 
-    if (table == NULL || table->table == NULL) {
+    return n;
+}
+
+/// @brief Insert a key-value pair whose key is a byte string of the given length.
+/// A length of 0 marks the hash nodes of plain keys, so length-aware keys are at least one byte long.
+/// The hash node stores the length in 32 bits, which leaves room for a 64-bit expiry tick.
+int htable_insert_n (htable_t *table, const void *key, size_t key_len, const void *value) {
+
+    if (table == NULL || table->table == NULL || key == NULL || key_len == 0 || key_len >= UINT_MAX || value == NULL || (table->flags & HTABLE_MULTI)) {
         return -1;
     }
 
-    // Calculate the hash index.
-    const size_t hashed_key = get_hash(table, key);
+    htable_rehash_step(table, HTABLE_REHASH_STEP);
+    htable_reseed_if_pending(table);
+
+    return chain_insert(table, key, key_len, value, htable_hash_key_n(table, key, key_len), 0);
+}
 
-    struct htable_node *current = table->table[hashed_key];
-    struct htable_node *prev = NULL;
+/// @brief Remove a key-value pair inserted by htable_insert_n.
+int htable_remove_n (htable_t *table, const void *key, size_t key_len) {
 
-    while (current != NULL) {
-        // Check if the key exists in the linked list and remove it.
-        if (table->keq(current->key, key)) {
-            
-            // Link the previous hash node to the next hash node.
-            if (prev == NULL) {
-                table->table[hashed_key] = current->next;
-            } else {
-                prev->next = current->next;
-            }
+    if (table == NULL || table->table == NULL || key == NULL || key_len == 0 || key_len == KEY_LEN_NONE) {
+        return -1;
+    }
 
-            // Free the key and value.
-            table->cbs.kfree(current->key);
-            table->cbs.vfree(current->value);
+    htable_rehash_step(table, HTABLE_REHASH_STEP);
+
+    return chain_remove(table, key, key_len, htable_hash_key_n(table, key, key_len));
+}
+
+/// @brief Retrieve a value inserted by htable_insert_n.
+void *htable_get_n (htable_t *table, const void *key, size_t key_len) {
 
-            // Free the hash node.
-            free(current);
+    if (table == NULL || table->table == NULL || key == NULL || key_len == 0 || key_len == KEY_LEN_NONE) {
+        return NULL;
+    }
+
+    htable_rehash_step(table, HTABLE_REHASH_STEP);
+
+    struct htable_node **link = find_link(table, key, key_len, htable_hash_key_n(table, key, key_len));
+    void *value = link != NULL && !node_expired(table, *link) ? (*link)->value : NULL;
+
+    HTABLE_STAT_LOOKUP(table, value != NULL);
+
+    return value;
+}
+
+/// @brief Retrieve the values of a batch of keys.
+size_t htable_get_many (htable_t *table, const void *const *keys, size_t n, void **values) {
 
-            return 0;
+    if (table == NULL || (table->table == NULL && table->slots == NULL && table->image == NULL) || keys == NULL || values == NULL) {
+        return 0;
+    }
+
+    unsigned long hashes[HTABLE_BATCH_SIZE];
+    size_t found = 0;
+
+    for (size_t base = 0; base < n; base += HTABLE_BATCH_SIZE) {
+
+        const size_t block = n - base < HTABLE_BATCH_SIZE ? n - base : HTABLE_BATCH_SIZE;
+
+        // Keep the incremental rehash moving at the same pace as single lookups.
+        htable_rehash_step(table, HTABLE_REHASH_STEP * block);
+
+        prefetch_block(table, &keys[base], hashes, block);
+
+        // Resolve the block, its buckets and first nodes should be in cache by now.
+        for (size_t idx = 0; idx < block; idx++) {
+            values[base + idx] = htable_get_hashed(table, keys[base + idx], hashes[idx]);
+            found += values[base + idx] != NULL;
         }
-        
-        // Move to the next hash node.
-        prev = current;
-        current = current->next;
     }
 
-    return -1;
+    return found;
 }
 
-/// @brief Get the hash node for the specified key.
-void *htable_get (htable_t *table, const void *key) {
+/// @brief Probe a column of keys whose hashes are already known.
+size_t htable_probe_batch (htable_t *table, const void *const *keys, const unsigned long *hashes, size_t n, size_t *sel, void **values) {
 
-    if (table == NULL || table->table == NULL) {
-        return NULL;
+    if (table == NULL || (table->table == NULL && table->slots == NULL && table->image == NULL) || keys == NULL || hashes == NULL || sel == NULL) {
+        return 0;
     }
 
-    // Calculate the hash index.
-    const size_t hashed_key = get_hash(table, key);
+    size_t found = 0;
+
+    for (size_t base = 0; base < n; base += HTABLE_BATCH_SIZE) {
+
+        const size_t block = n - base < HTABLE_BATCH_SIZE ? n - base : HTABLE_BATCH_SIZE;
 
-    struct htable_node *current = table->table[hashed_key];
+        htable_rehash_step(table, HTABLE_REHASH_STEP * block);
 
-    // Traverse the linked list to find the hash node.
-    while (current != NULL) {
-        // Check if the key matches the current hash node.
-        if (table->keq(current->key, key)) {
-            return current->value;
+        // No hashing left to do, so the bucket loads of the block are issued back to back.
+        for (size_t idx = base; idx < base + block; idx++) {
+            prefetch_bucket(table, hashes[idx]);
         }
 
-        // Move to the next hash node.
-        current = current->next;
+        for (size_t idx = base; idx < base + block; idx++) {
+            prefetch_node(table, hashes[idx]);
+        }
+
+        // Write every position, advancing the output only on a match, so the loop carries no branch on it.
+        for (size_t idx = base; idx < base + block; idx++) {
+            void *value = htable_get_hashed(table, keys[idx], hashes[idx]);
+
+            sel[found] = idx;
+
+            if (values != NULL) {
+                values[found] = value;
+            }
+
+            found += value != NULL;
+        }
     }
 
-    return NULL;
+    return found;
+}
+
+/// @brief Insert a batch of key-value pairs into the hash table.
+int htable_insert_many (htable_t *table, const void *const *keys, const void *const *values, size_t n) {
+
+    if (table == NULL || (table->table == NULL && table->slots == NULL) || keys == NULL || values == NULL || (table->flags & HTABLE_MULTI)) {
+        return -1;
+    }
+
+    unsigned long hashes[HTABLE_BATCH_SIZE];
+
+    for (size_t base = 0; base < n; base += HTABLE_BATCH_SIZE) {
+
+        const size_t block = n - base < HTABLE_BATCH_SIZE ? n - base : HTABLE_BATCH_SIZE;
+
+        htable_rehash_step(table, HTABLE_REHASH_STEP * block);
+        htable_reseed_if_pending(table);
+
+        prefetch_block(table, &keys[base], hashes, block);
+
+        for (size_t idx = 0; idx < block; idx++) {
+
+            if (values[base + idx] == NULL) {
+                return -1;
+            }
+
+            const int rc = htable_insert_hashed(table, keys[base + idx], values[base + idx], hashes[idx]);
+
+            if (rc != 0) {
+                return rc;
+            }
+        }
+    }
+
+    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,124 @@
+// ==============================================================================
+//                             Background Teardown
+// ==============================================================================
+//
+// Description: Destruction of hash tables off the calling thread. The table is
+// handed to a detached thread that runs htable_destroy, so the caller pays for
+// one thread start instead of a walk over every node. A counter guarded by a
+// mutex tracks the teardowns still running for htable_destroy_wait.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "htable_internal.h"
+
+#include <pthread.h>    // For the teardown threads, e.g. pthread_create(3).
+
+// --- Globals --- //
+
+/// @brief Teardowns still running, guarded by pending_lock.
+static pthread_mutex_t pending_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pending_done = PTHREAD_COND_INITIALIZER;
+static size_t pending;
+
+// --- Static Function Definitions --- //
+
+/// @brief Destroy the hash table handed over and signal waiters once the last teardown is done.
+static void *destroy_thread (void *arg) {
+
+    htable_destroy(arg);
+
+    (void) pthread_mutex_lock(&pending_lock);
+
+    if (--pending == 0) {
+        (void) pthread_cond_broadcast(&pending_done);
+    }
+
+    (void) pthread_mutex_unlock(&pending_lock);
+
+    return NULL;
+}
+
+// --- Function Definitions --- //
+
+/// @brief Destroy the hash table on a background thread.
+int htable_destroy_async (htable_t *table) {
+
+    if (table == NULL) {
+        return 0;
+    }
+
+    // Snapshots stay with the caller, who may read them while the table is torn down, so they take over the
+    // buckets they share here rather than on the background thread.
+    if (table->snapshots != NULL) {
+        (void) htable_snapshot_detach(table, 1);
+    }
+
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    if (pthread_attr_init(&attr) != 0) {
+        htable_destroy(table);
+        return 1;
+    }
+
+    (void) pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    // Count the teardown before the thread can finish it.
+    (void) pthread_mutex_lock(&pending_lock);
+    pending++;
+    (void) pthread_mutex_unlock(&pending_lock);
+
+    const int rc = pthread_create(&thread, &attr, destroy_thread, table);
+
+    (void) pthread_attr_destroy(&attr);
+
+    if (rc != 0) {
+        (void) pthread_mutex_lock(&pending_lock);
+
+        if (--pending == 0) {
+            (void) pthread_cond_broadcast(&pending_done);
+        }
+
+        (void) pthread_mutex_unlock(&pending_lock);
+
+        htable_destroy(table);
+        return 1;
+    }
+
+    return 0;
+}
+
+/// @brief Wait until every teardown started by htable_destroy_async has finished.
+void htable_destroy_wait (void) {
+
+    (void) pthread_mutex_lock(&pending_lock);
+
+    while (pending > 0) {
+        (void) pthread_cond_wait(&pending_done, &pending_lock);
+    }
+
+    (void) pthread_mutex_unlock(&pending_lock);
+}
@@ -0,0 +1,298 @@
+// ==============================================================================
+//                           Hash Table Bulk Loading
+// ==============================================================================
+//
+// Description: Builds a hash table from arrays of keys and values. The table is
+// sized once for the number of pairs, the keys are hashed in parallel, and for
+// the chaining engine the pairs are partitioned by bucket with a counting sort
+// so the hash nodes of every chain are carved contiguously out of a single slab
+// chunk.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "htable_internal.h"
+
+#include <pthread.h>    // For the hashing threads, e.g. pthread_create(3).
+#include <unistd.h>     // For the number of online processors, e.g. sysconf(3).
+
+// --- Types --- //
+
+/// @brief Range of keys hashed by a single thread.
+struct build_range {
+    const htable_t *table;      // The hash table the keys are hashed for.
+    const void *const *keys;    // The keys of the whole build.
+    unsigned long *hashes;      // The hash values of the whole build.
+    size_t begin;               // The first key of the range.
+    size_t end;                 // One past the last key of the range.
+};
+
+// --- Static Function Definitions --- //
+
+static void *hash_range (void *arg) {
+
+    struct build_range *range = arg;
+
+    for (size_t idx = range->begin; idx < range->end; idx++) {
+        range->hashes[idx] = htable_hash_key(range->table, range->keys[idx]);
+    }
+
+    return NULL;
+}
+
+/// @brief Hash every key, split over several threads for large builds.
+void htable_hash_keys (const htable_t *table, const void *const *keys, unsigned long *hashes, size_t n) {
+
+    size_t threads = 1U;
+
+    if (n >= HTABLE_BUILD_PARALLEL_MIN) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+        threads = cpus > 1 ? (size_t) cpus : 1U;
+        threads = threads < HTABLE_BUILD_THREADS ? threads : HTABLE_BUILD_THREADS;
+    }
+
+    pthread_t workers[HTABLE_BUILD_THREADS];
+    struct build_range ranges[HTABLE_BUILD_THREADS];
+    int started[HTABLE_BUILD_THREADS];
+
+    for (size_t t = 0; t < threads; t++) {
+        ranges[t] = (struct build_range) { table, keys, hashes, n * t / threads, n * (t + 1U) / threads };
+        started[t] = t > 0 && pthread_create(&workers[t], NULL, hash_range, &ranges[t]) == 0;
+    }
+
+    // The calling thread hashes the first range, and every range whose thread could not be started.
+    for (size_t t = 0; t < threads; t++) {
+        if (!started[t]) {
+            (void) hash_range(&ranges[t]);
+        }
+    }
+
+    for (size_t t = 0; t < threads; t++) {
+        if (started[t]) {
+            (void) pthread_join(workers[t], NULL);
+        }
+    }
+}
+
+/// @brief Fill an empty chaining hash table, laying out the hash nodes of every bucket contiguously.
+/// @param table The hash table to fill.
+/// @param keys The keys for the hash nodes.
+/// @param values The values for the hash nodes.
+/// @param hashes The hash value of every key.
+/// @param n The number of key-value pairs.
+/// @return 0 on success, -2 on memory allocation failure.
+static int build_chain (htable_t *table, const void *const *keys, const void *const *values, const unsigned long *hashes, size_t n) {
+
+    size_t *offsets = calloc(table->size + 1U, sizeof(*offsets));
+    size_t *order = malloc((n > 0 ? n : 1U) * sizeof(*order));
+
+    if (offsets == NULL || order == NULL) {
+        free(offsets);
+        free(order);
+        return -2;
+    }
+
+    // Counting sort of the pairs by bucket, offsets[idx] becomes the first pair of bucket idx.
+    for (size_t idx = 0; idx < n; idx++) {
+        offsets[htable_bucket_index(table, hashes[idx], table->size) + 1U]++;
+    }
+
+    for (size_t idx = 1; idx <= table->size; idx++) {
+        offsets[idx] += offsets[idx - 1U];
+    }
+
+    // Scatter in input order, so a later duplicate still overwrites an earlier one. This advances
+    // offsets[idx] to the end of bucket idx.
+    for (size_t idx = 0; idx < n; idx++) {
+        order[offsets[htable_bucket_index(table, hashes[idx], table->size)]++] = idx;
+    }
+
+    // Carve every hash node out of one chunk, in bucket order.
+    if (table->slab != NULL && n > 0 && htable_slab_reserve(table->slab, n) != 0) {
+        free(offsets);
+        free(order);
+        return -2;
+    }
+
+    const int unique = (table->flags & HTABLE_UNIQUE_KEYS) != 0;
+    size_t begin = 0;
+    int rc = 0;
+
+    for (size_t bucket = 0; bucket < table->size && rc == 0; bucket++) {
+
+        struct htable_node **tail = &table->table[bucket];
+
+        for (size_t pos = begin; pos < offsets[bucket]; pos++) {
+
+            const size_t idx = order[pos];
+
+            // Duplicates only overwrite the value of the hash node already in the chain.
+            if (!unique && htable_get_hashed(table, keys[idx], hashes[idx]) != NULL) {
+                (void) htable_insert_hashed(table, keys[idx], values[idx], hashes[idx]);
+                continue;
+            }
+
+            struct htable_node *node = NULL;
+
+            if ((node = table->alloc.alloc(table->alloc.ctx, table->node_size)) == NULL) {
+                rc = -2;
+                break;
+            }
+
+            node->key = htable_store_inline(table, node->data, keys[idx], table->cbs.ksize, table->cbs.kcpy);
+            node->value = htable_store_inline(table, node->data + table->inline_size, values[idx], table->cbs.vsize, table->cbs.vcpy);
+            node->hash = hashes[idx];
+            node->key_len = 0;
+            node->ref = 0;
+            node->expires = 0;
+            node->next = NULL;
+
+            // Append, so the chain follows the memory order of its hash nodes.
+            *tail = node;
+            tail = &node->next;
+
+            table->count++;
+        }
+
+        begin = offsets[bucket];
+    }
+
+    free(offsets);
+    free(order);
+
+    return rc;
+}
+
+// --- Function Definitions --- //
+
+/// @brief Create a hash table sized for and filled with key-value pairs whose keys are already hashed.
+htable_t *htable_build_hashed (const void *const *keys, const void *const *values, const unsigned long *hashes, size_t n, htable_hash_t hash, htable_keq_t keq, const struct callbacks *cbs, const struct htable_opts *opts) {
+
+    struct htable_opts config = { 0 };
+
+    if (opts != NULL) {
+        config = *opts;
+    }
+
+    // Without a custom allocator every hash node comes from a single chunk of a slab owned by the table.
+    if (config.engine == HTABLE_ENGINE_CHAIN && config.allocator == NULL) {
+        config.flags |= HTABLE_SLAB;
+    }
+
+    // Size the table once, so no pair triggers a resize.
+    const int chained = config.engine == HTABLE_ENGINE_CHAIN || config.engine == HTABLE_ENGINE_COMPACT;
+    const float default_load = chained ? HTABLE_DEFAULT_MAX_LOAD : HTABLE_DEFAULT_OA_MAX_LOAD;
+    const float max_load = config.max_load > 0.0f ? config.max_load : default_load;
+
+    htable_t *table = htable_create_ex((size_t) ((double) n / (double) max_load) + 1U, hash, keq, cbs, &config);
+
+    if (table == NULL) {
+        return NULL;
+    }
+
+    int rc = 0;
+
+    if (table->engine == HTABLE_ENGINE_CHAIN) {
+        rc = build_chain(table, keys, values, hashes, n);
+    }
+    else {
+        // The engines stored in slots place every pair through the regular insert, without resizing.
+        for (size_t idx = 0; idx < n && rc == 0; idx++) {
+            rc = htable_insert_hashed(table, keys[idx], values[idx], hashes[idx]);
+        }
+    }
+
+    if (rc != 0) {
+        htable_destroy(table);
+        return NULL;
+    }
+
+    return table;
+}
+
+/// @brief Check the arguments of a build.
+/// @return 0 if they are valid, -1 otherwise.
+int htable_build_check (const void *const *keys, const void *const *values, size_t n, htable_hash_t hash, htable_keq_t keq, const struct htable_opts *opts) {
+
+    if ((n > 0 && (keys == NULL || values == NULL)) || (hash == NULL && (opts == NULL || opts->seeded_hash == NULL)) || keq == NULL) {
+        return -1;
+    }
+
+    // The pairs fill hash nodes directly, with no value list to append to, and never evict to stay within capacity.
+    if (opts != NULL && ((opts->flags & HTABLE_MULTI) || (opts->capacity > 0 && n > opts->capacity))) {
+        return -1;
+    }
+
+    for (size_t idx = 0; idx < n; idx++) {
+        if (values[idx] == NULL) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/// @brief Settle the configuration of a build, drawing the seed now since the keys are hashed before any table exists.
+struct htable_opts htable_build_opts (const struct htable_opts *opts) {
+
+    struct htable_opts config = { 0 };
+
+    if (opts != NULL) {
+        config = *opts;
+    }
+
+    if (config.seeded_hash != NULL && config.seed == 0) {
+        config.seed = htable_seed_random();
+    }
+
+    return config;
+}
+
+/// @brief Create a hash table sized for and filled with an array of key-value pairs.
+htable_t *htable_build (const void *const *keys, const void *const *values, size_t n, htable_hash_t hash, htable_keq_t keq, const struct callbacks *cbs, const struct htable_opts *opts) {
+
+    if (htable_build_check(keys, values, n, hash, keq, opts) != 0) {
+        return NULL;
+    }
+
+    unsigned long *hashes = NULL;
+
+    if ((hashes = malloc((n > 0 ? n : 1U) * sizeof(*hashes))) == NULL) {
+        return NULL;
+    }
+
+    // Only the hash functions, the seed and the flags take part in hashing, the table itself does not exist yet.
+    const struct htable_opts config = htable_build_opts(opts);
+    const htable_t shape = { .hash = hash, .seeded_hash = config.seeded_hash, .seed = config.seed, .flags = config.flags };
+
+    htable_hash_keys(&shape, keys, hashes, n);
+
+    htable_t *table = htable_build_hashed(keys, values, hashes, n, hash, keq, cbs, &config);
+
+    free(hashes);
+
+    return table;
+}
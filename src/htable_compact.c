@@ -0,0 +1,320 @@
+// ==============================================================================
+//                                Compact Engine
+// ==============================================================================
+//
+// Description: Pointer-free chaining engine for very large tables. Entries live
+// in one dense slot array and chain through 32-bit slot indices, and the buckets
+// hold 32-bit indices as well. Removal moves the last entry into the hole, so
+// the array never has gaps and there is no hash node, next pointer or allocator
+// header per entry.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#include "htable_internal.h"
+
+#include <string.h>     // For memory operations, e.g. memset(3).
+
+// --- Static Function Definitions --- //
+
+/// @brief Round the requested size up to the next power of two.
+/// @param size The requested number of slots.
+/// @return The number of slots to allocate.
+static size_t round_capacity (size_t size) {
+
+    size_t capacity = 8U;
+
+    while (capacity < size && capacity < HTABLE_COMPACT_MAX_SIZE) {
+        capacity <<= 1U;
+    }
+
+    return capacity;
+}
+
+/// @brief Find the slot holding the key.
+/// @param table The hash table to search.
+/// @param key The key for the slot.
+/// @param hash The hash value of the key.
+/// @param prev Optional output receiving the slot linking to the found one, SIZE_MAX if it heads its bucket.
+/// @return Index of the slot, or the number of slots if the key is not present.
+static size_t find_slot (const htable_t *table, const void *key, unsigned long hash, size_t *prev) {
+
+    uint32_t link = table->heads[hash & (table->size - 1U)];
+    size_t before = SIZE_MAX;
+    size_t probes = 0;
+    size_t keqs = 0;
+
+    // A link is the slot index plus one, 0 ends the chain.
+    for (; link != 0; link = (uint32_t) table->slots[before].dist) {
+
+        const size_t idx = link - 1U;
+        const struct htable_slot *slot = &table->slots[idx];
+
+        probes++;
+
+        if (slot->hash == hash) {
+            keqs++;
+
+            if (table->keq(slot->key, key)) {
+                HTABLE_CLOCK_REF(table, &table->slots[idx]);
+                HTABLE_STAT_SEARCH(table, probes, keqs);
+
+                if (prev != NULL) {
+                    *prev = before;
+                }
+                return idx;
+            }
+        }
+
+        before = idx;
+    }
+
+    HTABLE_STAT_SEARCH(table, probes, keqs);
+
+    return table->size;
+}
+
+/// @brief Point the bucket head or the slot before an entry at a new link.
+static void set_link (htable_t *table, unsigned long hash, size_t prev, uint32_t link) {
+    if (prev == SIZE_MAX) {
+        table->heads[hash & (table->size - 1U)] = link;
+    } else {
+        table->slots[prev].dist = link;
+    }
+}
+
+/// @brief Chain every entry into the bucket heads, which must be zeroed.
+static void link_all (htable_t *table) {
+
+    const size_t mask = table->size - 1U;
+
+    for (size_t idx = 0; idx < table->count; idx++) {
+        uint32_t *head = &table->heads[table->slots[idx].hash & mask];
+
+        table->slots[idx].dist = *head;
+        *head = (uint32_t) (idx + 1U);
+    }
+}
+
+/// @brief Move the entries into slot and bucket arrays of the given size.
+/// @param table The hash table to resize.
+/// @param size The new number of slots and buckets, a power of two of at least the number of entries.
+/// @return 0 on success, -2 on memory allocation failure.
+static int resize (htable_t *table, size_t size) {
+
+    uint32_t *heads = NULL;
+    struct htable_slot *slots = NULL;
+
+    HTABLE_STAT_RESIZE(table);
+    HTABLE_STAT_CLOCK(start);
+
+    if ((heads = calloc(size, sizeof(*heads))) == NULL) {
+        return -2;
+    }
+
+    // The entries stay dense, so the slot array only changes its length and keeps its order.
+    if ((slots = realloc(table->slots, size * sizeof(*slots))) == NULL) {
+        free(heads);
+        return -2;
+    }
+
+    free(table->heads);
+
+    table->slots = slots;
+    table->heads = heads;
+    table->size = size;
+
+    // Reuse the stored hashes, the user hash function is not called again.
+    link_all(table);
+
+    HTABLE_STAT_ELAPSED(table, start);
+
+    return 0;
+}
+
+// --- Function Definitions --- //
+
+/// @brief Allocate the slot and bucket arrays of a compact hash table.
+int htable_compact_init (htable_t *table, size_t size) {
+
+    table->size = round_capacity(size);
+    table->slots = malloc(table->size * sizeof(*table->slots));
+    table->heads = calloc(table->size, sizeof(*table->heads));
+
+    if (table->slots == NULL || table->heads == NULL) {
+        free(table->slots);
+        free(table->heads);
+        return -2;
+    }
+
+    return 0;
+}
+
+/// @brief Free every entry and the slot and bucket arrays of a compact hash table.
+void htable_compact_destroy (htable_t *table) {
+
+    // The entries are dense, nothing past the count was ever written.
+    for (size_t idx = 0; idx < table->count; idx++) {
+        table->cbs.kfree(table->slots[idx].key);
+        table->cbs.vfree(table->slots[idx].value);
+    }
+
+    free(table->slots);
+    free(table->heads);
+}
+
+/// @brief Find the value slot of a key in a compact hash table, appending an entry if it is absent.
+void **htable_compact_upsert (htable_t *table, const void *key, unsigned long hash, int owned, int *inserted) {
+
+    const size_t found = find_slot(table, key, hash, NULL);
+
+    if (found != table->size) {
+        *inserted = 0;
+        return &table->slots[found].value;
+    }
+
+    // A full capacity-bounded table makes room before a slot is claimed, the freed slot keeps the claim from failing.
+    if (table->capacity > 0 && table->count >= table->capacity) {
+        htable_evict(table);
+    }
+
+    // Grow before the insertion would exceed the maximum load factor, the slot array holds at most size entries.
+    if ((float) (table->count + 1U) > table->max_load * (float) table->size && !(table->flags & HTABLE_FIXED_SIZE) && table->size < HTABLE_COMPACT_MAX_SIZE) {
+        // Growing is best effort while there is still a free slot.
+        if (resize(table, table->size * 2U) != 0 && table->count == table->size) {
+            return NULL;
+        }
+    }
+
+    if (table->count == table->size) {
+        return NULL;
+    }
+
+    const size_t idx = table->count++;
+    uint32_t *head = &table->heads[hash & (table->size - 1U)];
+
+    table->slots[idx] = (struct htable_slot) {
+        .key = owned ? (void *) key : table->cbs.kcpy(key),
+        .value = NULL,
+        .hash = hash,
+        .dist = *head,
+    };
+
+    *head = (uint32_t) (idx + 1U);
+    *inserted = 1;
+
+    return &table->slots[idx].value;
+}
+
+/// @brief Move every entry of a compact hash table into slot and bucket arrays of at least the given size.
+int htable_compact_resize (htable_t *table, size_t size) {
+
+    size_t capacity = round_capacity(size);
+
+    while (capacity < table->count) {
+        capacity <<= 1U;
+    }
+
+    return resize(table, capacity);
+}
+
+/// @brief Insert a key-value pair into a compact hash table.
+int htable_compact_insert (htable_t *table, const void *key, const void *value, unsigned long hash) {
+
+    int inserted = 0;
+    void **slot = htable_compact_upsert(table, key, hash, 0, &inserted);
+
+    if (slot == NULL) {
+        return -2;
+    }
+
+    // Free the previous value and update it with the new value.
+    if (!inserted) {
+        table->cbs.vfree(*slot);
+    }
+
+    *slot = table->cbs.vcpy(value);
+
+    return 0;
+}
+
+/// @brief Unlink a key-value pair from a compact hash table without freeing it.
+int htable_compact_take (htable_t *table, const void *key, unsigned long hash, void **key_out, void **value_out) {
+
+    size_t prev = SIZE_MAX;
+    const size_t idx = find_slot(table, key, hash, &prev);
+
+    if (idx == table->size) {
+        return -1;
+    }
+
+    // Hand the key and value over, the parts the caller does not want back are freed.
+    if (key_out != NULL) {
+        *key_out = table->slots[idx].key;
+    } else {
+        table->cbs.kfree(table->slots[idx].key);
+    }
+
+    if (value_out != NULL) {
+        *value_out = table->slots[idx].value;
+    } else {
+        table->cbs.vfree(table->slots[idx].value);
+    }
+
+    set_link(table, hash, prev, (uint32_t) table->slots[idx].dist);
+
+    // Move the last entry into the hole, relinking whatever pointed at it.
+    const size_t last = --table->count;
+
+    if (idx != last) {
+        const unsigned long moved = table->slots[last].hash;
+        size_t before = SIZE_MAX;
+
+        for (uint32_t link = table->heads[moved & (table->size - 1U)]; link != last + 1U; link = (uint32_t) table->slots[before].dist) {
+            before = link - 1U;
+        }
+
+        set_link(table, moved, before, (uint32_t) (idx + 1U));
+        table->slots[idx] = table->slots[last];
+    }
+
+    return 0;
+}
+
+/// @brief Remove a key-value pair from a compact hash table.
+int htable_compact_remove (htable_t *table, const void *key, unsigned long hash) {
+    return htable_compact_take(table, key, hash, NULL, NULL);
+}
+
+/// @brief Retrieve a value from a compact hash table.
+void *htable_compact_get (const htable_t *table, const void *key, unsigned long hash) {
+
+    const size_t idx = find_slot(table, key, hash, NULL);
+
+    return idx != table->size ? table->slots[idx].value : NULL;
+}
+
+/// @brief Prefetch the bucket head of a hash in a compact hash table.
+void htable_compact_prefetch (const htable_t *table, unsigned long hash) {
+    HTABLE_PREFETCH(&table->heads[hash & (table->size - 1U)]);
+}
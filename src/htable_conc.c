@@ -0,0 +1,165 @@
+// ==============================================================================
+//                            Concurrent Hash table
+// ==============================================================================
+//
+// Description: Lock striped front-end for the generic hash table. Every stripe
+// is padded to its own cache line and owns a reader/writer lock and an ordinary
+// hash table, so operations on different stripes never share a lock or a bucket
+// array.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "htable_conc.h"
+#include "htable_locked.h"
+
+// --- Structures --- //
+
+/// @brief Concurrent hash table structure.
+struct htable_conc {
+    struct htable_locked *stripes;  // The stripes of the hash table, each padded to its own cache line.
+    struct htable_route route;      // The routing of keys to the stripes.
+};
+
+// --- Function Definitions --- //
+
+/// @brief Create a concurrent hash table.
+htable_conc_t *htable_conc_create (size_t size, size_t stripes, htable_hash_t hash, htable_keq_t keq, const struct callbacks *cbs, const struct htable_opts *opts) {
+
+    // Hits of a capacity-bounded table set reference bits, which the readers of a stripe must not write.
+    // Multimaps take their values through htable_insert_multi only, which the front-end does not offer.
+    if (size == 0 || hash == NULL || keq == NULL || (opts != NULL && (opts->capacity > 0 || (opts->flags & HTABLE_MULTI)))) {
+        return NULL;
+    }
+
+    htable_conc_t *table = NULL;
+
+    if ((table = calloc(1U, sizeof(*table))) == NULL) {
+        return NULL;
+    }
+
+    const struct htable_opts config = htable_route_opts(opts);
+    htable_route_init(&table->route, stripes != 0 ? stripes : HTABLE_CONC_STRIPES, hash, &config);
+
+    const size_t nstripes = table->route.parts;
+
+    if ((table->stripes = aligned_alloc(HTABLE_CACHE_LINE, nstripes * sizeof(*table->stripes))) == NULL) {
+        free(table);
+        return NULL;
+    }
+
+    const size_t stripe_size = (size + nstripes - 1U) / nstripes;
+
+    for (size_t idx = 0; idx < nstripes; idx++) {
+
+        if (htable_locked_init(&table->stripes[idx], stripe_size, hash, keq, cbs, &config) != 0) {
+            // Unwind the stripes created so far.
+            table->route.parts = idx;
+            htable_conc_destroy(table);
+            return NULL;
+        }
+    }
+
+    return table;
+}
+
+/// @brief Destroy the concurrent hash table, no other thread may access it anymore.
+void htable_conc_destroy (htable_conc_t *table) {
+
+    if (table == NULL) {
+        return;
+    }
+
+    for (size_t idx = 0; idx < table->route.parts; idx++) {
+        htable_locked_destroy(&table->stripes[idx]);
+    }
+
+    free(table->stripes);
+    free(table);
+}
+
+/// @brief Insert a key-value pair, taking the stripe of the key exclusively.
+int htable_conc_insert (htable_conc_t *table, const void *key, const void *value) {
+
+    if (table == NULL || value == NULL) {
+        return -1;
+    }
+
+    const unsigned long hash = htable_route_hash(&table->route, key);
+
+    return htable_locked_insert(&table->stripes[htable_route_part(&table->route, hash)], key, value, hash);
+}
+
+/// @brief Remove a key-value pair, taking the stripe of the key exclusively.
+int htable_conc_remove (htable_conc_t *table, const void *key) {
+
+    if (table == NULL) {
+        return -1;
+    }
+
+    const unsigned long hash = htable_route_hash(&table->route, key);
+
+    return htable_locked_remove(&table->stripes[htable_route_part(&table->route, hash)], key, hash);
+}
+
+/// @brief Retrieve a value under a shared lock of the stripe of the key.
+void *htable_conc_get (htable_conc_t *table, const void *key) {
+
+    if (table == NULL) {
+        return NULL;
+    }
+
+    const unsigned long hash = htable_route_hash(&table->route, key);
+
+    return htable_locked_get(&table->stripes[htable_route_part(&table->route, hash)], key, hash, NULL, NULL);
+}
+
+/// @brief Call a function on the value of a key while holding the shared lock of its stripe.
+int htable_conc_visit (htable_conc_t *table, const void *key, htable_visit_t visit, void *ctx) {
+
+    if (table == NULL || visit == NULL) {
+        return -1;
+    }
+
+    const unsigned long hash = htable_route_hash(&table->route, key);
+
+    return htable_locked_get(&table->stripes[htable_route_part(&table->route, hash)], key, hash, visit, ctx) != NULL ? 0 : -1;
+}
+
+/// @brief Count the elements of every stripe, a snapshot that may be stale by the time it returns.
+size_t htable_conc_count (htable_conc_t *table) {
+
+    if (table == NULL) {
+        return 0;
+    }
+
+    size_t count = 0;
+
+    for (size_t idx = 0; idx < table->route.parts; idx++) {
+        count += htable_locked_count(&table->stripes[idx]);
+    }
+
+    return count;
+}
@@ -0,0 +1,144 @@
+// ==============================================================================
+//                                CLOCK Eviction
+// ==============================================================================
+//
+// Description: Eviction of capacity-bounded hash tables. Every entry carries a
+// reference bit that hits set, a hand sweeps buckets or slots in order, clearing
+// the bits it passes, and evicts the first entry found without one. Hits thus
+// cost at most one store and never relink a list, unlike a strict LRU.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#include "htable_internal.h"
+
+// --- Static Function Definitions --- //
+
+/// @brief Notify the eviction hook and count the eviction.
+static void notify (const htable_t *table, const void *key, void *value) {
+
+    HTABLE_STAT_EVICT(table);
+
+    if (table->evict != NULL) {
+        table->evict(key, value, table->evict_ctx);
+    }
+}
+
+/// @brief Evict one hash node of the chaining engine.
+static void evict_chain (htable_t *table) {
+
+    // The hand only sweeps the current bucket array.
+    while (table->rehash_table != NULL) {
+        htable_rehash_step(table, table->rehash_size);
+    }
+
+    size_t idx = table->clock_hand % table->size;
+    size_t depth = table->clock_depth;
+
+    // Every pass clears the bits it passes, so a second pass at the latest finds a victim.
+    for (;; idx = (idx + 1U) % table->size, depth = 0) {
+
+        struct htable_node **link = &table->table[idx];
+
+        // Resume where the hand stopped in the chain, the hash nodes before it have been cleared already.
+        for (size_t pos = 0; pos < depth && *link != NULL; pos++) {
+            link = &(*link)->next;
+        }
+
+        for (; *link != NULL; link = &(*link)->next, depth++) {
+
+            struct htable_node *node = *link;
+
+            if (node->ref) {
+                node->ref = 0;
+                continue;
+            }
+
+            // A bucket that cannot be copied into the snapshots is left alone, the table overshoots by one.
+            if (htable_cow(table, node->hash) != 0) {
+                return;
+            }
+
+            *link = node->next;
+            table->count--;
+
+            // The next hash node takes the place of the evicted one.
+            table->clock_hand = idx;
+            table->clock_depth = depth;
+
+            notify(table, node->key, node->value);
+            htable_free_node(table, node);
+
+            return;
+        }
+    }
+}
+
+/// @brief Evict one slot of an open-addressing engine.
+static void evict_slot (htable_t *table) {
+
+    size_t idx = table->clock_hand % table->size;
+
+    for (;; idx = (idx + 1U) % table->size) {
+
+        if (!htable_slot_used(table, idx)) {
+            continue;
+        }
+
+        struct htable_slot *slot = &table->slots[idx];
+
+        if (slot->ref) {
+            slot->ref = 0;
+            continue;
+        }
+
+        // Backward shifting, or the compact engine filling the hole, may move another entry into this slot, so the hand stays.
+        table->clock_hand = idx;
+
+        notify(table, slot->key, slot->value);
+        (void) htable_take_hashed(table, slot->key, slot->hash, NULL, NULL);
+
+        return;
+    }
+}
+
+// --- Function Definitions --- //
+
+/// @brief Evict one entry of a full capacity-bounded table with the CLOCK hand.
+void htable_evict (htable_t *table) {
+
+    if (table->count == 0) {
+        return;
+    }
+
+    switch (table->engine) {
+        case HTABLE_ENGINE_ROBIN_HOOD:
+        case HTABLE_ENGINE_SWISS:
+        case HTABLE_ENGINE_COMPACT:
+            evict_slot(table);
+            break;
+        default:
+            evict_chain(table);
+            break;
+    }
+}
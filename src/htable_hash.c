@@ -0,0 +1,291 @@
+// ==============================================================================
+//                           Built-in Hash Functions
+// ==============================================================================
+//
+// Description: Implementation of the built-in hash functions. The byte hash
+// follows wyhash by Wang Yi (public domain): keys up to 16 bytes are read in at
+// most four loads, longer keys are folded through 64x64 to 128-bit multiplies
+// over three independent 48 byte lanes. With AES-NI, keys of HTABLE_HASH_AES_MIN
+// bytes and more go through four AES lanes of 16 bytes instead, then the same
+// final mix.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#include "htable_hash.h"
+
+#if defined(__AES__) && defined(__SSE2__)
+    #include <wmmintrin.h>  // For the AES-NI intrinsics, e.g. _mm_aesenc_si128.
+    #define HASH_AES 1
+#endif
+
+// --- Macros --- //
+
+#if defined(__GNUC__)
+    #define HASH_LIKELY(x) __builtin_expect(!!(x), 1)
+#else
+    #define HASH_LIKELY(x) (x)
+#endif
+
+// --- Constants --- //
+
+/// @brief Odd constants with balanced bits, the default secret of wyhash.
+static const uint64_t secret[4] = {
+    0x2D358DCCAA6C78A5ULL, 0x8BB84B93962EACC9ULL, 0x4B33A62ED433D4A3ULL, 0x4D5A2DA51DE1AA47ULL,
+};
+
+// --- Static Function Definitions --- //
+
+/// @brief Multiply two words into 128 bits, returning the low half in a and the high half in b.
+static inline void mum (uint64_t *a, uint64_t *b) {
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 u128;
+
+    const u128 r = (u128) *a * *b;
+
+    *a = (uint64_t) r;
+    *b = (uint64_t) (r >> 64U);
+#else
+    // Schoolbook multiplication of the 32-bit halves.
+    const uint64_t ha = *a >> 32U, hb = *b >> 32U, la = (uint32_t) *a, lb = (uint32_t) *b;
+    const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    const uint64_t t = rl + (rm0 << 32U);
+    uint64_t carry = t < rl;
+    const uint64_t lo = t + (rm1 << 32U);
+
+    carry += lo < t;
+
+    *a = lo;
+    *b = rh + (rm0 >> 32U) + (rm1 >> 32U) + carry;
+#endif
+}
+
+/// @brief Multiply and fold the halves of the product.
+static inline uint64_t mix (uint64_t a, uint64_t b) {
+    mum(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t read8 (const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t read4 (const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/// @brief Read one to three bytes, the first, middle and last byte overlap for shorter keys.
+static inline uint64_t read3 (const unsigned char *p, size_t len) {
+    return ((uint64_t) p[0] << 16U) | ((uint64_t) p[len >> 1U] << 8U) | p[len - 1U];
+}
+
+#if defined(HASH_AES)
+
+/// @brief Compress a key of at least HTABLE_HASH_AES_MIN bytes into two words with four AES lanes.
+static void compress_aes (const unsigned char *p, size_t len, uint64_t seed, uint64_t *a, uint64_t *b) {
+
+    __m128i lanes[4];
+
+    for (size_t lane = 0; lane < 4U; lane++) {
+        lanes[lane] = _mm_set_epi64x((long long) (seed ^ secret[lane]), (long long) (secret[(lane + 1U) & 3U] + len));
+    }
+
+    // One AES round per 16 bytes and lane, the data acts as round key.
+    const unsigned char *end = p + len;
+
+    for (; end - p >= 64; p += 64) {
+        for (size_t lane = 0; lane < 4U; lane++) {
+            lanes[lane] = _mm_aesenc_si128(lanes[lane], _mm_loadu_si128((const __m128i *) (const void *) (p + 16U * lane)));
+        }
+    }
+
+    // The final partial block is zero padded, an overlapping load would feed some bytes into two lanes
+    // where their differences can cancel out. The length is already part of the initial lanes.
+    if (p != end) {
+        _Alignas(16) unsigned char tail[64] = { 0 };
+        memcpy(tail, p, (size_t) (end - p));
+
+        for (size_t lane = 0; lane < 4U; lane++) {
+            lanes[lane] = _mm_aesenc_si128(lanes[lane], _mm_load_si128((const __m128i *) (const void *) (tail + 16U * lane)));
+        }
+    }
+
+    // Fold the lanes with two more rounds each, so every input byte passes through at least three.
+    const __m128i key = _mm_set_epi64x((long long) secret[2], (long long) secret[3]);
+
+    __m128i state = _mm_aesenc_si128(_mm_aesenc_si128(lanes[0], lanes[1]), _mm_aesenc_si128(lanes[2], lanes[3]));
+    state = _mm_aesenc_si128(_mm_aesenc_si128(state, key), key);
+
+    *a = (uint64_t) _mm_cvtsi128_si64(state);
+    *b = (uint64_t) _mm_cvtsi128_si64(_mm_unpackhi_epi64(state, state));
+}
+
+#endif
+
+// --- Function Definitions --- //
+
+/// @brief Hash a byte string.
+uint64_t htable_hash_bytes (const void *data, size_t len, uint64_t seed) {
+
+    const unsigned char *p = data;
+    uint64_t a = 0;
+    uint64_t b = 0;
+
+    seed ^= mix(seed ^ secret[0], secret[1]);
+
+    if (HASH_LIKELY(len <= 16U)) {
+        if (len >= 4U) {
+            // Two overlapping pairs of 4 byte loads cover every length from 4 to 16.
+            const size_t shift = (len >> 3U) << 2U;
+            a = (read4(p) << 32U) | read4(p + shift);
+            b = (read4(p + len - 4U) << 32U) | read4(p + len - 4U - shift);
+        }
+        else if (len > 0) {
+            a = read3(p, len);
+        }
+    }
+#if defined(HASH_AES)
+    else if (len >= HTABLE_HASH_AES_MIN) {
+        compress_aes(p, len, seed, &a, &b);
+        b ^= seed;
+    }
+#endif
+    else {
+        size_t rest = len;
+
+        // Three independent multiply chains hide the multiplier latency.
+        if (rest >= 48U) {
+            uint64_t see1 = seed;
+            uint64_t see2 = seed;
+
+            do {
+                seed = mix(read8(p) ^ secret[1], read8(p + 8U) ^ seed);
+                see1 = mix(read8(p + 16U) ^ secret[2], read8(p + 24U) ^ see1);
+                see2 = mix(read8(p + 32U) ^ secret[3], read8(p + 40U) ^ see2);
+                p += 48U;
+                rest -= 48U;
+            } while (rest >= 48U);
+
+            seed ^= see1 ^ see2;
+        }
+
+        while (rest > 16U) {
+            seed = mix(read8(p) ^ secret[1], read8(p + 8U) ^ seed);
+            p += 16U;
+            rest -= 16U;
+        }
+
+        // The last 16 bytes, overlapping the previous block.
+        a = read8(p + rest - 16U);
+        b = read8(p + rest - 8U);
+    }
+
+    a ^= secret[1];
+    b ^= seed;
+
+    mum(&a, &b);
+
+    return mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+/// @brief Hash uint32_t keys.
+unsigned long htable_hash_u32 (const void *key) {
+    return (unsigned long) mix(read4(key) ^ secret[0], HTABLE_HASH_SEED ^ secret[1]);
+}
+
+int htable_keq_u32 (const void *keyA, const void *keyB) {
+    return *(const uint32_t *) keyA == *(const uint32_t *) keyB;
+}
+
+/// @brief Hash uint64_t keys.
+unsigned long htable_hash_u64 (const void *key) {
+    return (unsigned long) mix(read8(key) ^ secret[0], HTABLE_HASH_SEED ^ secret[1]);
+}
+
+int htable_keq_u64 (const void *keyA, const void *keyB) {
+    return *(const uint64_t *) keyA == *(const uint64_t *) keyB;
+}
+
+/// @brief Hash NUL-terminated string keys.
+unsigned long htable_hash_str (const void *key) {
+    return (unsigned long) htable_hash_bytes(key, strlen(key), HTABLE_HASH_SEED);
+}
+
+int htable_keq_str (const void *keyA, const void *keyB) {
+    return strcmp(keyA, keyB) == 0;
+}
+
+/// @brief Hash struct htable_lpstr keys.
+unsigned long htable_hash_lpstr (const void *key) {
+    const struct htable_lpstr *str = key;
+    return (unsigned long) htable_hash_bytes(str->data, str->len, HTABLE_HASH_SEED);
+}
+
+int htable_keq_lpstr (const void *keyA, const void *keyB) {
+
+    const struct htable_lpstr *strA = keyA;
+    const struct htable_lpstr *strB = keyB;
+
+    return strA->len == strB->len && memcmp(strA->data, strB->data, strA->len) == 0;
+}
+
+/// @brief Seeded built-in hash functions, every key byte goes through the full keyed hash.
+unsigned long htable_hash_u32_seeded (const void *key, unsigned long long seed) {
+    return (unsigned long) htable_hash_bytes(key, sizeof(uint32_t), seed);
+}
+
+unsigned long htable_hash_u64_seeded (const void *key, unsigned long long seed) {
+    return (unsigned long) htable_hash_bytes(key, sizeof(uint64_t), seed);
+}
+
+unsigned long htable_hash_str_seeded (const void *key, unsigned long long seed) {
+    return (unsigned long) htable_hash_bytes(key, strlen(key), seed);
+}
+
+unsigned long htable_hash_lpstr_seeded (const void *key, unsigned long long seed) {
+    const struct htable_lpstr *str = key;
+    return (unsigned long) htable_hash_bytes(str->data, str->len, seed);
+}
+
+/// @brief Sizes of the built-in key types.
+size_t htable_size_u32 (const void *key) {
+    (void) key;
+    return sizeof(uint32_t);
+}
+
+size_t htable_size_u64 (const void *key) {
+    (void) key;
+    return sizeof(uint64_t);
+}
+
+size_t htable_size_str (const void *key) {
+    return strlen(key) + 1U;
+}
+
+size_t htable_size_lpstr (const void *key) {
+    return sizeof(struct htable_lpstr) + ((const struct htable_lpstr *) key)->len;
+}
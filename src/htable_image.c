@@ -0,0 +1,442 @@
+// ==============================================================================
+//                              Hash Table Images
+// ==============================================================================
+//
+// Description: Saves a hash table as a position-independent image and maps it
+// back read-only. The image holds a bucket offset array followed by the entries
+// of every bucket stored contiguously, with offsets instead of pointers, so
+// htable_get can query the mapping directly without a deserialization step.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+//
+// Layout, in the byte order and word size of the machine that saved it:
+//
+//     struct image_header         magic, version and shape of the image, IMAGE_HEADER bytes
+//     uint64_t offsets[buckets + 1] byte offset of the first entry of every bucket, relative to the entries
+//     entries                     struct image_entry, key bytes and value bytes, each padded to 8 bytes
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "htable_internal.h"
+
+#include <errno.h>      // For the error numbers, e.g. EINTR.
+#include <fcntl.h>      // For file operations, e.g. open(2).
+#include <string.h>     // For memory operations, e.g. memcpy(3).
+#include <sys/mman.h>   // For memory mapping, e.g. mmap(2).
+#include <sys/stat.h>   // For file status, e.g. fstat(2).
+#include <unistd.h>     // For file descriptor operations, e.g. write(2), close(2).
+
+// --- Macros --- //
+
+#define IMAGE_MAGIC "HTABLEIM"      // Identifies an image file.
+#define IMAGE_VERSION 1U            // Incremented whenever the layout changes.
+#define IMAGE_ENDIAN 0x01020304U    // Stored natively, reads back differently on a machine of the other byte order.
+#define IMAGE_HEADER 64U            // Size reserved for the header, keeps the offsets cache line aligned.
+#define IMAGE_BUFFER 65536U         // Size of the write buffer of htable_save.
+
+/// @brief Round a length up to the 8 byte alignment of the image.
+#define IMAGE_PAD(len) (((len) + 7U) & ~(uint64_t) 7U)
+
+// --- Types --- //
+
+/// @brief Image header, at offset 0.
+struct image_header {
+    char magic[8];          // IMAGE_MAGIC, without a terminator.
+    uint32_t version;       // IMAGE_VERSION.
+    uint32_t endian;        // IMAGE_ENDIAN.
+    uint32_t flags;         // The hash flags the entries were hashed with.
+    uint32_t hash_size;     // sizeof(unsigned long) of the saving machine.
+    uint64_t buckets;       // The number of buckets, a power of two.
+    uint64_t count;         // The number of entries.
+    uint64_t size;          // The size of the whole image in bytes.
+};
+
+/// @brief Entry header, followed by the key and value bytes.
+struct image_entry {
+    uint64_t hash;          // The full hash value of the key.
+    uint64_t key_len;       // The number of key bytes.
+    uint64_t value_len;     // The number of value bytes.
+};
+
+/// @brief Entry of the hash table being saved.
+struct save_entry {
+    const void *key;        // The key in the hash table.
+    const void *value;      // The value in the hash table.
+    unsigned long hash;     // The full hash value of the key.
+    uint64_t key_len;       // The number of key bytes.
+    uint64_t value_len;     // The number of value bytes.
+};
+
+/// @brief Buffered writer of htable_save.
+struct image_writer {
+    int fd;                 // The file descriptor written to.
+    unsigned char *buf;     // The write buffer.
+    size_t len;             // The number of buffered bytes.
+    int failed;             // Non-zero once a write has failed.
+};
+
+// --- Static Function Definitions --- //
+
+/// @brief Write the whole buffer to the file descriptor, retrying short and interrupted writes.
+static int write_all (int fd, const unsigned char *buf, size_t len) {
+
+    while (len > 0) {
+        const ssize_t written = write(fd, buf, len);
+
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (written <= 0) {
+            return -2;
+        }
+
+        buf += written;
+        len -= (size_t) written;
+    }
+
+    return 0;
+}
+
+/// @brief Append bytes to the image, padded with zeros to the given length.
+static void emit (struct image_writer *writer, const void *src, size_t len, size_t padded) {
+
+    const unsigned char *bytes = src;
+
+    for (size_t done = 0; done < padded && !writer->failed;) {
+
+        if (writer->len == IMAGE_BUFFER) {
+            writer->failed = write_all(writer->fd, writer->buf, writer->len) != 0;
+            writer->len = 0;
+            continue;
+        }
+
+        size_t chunk = padded - done < IMAGE_BUFFER - writer->len ? padded - done : IMAGE_BUFFER - writer->len;
+
+        if (done < len) {
+            chunk = chunk < len - done ? chunk : len - done;
+            memcpy(writer->buf + writer->len, bytes + done, chunk);
+        }
+        else {
+            memset(writer->buf + writer->len, 0, chunk);
+        }
+
+        writer->len += chunk;
+        done += chunk;
+    }
+}
+
+/// @brief Gather every live entry of a hash table, of any engine except the image engine.
+/// @param table The hash table to gather the entries of.
+/// @param entries Output array of up to table->count entries.
+/// @return The number of entries gathered, expired ones are left out.
+static size_t collect (const htable_t *table, struct save_entry *entries) {
+
+    size_t n = 0;
+
+    if (table->engine != HTABLE_ENGINE_CHAIN) {
+        for (size_t idx = 0; idx < table->size; idx++) {
+            if (htable_slot_used(table, idx)) {
+                const struct htable_slot *slot = &table->slots[idx];
+                entries[n++] = (struct save_entry) { slot->key, slot->value, slot->hash, 0, 0 };
+            }
+        }
+        return n;
+    }
+
+    // Both bucket arrays, the table may be in the middle of a rehash.
+    for (size_t idx = 0; idx < table->size + table->rehash_size; idx++) {
+
+        const struct htable_node *node = idx < table->size ? table->table[idx] : table->rehash_table[idx - table->size];
+
+        for (; node != NULL; node = node->next) {
+            // Expired entries are hidden already, they only wait for a write or htable_expire to free them.
+            if (node->expires == 0 || !htable_ttl_due(node->expires, htable_ttl_now(table))) {
+                // Hash nodes left in the previous array of a rehash still carry the previous hashes.
+                const unsigned long hash = idx >= table->size && table->rehash_rekey ? htable_node_hash(table, node) : node->hash;
+
+                entries[n++] = (struct save_entry) { node->key, node->value, hash, 0, 0 };
+            }
+        }
+    }
+
+    return n;
+}
+
+/// @brief Byte offsets of the bucket array and the entries of a mapped image.
+static const uint64_t *image_offsets (const htable_t *table) {
+    return (const uint64_t *) (const void *) (table->image + IMAGE_HEADER);
+}
+
+static const unsigned char *image_entries (const htable_t *table) {
+    return table->image + IMAGE_HEADER + (table->size + 1U) * sizeof(uint64_t);
+}
+
+/// @brief Byte offset of the first entry of a bucket of a mapped image.
+static uint64_t bucket_begin (const htable_t *table, size_t bucket) {
+    return image_offsets(table)[bucket];
+}
+
+/// @brief Step to the next entry of a bucket of a mapped image.
+/// @param table The hash table of the image.
+/// @param bucket The bucket being walked.
+/// @param pos The byte offset of the entry, advanced past it.
+/// @return Pointer to the key bytes of the entry, NULL at the end of the bucket.
+static const unsigned char *entry_at (const htable_t *table, size_t bucket, uint64_t *pos) {
+
+    const unsigned char *entries = image_entries(table);
+
+    // Bound every walk by the mapping, a truncated or corrupted image must not be read past its end.
+    const uint64_t limit = table->image_size - (uint64_t) (entries - table->image);
+    const uint64_t end = image_offsets(table)[bucket + 1U] < limit ? image_offsets(table)[bucket + 1U] : limit;
+
+    // Compare against the bytes left rather than adding to the offset, corrupted lengths could wrap the sum.
+    if (*pos > end || end - *pos < sizeof(struct image_entry)) {
+        return NULL;
+    }
+
+    const struct image_entry *entry = (const void *) (entries + *pos);
+    uint64_t left = end - *pos - sizeof(*entry);
+
+    if (entry->key_len > left || IMAGE_PAD(entry->key_len) > left) {
+        return NULL;
+    }
+
+    left -= IMAGE_PAD(entry->key_len);
+
+    if (entry->value_len > left || IMAGE_PAD(entry->value_len) > left) {
+        return NULL;
+    }
+
+    *pos += sizeof(*entry) + IMAGE_PAD(entry->key_len) + IMAGE_PAD(entry->value_len);
+
+    return (const unsigned char *) (entry + 1);
+}
+
+// --- Internal Function Definitions --- //
+
+/// @brief Unmap the image of a hash table opened by htable_open_mmap.
+void htable_image_destroy (htable_t *table) {
+    (void) munmap((void *) table->image, table->image_size);
+}
+
+/// @brief Retrieve a value with a precomputed hash from a mapped image.
+void *htable_image_get (const htable_t *table, const void *key, unsigned long hash) {
+
+    const size_t bucket = (size_t) (hash & (table->size - 1U));
+    const unsigned char *entry_key = NULL;
+
+    for (uint64_t pos = bucket_begin(table, bucket); (entry_key = entry_at(table, bucket, &pos)) != NULL;) {
+
+        const struct image_entry *entry = (const struct image_entry *) (const void *) entry_key - 1;
+
+        if (entry->hash == (uint64_t) hash && table->keq(entry_key, key)) {
+            return (void *) (entry_key + IMAGE_PAD(entry->key_len));
+        }
+    }
+
+    return NULL;
+}
+
+/// @brief Call fn with every entry of a bucket of a mapped image.
+void htable_image_visit (const htable_t *table, size_t bucket, htable_scan_t fn, void *ctx) {
+
+    const unsigned char *entry_key = NULL;
+
+    for (uint64_t pos = bucket_begin(table, bucket); (entry_key = entry_at(table, bucket, &pos)) != NULL;) {
+        const struct image_entry *entry = (const struct image_entry *) (const void *) entry_key - 1;
+        fn(entry_key, (void *) (entry_key + IMAGE_PAD(entry->key_len)), ctx);
+    }
+}
+
+/// @brief Prefetch the bucket offset a lookup of the hash touches first.
+void htable_image_prefetch (const htable_t *table, unsigned long hash) {
+    HTABLE_PREFETCH(&image_offsets(table)[hash & (table->size - 1U)]);
+}
+
+// --- Function Definitions --- //
+
+/// @brief Write a position-independent image of the hash table.
+int htable_save (const htable_t *table, int fd) {
+
+    if (table == NULL || fd < 0) {
+        return -1;
+    }
+
+    // A mapped image is already in its on-disk form.
+    if (table->engine == HTABLE_ENGINE_IMAGE) {
+        return write_all(fd, table->image, table->image_size);
+    }
+
+    // Images are opened with a plain hash function, which cannot reproduce seeded hashes.
+    if (table->seeded_hash != NULL) {
+        return -1;
+    }
+
+    // The value of a key of a multimap is an array of values, which vsize cannot describe.
+    if (table->cbs.ksize == NULL || table->cbs.vsize == NULL || (table->flags & HTABLE_MULTI)) {
+        return -1;
+    }
+
+    struct save_entry *entries = malloc((table->count > 0 ? table->count : 1U) * sizeof(*entries));
+    size_t *order = malloc((table->count > 0 ? table->count : 1U) * sizeof(*order));
+    uint64_t *offsets = NULL;
+    size_t *starts = NULL;
+    struct image_writer writer = { fd, malloc(IMAGE_BUFFER), 0, 0 };
+
+    int rc = -2;
+
+    if (entries == NULL || order == NULL || writer.buf == NULL) {
+        goto cleanup;
+    }
+
+    const size_t count = collect(table, entries);
+    uint64_t buckets = 1U;
+
+    while (buckets < count) {
+        buckets <<= 1U;
+    }
+
+    if ((offsets = calloc(buckets + 1U, sizeof(*offsets))) == NULL || (starts = calloc(buckets + 1U, sizeof(*starts))) == NULL) {
+        goto cleanup;
+    }
+
+    // Size every bucket, offsets[idx] becomes the first byte and starts[idx] the first entry of bucket idx.
+    for (size_t idx = 0; idx < count; idx++) {
+        struct save_entry *entry = &entries[idx];
+        const uint64_t bucket = entry->hash & (buckets - 1U);
+
+        entry->key_len = table->cbs.ksize(entry->key);
+        entry->value_len = table->cbs.vsize(entry->value);
+
+        offsets[bucket + 1U] += sizeof(struct image_entry) + IMAGE_PAD(entry->key_len) + IMAGE_PAD(entry->value_len);
+        starts[bucket + 1U]++;
+    }
+
+    for (uint64_t idx = 1; idx <= buckets; idx++) {
+        offsets[idx] += offsets[idx - 1U];
+        starts[idx] += starts[idx - 1U];
+    }
+
+    // Order the entries by bucket with a counting sort.
+    for (size_t idx = 0; idx < count; idx++) {
+        order[starts[entries[idx].hash & (buckets - 1U)]++] = idx;
+    }
+
+    const struct image_header header = {
+        .magic = IMAGE_MAGIC,
+        .version = IMAGE_VERSION,
+        .endian = IMAGE_ENDIAN,
+        .flags = table->flags & HTABLE_MIX_HASH,
+        .hash_size = sizeof(unsigned long),
+        .buckets = buckets,
+        .count = count,
+        .size = IMAGE_HEADER + (buckets + 1U) * sizeof(uint64_t) + offsets[buckets],
+    };
+
+    emit(&writer, &header, sizeof(header), IMAGE_HEADER);
+    emit(&writer, offsets, (buckets + 1U) * sizeof(*offsets), (buckets + 1U) * sizeof(*offsets));
+
+    for (size_t pos = 0; pos < count; pos++) {
+        const struct save_entry *entry = &entries[order[pos]];
+        const struct image_entry record = { entry->hash, entry->key_len, entry->value_len };
+
+        emit(&writer, &record, sizeof(record), sizeof(record));
+        emit(&writer, entry->key, entry->key_len, IMAGE_PAD(entry->key_len));
+        emit(&writer, entry->value, entry->value_len, IMAGE_PAD(entry->value_len));
+    }
+
+    if (!writer.failed && writer.len > 0) {
+        writer.failed = write_all(fd, writer.buf, writer.len) != 0;
+    }
+
+    rc = writer.failed ? -2 : 0;
+
+cleanup:
+    free(entries);
+    free(order);
+    free(offsets);
+    free(starts);
+    free(writer.buf);
+
+    return rc;
+}
+
+/// @brief Map an image written by htable_save read-only.
+htable_t *htable_open_mmap (const char *path, htable_hash_t hash, htable_keq_t keq) {
+
+    if (path == NULL || hash == NULL || keq == NULL) {
+        return NULL;
+    }
+
+    const int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    void *image = MAP_FAILED;
+
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= IMAGE_HEADER) {
+        image = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+
+    // The mapping stays valid after the descriptor is closed.
+    (void) close(fd);
+
+    if (image == MAP_FAILED) {
+        return NULL;
+    }
+
+    const struct image_header *header = image;
+    const size_t size = (size_t) st.st_size;
+
+    // Only the header, the bucket count and the size are checked up front, so opening stays constant time.
+    const int valid = memcmp(header->magic, IMAGE_MAGIC, sizeof(header->magic)) == 0
+        && header->version == IMAGE_VERSION
+        && header->endian == IMAGE_ENDIAN
+        && header->hash_size == sizeof(unsigned long)
+        && header->buckets > 0 && (header->buckets & (header->buckets - 1U)) == 0
+        && header->size == size
+        && header->buckets < (size - IMAGE_HEADER) / sizeof(uint64_t);
+
+    htable_t *table = NULL;
+
+    if (!valid || (table = calloc(1U, sizeof(*table))) == NULL) {
+        (void) munmap(image, size);
+        return NULL;
+    }
+
+    table->engine = HTABLE_ENGINE_IMAGE;
+    table->flags = header->flags;
+    table->hash = hash;
+    table->keq = keq;
+    table->size = (size_t) header->buckets;
+    table->count = (size_t) header->count;
+    table->image = image;
+    table->image_size = size;
+
+    return table;
+}
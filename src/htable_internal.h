@@ -0,0 +1,447 @@
+// ==============================================================================
+//                             Hash table internals
+// ==============================================================================
+//
+// Description: Declarations shared between the translation units of the hash
+// table library. This header is private to the library and is not installed
+// alongside htable.h.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#ifndef HTABLE_INTERNAL_H_
+#define HTABLE_INTERNAL_H_
+
+    #include "htable.h"
+
+    #include <stdint.h>     // For fixed width integer types, e.g. uint64_t.
+
+    // --- Macros --- //
+
+    #if defined(__GNUC__)
+        #define HTABLE_PREFETCH(addr) __builtin_prefetch((addr))
+    #else
+        #define HTABLE_PREFETCH(addr) ((void) (addr))
+    #endif
+
+    // --- Hashing --- //
+
+    /// @brief MurmurHash3 fmix64 finalizer, spreads every input bit over the whole word.
+    static inline uint64_t htable_fmix64 (uint64_t h) {
+        h ^= h >> 33U;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33U;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33U;
+        return h;
+    }
+
+    /// @brief Hash a key with the user hash function, or the seeded one if the table has it, finalized if
+    /// HTABLE_MIX_HASH is set.
+    static inline unsigned long htable_hash_key (const htable_t *table, const void *key) {
+        const unsigned long hash = table->seeded_hash != NULL ? table->seeded_hash(key, table->seed) : table->hash(key);
+        return (table->flags & HTABLE_MIX_HASH) ? (unsigned long) htable_fmix64(hash) : hash;
+    }
+
+    /// @brief Hash a length-aware key with the hash_n function, finalized if HTABLE_MIX_HASH is set.
+    /// The default hash_n is keyed by the seed of a table with a seeded_hash.
+    unsigned long htable_hash_key_n (const htable_t *table, const void *key, size_t len);
+
+    /// @brief Hash the key of a hash node with the current hashing setup of its table.
+    unsigned long htable_node_hash (const htable_t *table, const struct htable_node *node);
+
+    /// @brief Map a hash value to a bucket of a bucket array of the given size.
+    /// @param table The hash table owning the bucket array.
+    /// @param hash The hash value of the key.
+    /// @param size The number of buckets in the bucket array.
+    /// @return The bucket index for the hash value.
+    static inline size_t htable_bucket_index (const htable_t *table, unsigned long hash, size_t size) {
+        // Power-of-two sizes avoid the integer division on every operation.
+        return (table->flags & HTABLE_POW2) ? (size_t) (hash & (size - 1U)) : (size_t) (hash % size);
+    }
+
+    /// @brief Check whether a slot of an open-addressing hash table holds an entry.
+    static inline int htable_slot_used (const htable_t *table, size_t idx) {
+        switch (table->engine) {
+            case HTABLE_ENGINE_SWISS:
+                return (table->ctrl[idx] & 0x80U) == 0;
+            case HTABLE_ENGINE_COMPACT:
+                return idx < table->count;
+            default:
+                return table->slots[idx].dist != 0;
+        }
+    }
+
+    // --- Statistics --- //
+
+    #if defined(HTABLE_STATS)
+
+        #include <stdatomic.h>  // For the relaxed counters, concurrent readers of htable_conc_t update them.
+
+        /// @brief Live statistics counters of a hash table.
+        struct htable_stats_counters {
+            atomic_ullong lookups;
+            atomic_ullong hits;
+            atomic_ullong misses;
+            atomic_ullong searches;
+            atomic_ullong keq_calls;
+            atomic_ullong probe_total;
+            atomic_ullong probes[HTABLE_STATS_PROBES];
+            atomic_ullong resizes;
+            atomic_ullong resize_ns;
+            atomic_ullong evictions;
+            atomic_ullong reseeds;
+        };
+
+        /// @brief Record a lookup and whether it found its key.
+        void htable_stats_lookup (const htable_t *table, int found);
+
+        /// @brief Record a key search that examined probes nodes, slots or groups and called keq keqs times.
+        void htable_stats_search (const htable_t *table, size_t probes, size_t keqs);
+
+        /// @brief Record the start of a resize.
+        void htable_stats_resize (const htable_t *table);
+
+        /// @brief Record an eviction.
+        void htable_stats_evict (const htable_t *table);
+
+        /// @brief Record a re-seed forced by a long chain.
+        void htable_stats_reseed (const htable_t *table);
+
+        /// @brief Add the time elapsed since start to the resize time.
+        void htable_stats_elapsed (const htable_t *table, unsigned long long start);
+
+        /// @brief Monotonic clock in nanoseconds.
+        unsigned long long htable_stats_now (void);
+
+        #define HTABLE_STAT_LOOKUP(table, found) htable_stats_lookup((table), (found))
+        #define HTABLE_STAT_SEARCH(table, probes, keqs) htable_stats_search((table), (probes), (keqs))
+        #define HTABLE_STAT_RESIZE(table) htable_stats_resize((table))
+        #define HTABLE_STAT_EVICT(table) htable_stats_evict((table))
+        #define HTABLE_STAT_RESEED(table) htable_stats_reseed((table))
+        #define HTABLE_STAT_CLOCK(start) const unsigned long long start = htable_stats_now()
+        #define HTABLE_STAT_ELAPSED(table, start) htable_stats_elapsed((table), (start))
+
+    #else
+
+        // Compiled out, the probe counters of the searches are dead code the optimizer removes.
+        #define HTABLE_STAT_LOOKUP(table, found) ((void) 0)
+        #define HTABLE_STAT_SEARCH(table, probes, keqs) ((void) (probes), (void) (keqs))
+        #define HTABLE_STAT_RESIZE(table) ((void) 0)
+        #define HTABLE_STAT_EVICT(table) ((void) 0)
+        #define HTABLE_STAT_RESEED(table) ((void) 0)
+        #define HTABLE_STAT_CLOCK(start) ((void) 0)
+        #define HTABLE_STAT_ELAPSED(table, start) ((void) 0)
+
+    #endif
+
+    /// @brief Allocate the statistics counters of a hash table, a no-op without HTABLE_STATS.
+    /// @return 0 on success, -2 on memory allocation failure.
+    int htable_stats_attach (htable_t *table);
+
+    /// @brief Free the statistics counters of a hash table.
+    void htable_stats_detach (htable_t *table);
+
+    // --- Dispatch --- //
+
+    /// @brief Insert a key-value pair whose hash has already been computed.
+    /// @param table The hash table to insert the key-value pair into.
+    /// @param key The key for the hash node.
+    /// @param value The value for the hash node.
+    /// @param hash The hash value of the key, as returned by htable_hash_key.
+    /// @return 0 on success, -2 on memory allocation failure or a full fixed-size table.
+    int htable_insert_hashed (htable_t *table, const void *key, const void *value, unsigned long hash);
+
+    /// @brief Find the value slot of a key whose hash has already been computed, inserting the key if it is absent.
+    /// @param table The hash table to search.
+    /// @param key The key for the hash node.
+    /// @param hash The hash value of the key, as returned by htable_hash_key.
+    /// @param owned Non-zero to store the key itself instead of running the key copy callback.
+    /// @param inserted Set to 1 if the key was inserted with a NULL value, 0 if it was present.
+    /// @return Pointer to the value of the key, NULL on memory allocation failure or a full fixed-size table.
+    void **htable_upsert_hashed (htable_t *table, const void *key, unsigned long hash, int owned, int *inserted);
+
+    /// @brief Remove a key-value pair whose hash has already been computed.
+    /// @return 0 on success, -1 if the key is not present.
+    int htable_remove_hashed (htable_t *table, const void *key, unsigned long hash);
+
+    /// @brief Unlink a key-value pair whose hash has already been computed, handing it to the caller.
+    /// @param table The hash table to remove the key-value pair from.
+    /// @param key The key for the hash node.
+    /// @param hash The hash value of the key, as returned by htable_hash_key.
+    /// @param key_out Output pointer receiving the stored key, NULL to free it instead.
+    /// @param value_out Output pointer receiving the stored value, NULL to free it instead.
+    /// @return 0 on success, -1 if the key is not present, -2 on memory allocation failure.
+    int htable_take_hashed (htable_t *table, const void *key, unsigned long hash, void **key_out, void **value_out);
+
+    /// @brief Retrieve a value whose key hash has already been computed, without modifying the table.
+    /// @return Pointer to the value on success, NULL if the key is not present.
+    void *htable_get_hashed (const htable_t *table, const void *key, unsigned long hash);
+
+    /// @brief Copy a key or value into a hash node if it fits its inline storage, through the copy callback otherwise.
+    /// @param table The hash table owning the hash node.
+    /// @param storage The inline storage of the hash node for the key or value.
+    /// @param src The key or value to store.
+    /// @param size The size callback of the key or value, NULL if it is never stored inline.
+    /// @param cpy The copy callback of the key or value.
+    /// @return Pointer to the stored key or value.
+    void *htable_store_inline (const htable_t *table, unsigned char *storage, const void *src, htable_size_t size, htable_cpy_t cpy);
+
+    /// @brief Check whether a hash table frees keys or values that its copy callbacks do not copy, as it does for
+    /// the keys and values handed over by htable_insert_owned with the default kcpy or vcpy.
+    /// @return Non-zero if a copy made through kcpy or vcpy would still be freed along with the original.
+    int htable_copies_shared (const htable_t *table);
+
+    /// @brief Start migrating the chaining engine to a bucket array of the given size, after finishing any
+    /// migration in progress. Later operations move the buckets over incrementally.
+    /// @param table The hash table to resize.
+    /// @param size The new number of buckets, the current size times or divided by a power of two.
+    /// @return 0 on success, -2 on memory allocation failure.
+    int htable_chain_resize (htable_t *table, size_t size);
+
+    /// @brief Free the key, the value and the hash node of an unlinked hash node, chaining engine only.
+    void htable_free_node (const htable_t *table, struct htable_node *node);
+
+    /// @brief Make room for one more entry of a full capacity-bounded table by evicting one with the CLOCK hand.
+    /// Entries whose reference bit is set have it cleared and are passed over, the first one without is evicted.
+    /// @param table The hash table to evict from, holding at least one entry.
+    void htable_evict (htable_t *table);
+
+    // --- Seeding --- //
+
+    /// @brief Draw a random, non-zero hash seed from the system, or from the clock if it has no random device.
+    unsigned long long htable_seed_random (void);
+
+    /// @brief Re-seed a table whose inserts found a chain longer than max_chain.
+    /// Called by the public functions once they are done with the hashes they computed, since re-seeding
+    /// changes every hash of the table.
+    static inline void htable_reseed_if_pending (htable_t *table) {
+        if (table->reseed_pending) {
+            HTABLE_STAT_RESEED(table);
+            (void) htable_reseed(table);
+        }
+    }
+
+    // --- Snapshots --- //
+
+    /// @brief Copy bucket idx into every snapshot that still shares it.
+    /// @return 0 on success, -2 on memory allocation failure, in which case the bucket must not be written.
+    int htable_snapshot_preserve (htable_t *table, size_t idx);
+
+    /// @brief Copy every bucket still shared into the snapshots and detach them from the hash table.
+    /// @param table The hash table about to move or free its hash nodes.
+    /// @param force Non-zero to detach them even on memory allocation failure, losing the buckets left shared.
+    /// @return 0 on success, -2 on memory allocation failure, in which case unforced snapshots stay attached.
+    int htable_snapshot_detach (htable_t *table, int force);
+
+    /// @brief Make sure no snapshot shares the bucket of the hash before the chaining engine writes to it.
+    /// Snapshots are only taken with no migration in progress and detach before the next one, so the current
+    /// bucket array is the only one.
+    static inline int htable_cow (htable_t *table, unsigned long hash) {
+        return table->snapshots == NULL ? 0 : htable_snapshot_preserve(table, htable_bucket_index(table, hash, table->size));
+    }
+
+    // --- Builds --- //
+
+    /// @brief Hash every key, split over several threads for large builds.
+    /// @param table The hash table the keys are hashed for, only its hash functions, seed and flags are read.
+    /// @param keys The keys to hash.
+    /// @param hashes Output array receiving the hash value of every key.
+    /// @param n The number of keys.
+    void htable_hash_keys (const htable_t *table, const void *const *keys, unsigned long *hashes, size_t n);
+
+    /// @brief Check the arguments of a build.
+    /// @return 0 if they are valid, -1 otherwise.
+    int htable_build_check (const void *const *keys, const void *const *values, size_t n, htable_hash_t hash, htable_keq_t keq, const struct htable_opts *opts);
+
+    /// @brief Copy the configuration of a build, with a random seed drawn for a seeded hash without one.
+    /// Every table of the build has to be created with the returned configuration to match the hashes.
+    struct htable_opts htable_build_opts (const struct htable_opts *opts);
+
+    /// @brief Create a hash table sized for and filled with key-value pairs whose keys are already hashed, like htable_build.
+    htable_t *htable_build_hashed (const void *const *keys, const void *const *values, const unsigned long *hashes, size_t n, htable_hash_t hash, htable_keq_t keq, const struct callbacks *cbs, const struct htable_opts *opts);
+
+    /// @brief Map a hash value to one of 2^bits partitions, by the high bits of its mix so buckets stay independent.
+    static inline size_t htable_part_index (unsigned long hash, unsigned int bits) {
+        return bits == 0 ? 0 : (size_t) (htable_fmix64(hash) >> (64U - bits));
+    }
+
+    // --- Expiry --- //
+
+    /// @brief Check whether an expiry tick has been reached.
+    static inline int htable_ttl_due (unsigned long long expires, unsigned long long now) {
+        return expires != 0 && now >= expires;
+    }
+
+    /// @brief Read the current tick of the timing wheel of a hash table that has one.
+    unsigned long long htable_ttl_now (const htable_t *table);
+
+    /// @brief Schedule the expiry of a key, creating the timing wheel on first use.
+    /// @param table The hash table the key is inserted into.
+    /// @param hash The hash value of the key.
+    /// @param ttl_ms The time to live in milliseconds.
+    /// @param expires Set to the expiry tick to store in the hash node.
+    /// @return 0 on success, -2 on memory allocation failure.
+    int htable_ttl_schedule (htable_t *table, unsigned long hash, unsigned long long ttl_ms, unsigned long long *expires);
+
+    /// @brief Schedule every hash node with an expiry tick again, after their hashes have been rewritten.
+    /// @return 0 on success, -2 on memory allocation failure.
+    int htable_ttl_reschedule (htable_t *table);
+
+    /// @brief Free the timing wheel of a hash table.
+    void htable_ttl_destroy (htable_t *table);
+
+    /// @brief Set the CLOCK reference bit of a hit, written only once so repeated hits keep the cache line clean.
+    #define HTABLE_CLOCK_REF(table, entry)                                                          \
+        do {                                                                                        \
+            if ((table)->capacity > 0 && (entry)->ref == 0) {                                       \
+                (entry)->ref = 1U;                                                                  \
+            }                                                                                       \
+        } while (0)
+
+    /// @brief Migrate buckets from the previous hash table to the current one, chaining engine only.
+    /// @param table The hash table being rehashed.
+    /// @param steps The maximum number of non-empty buckets to migrate.
+    void htable_rehash_step (htable_t *table, size_t steps);
+
+    // --- Robin Hood Engine --- //
+
+    /// @brief Allocate the slot array of a Robin Hood hash table.
+    /// @param table The hash table to initialize.
+    /// @param size The requested number of slots, rounded up to a power of two.
+    /// @return 0 on success, -2 on memory allocation failure.
+    int htable_robin_init (htable_t *table, size_t size);
+
+    /// @brief Free every entry and the slot array of a Robin Hood hash table.
+    void htable_robin_destroy (htable_t *table);
+
+    /// @brief Rebuild the slot array of a Robin Hood hash table from the stored hashes.
+    /// @param table The hash table to resize.
+    /// @param size The requested number of slots, rounded up to a power of two above the number of entries.
+    /// @return 0 on success, -2 on memory allocation failure.
+    int htable_robin_resize (htable_t *table, size_t size);
+
+    /// @brief Insert a key-value pair with a precomputed hash into a Robin Hood hash table.
+    int htable_robin_insert (htable_t *table, const void *key, const void *value, unsigned long hash);
+
+    /// @brief Find or claim the value slot of a key with a precomputed hash in a Robin Hood hash table.
+    void **htable_robin_upsert (htable_t *table, const void *key, unsigned long hash, int owned, int *inserted);
+
+    /// @brief Unlink a key-value pair with a precomputed hash from a Robin Hood hash table.
+    /// The key and value are returned unfreed through the output pointers that are not NULL, and freed otherwise.
+    int htable_robin_take (htable_t *table, const void *key, unsigned long hash, void **key_out, void **value_out);
+
+    /// @brief Remove a key-value pair with a precomputed hash from a Robin Hood hash table.
+    int htable_robin_remove (htable_t *table, const void *key, unsigned long hash);
+
+    /// @brief Retrieve a value with a precomputed hash from a Robin Hood hash table.
+    void *htable_robin_get (const htable_t *table, const void *key, unsigned long hash);
+
+    /// @brief Prefetch the memory a lookup of the hash touches first.
+    void htable_robin_prefetch (const htable_t *table, unsigned long hash);
+
+    // --- SwissTable Engine --- //
+
+    /// @brief Allocate the control bytes and slots of a SwissTable hash table.
+    /// @param table The hash table to initialize.
+    /// @param size The requested number of slots, rounded up to a power of two of at least one group.
+    /// @return 0 on success, -2 on memory allocation failure.
+    int htable_swiss_init (htable_t *table, size_t size);
+
+    /// @brief Free every entry, the control bytes and slots of a SwissTable hash table.
+    void htable_swiss_destroy (htable_t *table);
+
+    /// @brief Rebuild the control bytes and slots of a SwissTable hash table from the stored hashes.
+    /// @param table The hash table to resize.
+    /// @param size The requested number of slots, rounded up to a power of two above the number of entries.
+    /// @return 0 on success, -2 on memory allocation failure.
+    int htable_swiss_resize (htable_t *table, size_t size);
+
+    /// @brief Insert a key-value pair with a precomputed hash into a SwissTable hash table.
+    int htable_swiss_insert (htable_t *table, const void *key, const void *value, unsigned long hash);
+
+    /// @brief Find or claim the value slot of a key with a precomputed hash in a SwissTable hash table.
+    void **htable_swiss_upsert (htable_t *table, const void *key, unsigned long hash, int owned, int *inserted);
+
+    /// @brief Unlink a key-value pair with a precomputed hash from a SwissTable hash table, see htable_robin_take.
+    int htable_swiss_take (htable_t *table, const void *key, unsigned long hash, void **key_out, void **value_out);
+
+    /// @brief Remove a key-value pair with a precomputed hash from a SwissTable hash table.
+    int htable_swiss_remove (htable_t *table, const void *key, unsigned long hash);
+
+    /// @brief Retrieve a value with a precomputed hash from a SwissTable hash table.
+    void *htable_swiss_get (const htable_t *table, const void *key, unsigned long hash);
+
+    /// @brief Prefetch the memory a lookup of the hash touches first.
+    void htable_swiss_prefetch (const htable_t *table, unsigned long hash);
+
+    // --- Compact Engine --- //
+
+    /// @brief Allocate the slot and bucket arrays of a compact hash table.
+    /// @param table The hash table to initialize.
+    /// @param size The requested number of slots and buckets, rounded up to a power of two.
+    /// @return 0 on success, -2 on memory allocation failure.
+    int htable_compact_init (htable_t *table, size_t size);
+
+    /// @brief Free every entry and the slot and bucket arrays of a compact hash table.
+    void htable_compact_destroy (htable_t *table);
+
+    /// @brief Rebuild the bucket heads of a compact hash table from the stored hashes, resizing both arrays.
+    /// @param table The hash table to resize.
+    /// @param size The requested number of slots, rounded up to a power of two of at least the number of entries.
+    /// @return 0 on success, -2 on memory allocation failure.
+    int htable_compact_resize (htable_t *table, size_t size);
+
+    /// @brief Insert a key-value pair with a precomputed hash into a compact hash table.
+    int htable_compact_insert (htable_t *table, const void *key, const void *value, unsigned long hash);
+
+    /// @brief Find or claim the value slot of a key with a precomputed hash in a compact hash table.
+    void **htable_compact_upsert (htable_t *table, const void *key, unsigned long hash, int owned, int *inserted);
+
+    /// @brief Unlink a key-value pair with a precomputed hash from a compact hash table, see htable_robin_take.
+    int htable_compact_take (htable_t *table, const void *key, unsigned long hash, void **key_out, void **value_out);
+
+    /// @brief Remove a key-value pair with a precomputed hash from a compact hash table.
+    int htable_compact_remove (htable_t *table, const void *key, unsigned long hash);
+
+    /// @brief Retrieve a value with a precomputed hash from a compact hash table.
+    void *htable_compact_get (const htable_t *table, const void *key, unsigned long hash);
+
+    /// @brief Prefetch the memory a lookup of the hash touches first.
+    void htable_compact_prefetch (const htable_t *table, unsigned long hash);
+
+    // --- Image Engine --- //
+
+    /// @brief Unmap the image of a hash table opened by htable_open_mmap.
+    void htable_image_destroy (htable_t *table);
+
+    /// @brief Retrieve a value with a precomputed hash from a mapped image.
+    void *htable_image_get (const htable_t *table, const void *key, unsigned long hash);
+
+    /// @brief Call fn with every entry of a bucket of a mapped image.
+    void htable_image_visit (const htable_t *table, size_t bucket, htable_scan_t fn, void *ctx);
+
+    /// @brief Prefetch the bucket offset a lookup of the hash touches first.
+    void htable_image_prefetch (const htable_t *table, unsigned long hash);
+
+#endif // HTABLE_INTERNAL_H_
@@ -0,0 +1,249 @@
+// ==============================================================================
+//                             Hash Table Iteration
+// ==============================================================================
+//
+// Description: Cursor based scanning that stays correct across the incremental
+// resize of the chaining engine, and parallel traversal splitting the buckets of
+// a hash table into one range per thread.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "htable_internal.h"
+
+#include <limits.h>     // For the number of bits in a byte, CHAR_BIT.
+#include <pthread.h>    // For the traversal threads, e.g. pthread_create(3).
+#include <unistd.h>     // For the number of online processors, e.g. sysconf(3).
+
+// --- Types --- //
+
+/// @brief Range of buckets or slots traversed by a single thread.
+struct iter_range {
+    const htable_t *table;      // The hash table being traversed.
+    size_t begin;               // The first bucket or slot of the range.
+    size_t end;                 // One past the last bucket or slot of the range.
+    htable_scan_t fn;           // The function called with every entry.
+    void *ctx;                  // The user context passed to fn.
+};
+
+// --- Static Function Definitions --- //
+
+/// @brief Reverse the bits of a word.
+static size_t reverse_bits (size_t value) {
+
+    size_t reversed = 0;
+
+    for (size_t bit = 0; bit < sizeof(value) * CHAR_BIT; bit++) {
+        reversed = (reversed << 1U) | (value & 1U);
+        value >>= 1U;
+    }
+
+    return reversed;
+}
+
+/// @brief Largest odd divisor of a bucket count.
+static size_t odd_part (size_t size) {
+
+    while ((size & 1U) == 0) {
+        size >>= 1U;
+    }
+
+    return size;
+}
+
+static void visit_chain (const struct htable_node *node, htable_scan_t fn, void *ctx) {
+    for (; node != NULL; node = node->next) {
+        fn(node->key, node->value, ctx);
+    }
+}
+
+/// @brief Visit the entries of one bucket or slot, numbered across both bucket arrays during a rehash.
+static void visit_index (const htable_t *table, size_t idx, htable_scan_t fn, void *ctx) {
+
+    switch (table->engine) {
+        case HTABLE_ENGINE_ROBIN_HOOD:
+        case HTABLE_ENGINE_SWISS:
+        case HTABLE_ENGINE_COMPACT:
+            if (htable_slot_used(table, idx)) {
+                fn(table->slots[idx].key, table->slots[idx].value, ctx);
+            }
+            break;
+        case HTABLE_ENGINE_IMAGE:
+            htable_image_visit(table, idx, fn, ctx);
+            break;
+        default:
+            visit_chain(idx < table->size ? table->table[idx] : table->rehash_table[idx - table->size], fn, ctx);
+            break;
+    }
+}
+
+/// @brief Scan the chaining engine, see htable_scan.
+static size_t scan_chain (const htable_t *table, size_t cursor, size_t count, htable_scan_t fn, void *ctx) {
+
+    // Bucket counts only ever double, so every size is base * 2^k for the same odd base. Bucket b + base * j
+    // splits into b + base * j and b + base * (j + 2^k), growing only appends a high bit to j, and the
+    // reverse binary increment of Redis SCAN applies to j unchanged. The cursor encodes b + base * j.
+    struct htable_node *const *small = table->table;
+    struct htable_node *const *large = NULL;
+    size_t small_size = table->size;
+    size_t large_size = 0;
+
+    if (table->rehash_table != NULL) {
+        const int grew = table->rehash_size < table->size;
+
+        small = grew ? table->rehash_table : table->table;
+        large = grew ? table->table : table->rehash_table;
+        small_size = grew ? table->rehash_size : table->size;
+        large_size = grew ? table->size : table->rehash_size;
+    }
+
+    const size_t base = odd_part(small_size);
+    const size_t small_mask = small_size / base - 1U;
+    const size_t large_mask = large_size / base - 1U;
+
+    size_t b = cursor % base;
+    size_t j = cursor / base;
+
+    for (; count > 0; count--) {
+
+        visit_chain(small[b + base * (j & small_mask)], fn, ctx);
+
+        // Every bucket of the larger array that the bucket of the smaller one splits into.
+        if (large != NULL) {
+            size_t v = j & small_mask;
+
+            do {
+                visit_chain(large[b + base * (v & large_mask)], fn, ctx);
+                v = (((v | small_mask) + 1U) & ~small_mask) | (v & small_mask);
+            } while (v & (small_mask ^ large_mask));
+        }
+
+        if (++b < base) {
+            continue;
+        }
+
+        // Increment the reversed bits of j, keeping it within the mask of the smaller array.
+        b = 0;
+        j = reverse_bits(reverse_bits(j | ~small_mask) + 1U);
+
+        if (j == 0) {
+            return 0;
+        }
+    }
+
+    return b + base * j;
+}
+
+static void *visit_range (void *arg) {
+
+    const struct iter_range *range = arg;
+
+    for (size_t idx = range->begin; idx < range->end; idx++) {
+        visit_index(range->table, idx, range->fn, range->ctx);
+    }
+
+    return NULL;
+}
+
+// --- Function Definitions --- //
+
+/// @brief Visit a few buckets of the hash table, resuming from a cursor.
+size_t htable_scan (const htable_t *table, size_t cursor, size_t count, htable_scan_t fn, void *ctx) {
+
+    if (table == NULL || fn == NULL || (table->table == NULL && table->slots == NULL && table->image == NULL)) {
+        return 0;
+    }
+
+    count = count > 0 ? count : 1U;
+
+    if (table->engine == HTABLE_ENGINE_CHAIN) {
+        return scan_chain(table, cursor, count, fn, ctx);
+    }
+
+    // Slots and image buckets never move while the table is left alone, a plain index is enough.
+    for (; count > 0 && cursor < table->size; count--) {
+        visit_index(table, cursor++, fn, ctx);
+    }
+
+    return cursor < table->size ? cursor : 0;
+}
+
+/// @brief Visit every key-value pair, splitting the buckets or slots into one range per thread.
+int htable_for_each_parallel (const htable_t *table, size_t threads, htable_scan_t fn, void *ctx) {
+
+    if (table == NULL || fn == NULL || (table->table == NULL && table->slots == NULL && table->image == NULL)) {
+        return -1;
+    }
+
+    if (threads == 0) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (size_t) cpus : 1U;
+    }
+
+    // The chaining engine numbers the buckets of both arrays during a rehash.
+    const size_t total = table->size + (table->engine == HTABLE_ENGINE_CHAIN ? table->rehash_size : 0);
+
+    threads = threads < total ? threads : total;
+
+    pthread_t *workers = malloc(threads * sizeof(*workers));
+    struct iter_range *ranges = malloc(threads * sizeof(*ranges));
+    int *started = calloc(threads, sizeof(*started));
+
+    // Without memory for the bookkeeping, traverse everything on the calling thread.
+    if (workers == NULL || ranges == NULL || started == NULL) {
+        struct iter_range range = { table, 0, total, fn, ctx };
+
+        free(workers);
+        free(ranges);
+        free(started);
+
+        (void) visit_range(&range);
+        return 0;
+    }
+
+    for (size_t t = 0; t < threads; t++) {
+        ranges[t] = (struct iter_range) { table, total * t / threads, total * (t + 1U) / threads, fn, ctx };
+        started[t] = t > 0 && pthread_create(&workers[t], NULL, visit_range, &ranges[t]) == 0;
+    }
+
+    // The calling thread takes the first range, and every range whose thread could not be started.
+    for (size_t t = 0; t < threads; t++) {
+        if (!started[t]) {
+            (void) visit_range(&ranges[t]);
+        }
+    }
+
+    for (size_t t = 0; t < threads; t++) {
+        if (started[t]) {
+            (void) pthread_join(workers[t], NULL);
+        }
+    }
+
+    free(workers);
+    free(ranges);
+    free(started);
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+// ==============================================================================
+//                              Locked Hash table
+// ==============================================================================
+//
+// Description: Reader/writer locked hash tables and the routing of keys to them,
+// the shared core of the lock striped and the sharded front-ends.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "htable_locked.h"
+
+// --- Function Definitions --- //
+
+/// @brief Settle the configuration of the tables of a front-end.
+struct htable_opts htable_route_opts (const struct htable_opts *opts) {
+
+    // One seed for every table, the keys are hashed once to pick their table and that hash is reused inside it.
+    struct htable_opts config = htable_build_opts(opts);
+
+    // Re-seeding a single table would leave it out of step with the route, like the partitions of a build.
+    config.max_chain = 0;
+
+    return config;
+}
+
+/// @brief Set up the routing of keys over a number of tables rounded up to a power of two.
+void htable_route_init (struct htable_route *route, size_t parts, htable_hash_t hash, const struct htable_opts *config) {
+
+    *route = (struct htable_route) {
+        .shape = { .hash = hash, .seeded_hash = config->seeded_hash, .seed = config->seed, .flags = config->flags },
+        .parts = 1U,
+        .shift = 64U,
+    };
+
+    while (route->parts < parts) {
+        route->parts <<= 1U;
+        route->shift--;
+    }
+}
+
+/// @brief Create the hash table and the lock of a part.
+int htable_locked_init (struct htable_locked *part, size_t size, htable_hash_t hash, htable_keq_t keq, const struct callbacks *cbs, const struct htable_opts *config) {
+
+    if ((part->table = htable_create_ex(size, hash, keq, cbs, config)) == NULL) {
+        return -2;
+    }
+
+    if (pthread_rwlock_init(&part->lock, NULL) != 0) {
+        htable_destroy(part->table);
+        part->table = NULL;
+        return -2;
+    }
+
+    return 0;
+}
+
+/// @brief Destroy the hash table and the lock of a part.
+void htable_locked_destroy (struct htable_locked *part) {
+    (void) pthread_rwlock_destroy(&part->lock);
+    htable_destroy(part->table);
+}
+
+/// @brief Insert a key-value pair while holding the lock of the part exclusively.
+int htable_locked_insert (struct htable_locked *part, const void *key, const void *value, unsigned long hash) {
+
+    (void) pthread_rwlock_wrlock(&part->lock);
+
+    // Writers drive the incremental rehash, readers never modify the part.
+    htable_rehash_step(part->table, HTABLE_REHASH_STEP);
+    const int rc = htable_insert_hashed(part->table, key, value, hash);
+
+    (void) pthread_rwlock_unlock(&part->lock);
+
+    return rc;
+}
+
+/// @brief Remove a key-value pair while holding the lock of the part exclusively.
+int htable_locked_remove (struct htable_locked *part, const void *key, unsigned long hash) {
+
+    (void) pthread_rwlock_wrlock(&part->lock);
+
+    htable_rehash_step(part->table, HTABLE_REHASH_STEP);
+    const int rc = htable_remove_hashed(part->table, key, hash);
+
+    (void) pthread_rwlock_unlock(&part->lock);
+
+    return rc;
+}
+
+/// @brief Retrieve a value while holding the lock of the part shared.
+void *htable_locked_get (struct htable_locked *part, const void *key, unsigned long hash, void (*visit)(void *value, void *ctx), void *ctx) {
+
+    (void) pthread_rwlock_rdlock(&part->lock);
+
+    void *value = htable_get_hashed(part->table, key, hash);
+
+    if (value != NULL && visit != NULL) {
+        visit(value, ctx);
+    }
+
+    (void) pthread_rwlock_unlock(&part->lock);
+
+    return value;
+}
+
+/// @brief Count the elements of a part while holding its lock shared.
+size_t htable_locked_count (struct htable_locked *part) {
+
+    (void) pthread_rwlock_rdlock(&part->lock);
+    const size_t count = part->table->count;
+    (void) pthread_rwlock_unlock(&part->lock);
+
+    return count;
+}
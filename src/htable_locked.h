@@ -0,0 +1,110 @@
+// ==============================================================================
+//                              Locked Hash table
+// ==============================================================================
+//
+// Description: Reader/writer locked hash tables and the routing of keys to them,
+// the shared core of the lock striped and the sharded front-ends.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#ifndef HTABLE_LOCKED_H_
+#define HTABLE_LOCKED_H_
+
+    // --- Libraries --- //
+
+    #include "htable_internal.h"
+
+    #include <pthread.h>    // For reader/writer locks, e.g. pthread_rwlock_rdlock(3).
+
+    // --- Constants --- //
+
+    /// @brief Locked hash tables are aligned to a cache line to avoid false sharing.
+    #define HTABLE_CACHE_LINE 64U
+
+    // --- Structures --- //
+
+    /// @brief Hash table guarded by a reader/writer lock, a stripe or shard of the front-ends.
+    struct htable_locked {
+        _Alignas(HTABLE_CACHE_LINE) pthread_rwlock_t lock; // The lock guarding the hash table.
+        htable_t *table;                                    // The hash table.
+    };
+
+    /// @brief Routing of keys to the locked hash tables of a front-end.
+    struct htable_route {
+        htable_t shape;     // The hashing configuration shared by every table, only the hash functions, seed and flags are set.
+        size_t parts;       // The number of tables, a power of two.
+        unsigned int shift; // The right shift selecting the table from the high hash bits.
+    };
+
+    // --- Function Prototypes --- //
+
+    /// @brief Settle the configuration of the tables of a front-end, every one of them is created with it.
+    /// A seeded hash without a seed gets one drawn here, and max_chain is cleared since the tables cannot re-seed
+    /// on their own.
+    struct htable_opts htable_route_opts (const struct htable_opts *opts);
+
+    /// @brief Set up the routing of keys over a number of tables rounded up to a power of two.
+    /// @param route The routing to set up.
+    /// @param parts The requested number of tables.
+    /// @param hash User-defined hash function for the keys.
+    /// @param config The configuration returned by htable_route_opts.
+    void htable_route_init (struct htable_route *route, size_t parts, htable_hash_t hash, const struct htable_opts *config);
+
+    /// @brief Hash a key the same way the table of every part does.
+    static inline unsigned long htable_route_hash (const struct htable_route *route, const void *key) {
+        return htable_hash_key(&route->shape, key);
+    }
+
+    /// @brief Select the table of a hash value.
+    /// @return The index of the table.
+    static inline size_t htable_route_part (const struct htable_route *route, unsigned long hash) {
+        // Parts use the high bits of the mixed hash, leaving the low bits for the buckets of the part.
+        return route->shift < 64U ? (size_t) (htable_fmix64(hash) >> route->shift) : 0U;
+    }
+
+    /// @brief Create the hash table and the lock of a part.
+    /// @return 0 on success, -2 on failure.
+    int htable_locked_init (struct htable_locked *part, size_t size, htable_hash_t hash, htable_keq_t keq, const struct callbacks *cbs, const struct htable_opts *config);
+
+    /// @brief Destroy the hash table and the lock of a part.
+    void htable_locked_destroy (struct htable_locked *part);
+
+    /// @brief Insert a key-value pair while holding the lock of the part exclusively.
+    /// @return 0 on success, -2 on memory allocation failure or a full fixed-size table.
+    int htable_locked_insert (struct htable_locked *part, const void *key, const void *value, unsigned long hash);
+
+    /// @brief Remove a key-value pair while holding the lock of the part exclusively.
+    /// @return 0 on success, -1 if the key is not present.
+    int htable_locked_remove (struct htable_locked *part, const void *key, unsigned long hash);
+
+    /// @brief Retrieve a value while holding the lock of the part shared.
+    /// @param visit Optional function called with the value before the lock is released.
+    /// @param ctx User context passed to the function.
+    /// @return Pointer to the value on success, NULL if the key is not present.
+    void *htable_locked_get (struct htable_locked *part, const void *key, unsigned long hash, void (*visit)(void *value, void *ctx), void *ctx);
+
+    /// @brief Count the elements of a part while holding its lock shared.
+    size_t htable_locked_count (struct htable_locked *part);
+
+#endif // HTABLE_LOCKED_H_
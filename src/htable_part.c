@@ -0,0 +1,261 @@
+// ==============================================================================
+//                            Partitioned Hash table
+// ==============================================================================
+//
+// Description: Implementation of the radix-partitioned hash table. Builds and
+// batched probes both scatter their keys by partition with a counting sort over
+// the high bits of the mixed hash, so the partitions are processed one after the
+// other.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#include "htable_part.h"
+#include "htable_internal.h"
+
+// --- Static Function Definitions --- //
+
+/// @brief Counting sort of hashes by partition.
+/// @param hashes The hash value of every key.
+/// @param n The number of keys.
+/// @param bits The number of partition bits.
+/// @param ends Output array of 2^bits entries, partition p ends up spanning [ends[p - 1], ends[p]) of order.
+/// @param order Output array of n entries, receiving the key indices grouped by partition in input order.
+static void partition_keys (const unsigned long *hashes, size_t n, unsigned int bits, size_t *ends, size_t *order) {
+
+    const size_t partitions = (size_t) 1U << bits;
+
+    for (size_t p = 0; p < partitions; p++) {
+        ends[p] = 0;
+    }
+
+    for (size_t idx = 0; idx < n; idx++) {
+        ends[htable_part_index(hashes[idx], bits)]++;
+    }
+
+    // Exclusive prefix sums, the scatter then advances every entry to the end of its partition.
+    for (size_t p = 0, sum = 0; p < partitions; p++) {
+        const size_t count = ends[p];
+        ends[p] = sum;
+        sum += count;
+    }
+
+    for (size_t idx = 0; idx < n; idx++) {
+        order[ends[htable_part_index(hashes[idx], bits)]++] = idx;
+    }
+}
+
+/// @brief Pick the number of partition bits that keeps every partition within HTABLE_PART_BYTES.
+static unsigned int auto_bits (size_t n, const struct htable_opts *opts) {
+
+    const enum htable_engine engine = opts != NULL ? opts->engine : HTABLE_ENGINE_CHAIN;
+    const size_t inline_size = opts != NULL ? opts->inline_size : 0;
+
+    // A hash node and its bucket pointer, or a slot, and for the compact engine a bucket head, of half full arrays.
+    size_t entry = 2U * sizeof(struct htable_slot);
+
+    if (engine == HTABLE_ENGINE_CHAIN) {
+        entry = sizeof(struct htable_node) + 2U * inline_size + sizeof(void *);
+    }
+    else if (engine == HTABLE_ENGINE_COMPACT) {
+        entry = 2U * (sizeof(struct htable_slot) + sizeof(uint32_t));
+    }
+
+    unsigned int bits = 0;
+
+    while (bits < HTABLE_PART_MAX_BITS && (n >> bits) * entry > HTABLE_PART_BYTES) {
+        bits++;
+    }
+
+    return bits;
+}
+
+// --- Function Definitions --- //
+
+/// @brief Create a partitioned hash table filled with an array of key-value pairs.
+htable_part_t *htable_part_build (const void *const *keys, const void *const *values, size_t n, htable_hash_t hash, htable_keq_t keq, const struct callbacks *cbs, const struct htable_opts *opts, unsigned int bits) {
+
+    if (htable_build_check(keys, values, n, hash, keq, opts) != 0 || bits > HTABLE_PART_MAX_BITS) {
+        return NULL;
+    }
+
+    bits = bits > 0 ? bits : auto_bits(n, opts);
+
+    htable_part_t *part = NULL;
+
+    if ((part = calloc(1U, sizeof(*part))) == NULL) {
+        return NULL;
+    }
+
+    part->bits = bits;
+    part->partitions = (size_t) 1U << bits;
+
+    const size_t len = n > 0 ? n : 1U;
+    unsigned long *hashes = malloc(len * sizeof(*hashes));
+    unsigned long *part_hashes = malloc(len * sizeof(*part_hashes));
+    const void **part_keys = malloc(len * sizeof(*part_keys));
+    const void **part_values = malloc(len * sizeof(*part_values));
+    size_t *order = malloc(len * sizeof(*order));
+    size_t *ends = malloc(part->partitions * sizeof(*ends));
+    int rc = -2;
+
+    part->tables = calloc(part->partitions, sizeof(*part->tables));
+
+    if (hashes != NULL && part_hashes != NULL && part_keys != NULL && part_values != NULL && order != NULL && ends != NULL && part->tables != NULL) {
+
+        // Every partition shares the seed, and none may re-seed on its own, its hashes also pick the partition.
+        struct htable_opts config = htable_build_opts(opts);
+        config.max_chain = 0;
+
+        // Only the hash functions, the seed and the flags take part in hashing, no table exists yet.
+        const htable_t shape = { .hash = hash, .seeded_hash = config.seeded_hash, .seed = config.seed, .flags = config.flags };
+
+        htable_hash_keys(&shape, keys, hashes, n);
+        partition_keys(hashes, n, bits, ends, order);
+
+        // Gather the pairs of every partition, keeping their input order so the last duplicate still wins.
+        for (size_t pos = 0; pos < n; pos++) {
+            part_keys[pos] = keys[order[pos]];
+            part_values[pos] = values[order[pos]];
+            part_hashes[pos] = hashes[order[pos]];
+        }
+
+        rc = 0;
+
+        for (size_t p = 0, begin = 0; p < part->partitions && rc == 0; begin = ends[p++]) {
+            part->tables[p] = htable_build_hashed(&part_keys[begin], &part_values[begin], &part_hashes[begin], ends[p] - begin, hash, keq, cbs, &config);
+            rc = part->tables[p] != NULL ? 0 : -2;
+        }
+    }
+
+    free(hashes);
+    free(part_hashes);
+    free(part_keys);
+    free(part_values);
+    free(order);
+    free(ends);
+
+    if (rc != 0) {
+        htable_part_destroy(part);
+        return NULL;
+    }
+
+    return part;
+}
+
+/// @brief Destroy the partitioned hash table and every partition.
+void htable_part_destroy (htable_part_t *part) {
+
+    if (part == NULL) {
+        return;
+    }
+
+    for (size_t p = 0; part->tables != NULL && p < part->partitions; p++) {
+        htable_destroy(part->tables[p]);
+    }
+
+    free(part->tables);
+    free(part);
+}
+
+/// @brief Retrieve the value of a key.
+void *htable_part_get (htable_part_t *part, const void *key) {
+
+    if (part == NULL) {
+        return NULL;
+    }
+
+    htable_t *table = part->tables[0];
+    const unsigned long hash = htable_hash_key(table, key);
+
+    return htable_get_hashed(part->tables[htable_part_index(hash, part->bits)], key, hash);
+}
+
+/// @brief Probe a column of keys whose hashes are already known.
+size_t htable_part_probe_batch (htable_part_t *part, const void *const *keys, const unsigned long *hashes, size_t n, size_t *sel, void **values) {
+
+    if (part == NULL || keys == NULL || hashes == NULL || sel == NULL) {
+        return 0;
+    }
+
+    if (part->bits == 0) {
+        return htable_probe_batch(part->tables[0], keys, hashes, n, sel, values);
+    }
+
+    const size_t len = n > 0 ? n : 1U;
+    unsigned long *part_hashes = malloc(len * sizeof(*part_hashes));
+    const void **part_keys = malloc(len * sizeof(*part_keys));
+    void **part_values = malloc(len * sizeof(*part_values));
+    void **found = calloc(len, sizeof(*found));
+    size_t *order = malloc(len * sizeof(*order));
+    size_t *part_sel = malloc(len * sizeof(*part_sel));
+    size_t *ends = malloc(part->partitions * sizeof(*ends));
+    const int scattered = part_hashes != NULL && part_keys != NULL && part_values != NULL && found != NULL && order != NULL && part_sel != NULL && ends != NULL;
+
+    if (scattered) {
+
+        partition_keys(hashes, n, part->bits, ends, order);
+
+        for (size_t pos = 0; pos < n; pos++) {
+            part_keys[pos] = keys[order[pos]];
+            part_hashes[pos] = hashes[order[pos]];
+        }
+
+        // One partition at a time, its table stays in cache for every probe of the batch that lands in it.
+        for (size_t p = 0, begin = 0; p < part->partitions; begin = ends[p++]) {
+
+            const size_t matches = htable_probe_batch(part->tables[p], &part_keys[begin], &part_hashes[begin], ends[p] - begin, &part_sel[begin], &part_values[begin]);
+
+            for (size_t idx = 0; idx < matches; idx++) {
+                found[order[begin + part_sel[begin + idx]]] = part_values[begin + idx];
+            }
+        }
+    }
+
+    size_t matched = 0;
+
+    // Back to input order, written unconditionally and advanced on a match like htable_probe_batch. Without
+    // scratch space the keys are probed right here, in input order.
+    for (size_t idx = 0; idx < n; idx++) {
+
+        void *value = scattered ? found[idx] : htable_get_hashed(part->tables[htable_part_index(hashes[idx], part->bits)], keys[idx], hashes[idx]);
+
+        sel[matched] = idx;
+
+        if (values != NULL) {
+            values[matched] = value;
+        }
+
+        matched += value != NULL;
+    }
+
+    free(part_hashes);
+    free(part_keys);
+    free(part_values);
+    free(found);
+    free(order);
+    free(part_sel);
+    free(ends);
+
+    return matched;
+}
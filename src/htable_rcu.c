@@ -0,0 +1,617 @@
+// ==============================================================================
+//                         Read-Copy-Update Hash table
+// ==============================================================================
+//
+// Description: Chained hash table with wait-free readers and epoch-based
+// reclamation. Every node a reader may reach is immutable apart from its next
+// pointer, which is only changed with release stores, so a reader walking a
+// chain always sees a consistent list. Writers serialize on a mutex, copy
+// instead of modifying published nodes, and retire unlinked memory tagged with
+// the current epoch. A retired object is freed once the global epoch has
+// advanced twice past it, which requires every active reader to have announced a
+// newer epoch in between.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "htable_rcu.h"
+#include "htable_internal.h"
+
+#include <pthread.h>    // For the writer mutex, e.g. pthread_mutex_lock(3).
+#include <sched.h>      // For sched_yield(2).
+#include <stdatomic.h>  // For atomic loads, stores and fences.
+
+// --- Macros --- //
+
+#define CACHE_LINE 64U      // Reader registrations are padded to a cache line to avoid false sharing.
+
+// --- Structures --- //
+
+/// @brief Kind of memory handed to the epoch-based reclamation.
+enum rcu_retire_kind {
+    RETIRE_NODE,        // A hash node copied elsewhere, its key and value are still in use.
+    RETIRE_VALUE,       // A hash node whose value was replaced, its key moved to the replacement.
+    RETIRE_ENTRY,       // A removed hash node, including its key and value.
+    RETIRE_BUCKETS,     // A bucket array replaced by a resize.
+};
+
+/// @brief Header of every retired object, placed first so it can be cast back.
+struct rcu_retire {
+    struct rcu_retire *next;        // The next retired object.
+    unsigned long epoch;            // The global epoch at the time the object was unlinked.
+    enum rcu_retire_kind kind;      // The kind of the retired object.
+};
+
+/// @brief Hash node of a read-copy-update hash table.
+struct rcu_node {
+    struct rcu_retire retire;           // The reclamation header, unused while the node is published.
+    void *key;                          // The key for the hash node.
+    void *value;                        // The value for the hash node.
+    unsigned long hash;                 // The full hash value of the key.
+    _Atomic(struct rcu_node *) next;    // The next hash node in the linked list.
+};
+
+/// @brief Bucket array of a read-copy-update hash table.
+struct rcu_buckets {
+    struct rcu_retire retire;               // The reclamation header, unused while the array is published.
+    size_t size;                            // The number of buckets.
+    _Atomic(struct rcu_node *) heads[];     // The first hash node of every bucket.
+};
+
+/// @brief Reader registration structure.
+struct htable_rcu_reader {
+    _Alignas(CACHE_LINE) _Atomic unsigned long active; // The epoch announced by the reader, 0 while quiescent.
+    unsigned int nesting;                   // The depth of nested read-side critical sections.
+    htable_rcu_t *table;                    // The hash table the reader is registered with.
+    htable_rcu_reader_t *next;              // The next registered reader.
+};
+
+/// @brief Read-copy-update hash table structure.
+struct htable_rcu {
+    _Atomic(struct rcu_buckets *) buckets;  // The published bucket array.
+    _Atomic unsigned long epoch;            // The global epoch, only advanced by writers.
+    pthread_mutex_t lock;                   // The mutex serializing writers and reader registration.
+    htable_rcu_reader_t *readers;           // The registered readers.
+    struct rcu_retire *retired;             // The retired objects, newest first.
+    size_t nretired;                        // The number of retired objects.
+    size_t count;                           // The number of elements in the hash table.
+    float max_load;                         // The maximum load factor before the table grows.
+    htable_t config;                        // Hash functions, callbacks and flags shared with htable_t.
+};
+
+// --- Static Function Definitions --- //
+
+static void *rcu_default_copy (const void *src) {
+    return (void *) src;
+}
+
+static void rcu_default_free (void *src) {
+    (void) src;
+}
+
+/// @brief Allocate an empty bucket array.
+static struct rcu_buckets *alloc_buckets (size_t size) {
+
+    struct rcu_buckets *buckets = NULL;
+
+    if ((buckets = calloc(1U, sizeof(*buckets) + size * sizeof(buckets->heads[0]))) == NULL) {
+        return NULL;
+    }
+
+    buckets->size = size;
+
+    for (size_t idx = 0; idx < size; idx++) {
+        atomic_init(&buckets->heads[idx], NULL);
+    }
+
+    return buckets;
+}
+
+/// @brief Free a retired object according to its kind.
+static void free_retired (const htable_rcu_t *table, struct rcu_retire *retired) {
+
+    if (retired->kind == RETIRE_BUCKETS) {
+        free(retired);
+        return;
+    }
+
+    struct rcu_node *node = (struct rcu_node *) retired;
+
+    if (retired->kind == RETIRE_ENTRY) {
+        table->config.cbs.kfree(node->key);
+    }
+
+    if (retired->kind != RETIRE_NODE) {
+        table->config.cbs.vfree(node->value);
+    }
+
+    free(node);
+}
+
+/// @brief Advance the global epoch if every active reader has observed the current one.
+/// @param table The hash table, with the writer mutex held.
+/// @return 1 if the epoch was advanced, 0 otherwise.
+static int try_advance (htable_rcu_t *table) {
+
+    // Order the unlinking stores before reading the reader announcements.
+    atomic_thread_fence(memory_order_seq_cst);
+
+    const unsigned long epoch = atomic_load_explicit(&table->epoch, memory_order_relaxed);
+
+    for (const htable_rcu_reader_t *reader = table->readers; reader != NULL; reader = reader->next) {
+
+        const unsigned long active = atomic_load_explicit(&reader->active, memory_order_acquire);
+
+        if (active != 0 && active != epoch) {
+            return 0;
+        }
+    }
+
+    // Writers are serialized, so a plain store is enough to advance the epoch.
+    atomic_store_explicit(&table->epoch, epoch + 1U, memory_order_release);
+
+    return 1;
+}
+
+/// @brief Free every retired object no reader can reach anymore.
+/// @param table The hash table, with the writer mutex held.
+static void reclaim (htable_rcu_t *table) {
+
+    (void) try_advance(table);
+
+    const unsigned long epoch = atomic_load_explicit(&table->epoch, memory_order_relaxed);
+
+    struct rcu_retire **link = &table->retired;
+
+    // Readers that could still see an object retired in epoch e have all left once the epoch reaches e + 2.
+    while (*link != NULL) {
+
+        struct rcu_retire *retired = *link;
+
+        if (retired->epoch + 2U <= epoch) {
+            *link = retired->next;
+            free_retired(table, retired);
+            table->nretired--;
+        } else {
+            link = &retired->next;
+        }
+    }
+}
+
+/// @brief Hand an unlinked object to the epoch-based reclamation.
+/// @param table The hash table, with the writer mutex held.
+/// @param retired The reclamation header of the object.
+/// @param kind The kind of the object.
+static void retire (htable_rcu_t *table, struct rcu_retire *retired, enum rcu_retire_kind kind) {
+
+    retired->kind = kind;
+    retired->epoch = atomic_load_explicit(&table->epoch, memory_order_relaxed);
+    retired->next = table->retired;
+
+    table->retired = retired;
+
+    if (++table->nretired >= HTABLE_RCU_RECLAIM) {
+        reclaim(table);
+    }
+}
+
+/// @brief Publish a copy of every hash node in a bucket array of twice the size.
+/// @param table The hash table, with the writer mutex held.
+static void grow (htable_rcu_t *table) {
+
+    struct rcu_buckets *old = atomic_load_explicit(&table->buckets, memory_order_relaxed);
+    struct rcu_buckets *buckets = NULL;
+
+    // Growing is best effort, the table keeps working at a higher load on failure.
+    if ((buckets = alloc_buckets(old->size * 2U)) == NULL) {
+        return;
+    }
+
+    // Readers may be walking the old chains, so nodes are copied instead of relinked.
+    for (size_t idx = 0; idx < old->size; idx++) {
+
+        struct rcu_node *current = atomic_load_explicit(&old->heads[idx], memory_order_relaxed);
+
+        for (; current != NULL; current = atomic_load_explicit(&current->next, memory_order_relaxed)) {
+
+            struct rcu_node *copy = NULL;
+
+            if ((copy = malloc(sizeof(*copy))) == NULL) {
+                goto abort;
+            }
+
+            const size_t dst = current->hash % buckets->size;
+
+            copy->key = current->key;
+            copy->value = current->value;
+            copy->hash = current->hash;
+            atomic_init(&copy->next, atomic_load_explicit(&buckets->heads[dst], memory_order_relaxed));
+            atomic_store_explicit(&buckets->heads[dst], copy, memory_order_relaxed);
+        }
+    }
+
+    // Publish the new bucket array, its nodes become visible together with it.
+    atomic_store_explicit(&table->buckets, buckets, memory_order_release);
+
+    for (size_t idx = 0; idx < old->size; idx++) {
+
+        struct rcu_node *current = atomic_load_explicit(&old->heads[idx], memory_order_relaxed);
+
+        while (current != NULL) {
+            struct rcu_node *next = atomic_load_explicit(&current->next, memory_order_relaxed);
+            retire(table, &current->retire, RETIRE_NODE);
+            current = next;
+        }
+    }
+
+    retire(table, &old->retire, RETIRE_BUCKETS);
+
+    return;
+
+abort:
+    // Nothing was published, the partial copies can be freed right away.
+    for (size_t idx = 0; idx < buckets->size; idx++) {
+
+        struct rcu_node *current = atomic_load_explicit(&buckets->heads[idx], memory_order_relaxed);
+
+        while (current != NULL) {
+            struct rcu_node *next = atomic_load_explicit(&current->next, memory_order_relaxed);
+            free(current);
+            current = next;
+        }
+    }
+
+    free(buckets);
+}
+
+/// @brief Locate the link referencing the hash node that holds the key.
+/// @param table The hash table, with the writer mutex held.
+/// @param buckets The bucket array to search.
+/// @param key The key for the hash node.
+/// @param hash The hash value of the key.
+/// @return Pointer to the bucket or next pointer referencing the node, NULL if the key is not present.
+static _Atomic(struct rcu_node *) *find_link (const htable_rcu_t *table, struct rcu_buckets *buckets, const void *key, unsigned long hash) {
+
+    _Atomic(struct rcu_node *) *link = &buckets->heads[hash % buckets->size];
+
+    for (;;) {
+
+        struct rcu_node *current = atomic_load_explicit(link, memory_order_relaxed);
+
+        if (current == NULL) {
+            return NULL;
+        }
+
+        if (current->hash == hash && table->config.keq(current->key, key)) {
+            return link;
+        }
+
+        link = &current->next;
+    }
+}
+
+// --- Function Definitions --- //
+
+/// @brief Create a read-copy-update hash table.
+htable_rcu_t *htable_rcu_create (size_t size, htable_hash_t hash, htable_keq_t keq, const struct callbacks *cbs, const struct htable_opts *opts) {
+
+    if (size == 0 || hash == NULL || keq == NULL) {
+        return NULL;
+    }
+
+    if (opts != NULL && opts->max_load < 0.0f) {
+        return NULL;
+    }
+
+    htable_rcu_t *table = NULL;
+
+    if ((table = calloc(1U, sizeof(*table))) == NULL) {
+        return NULL;
+    }
+
+    struct rcu_buckets *buckets = NULL;
+
+    if ((buckets = alloc_buckets(size)) == NULL || pthread_mutex_init(&table->lock, NULL) != 0) {
+        free(buckets);
+        free(table);
+        return NULL;
+    }
+
+    atomic_init(&table->buckets, buckets);
+    atomic_init(&table->epoch, 1U);
+
+    table->max_load = opts != NULL && opts->max_load > 0.0f ? opts->max_load : HTABLE_DEFAULT_MAX_LOAD;
+
+    // Only the fields shared with htable_hash_key and the callbacks are used.
+    table->config.hash = hash;
+    table->config.keq = keq;
+    table->config.flags = opts != NULL ? opts->flags : 0U;
+
+    table->config.cbs.kcpy = cbs != NULL && cbs->kcpy ? cbs->kcpy : rcu_default_copy;
+    table->config.cbs.vcpy = cbs != NULL && cbs->vcpy ? cbs->vcpy : rcu_default_copy;
+    table->config.cbs.kfree = cbs != NULL && cbs->kfree ? cbs->kfree : rcu_default_free;
+    table->config.cbs.vfree = cbs != NULL && cbs->vfree ? cbs->vfree : rcu_default_free;
+
+    return table;
+}
+
+/// @brief Destroy the hash table and free resources, every reader must have been unregistered.
+void htable_rcu_destroy (htable_rcu_t *table) {
+
+    if (table == NULL) {
+        return;
+    }
+
+    // No reader is left, so every retired object can be freed right away.
+    while (table->retired != NULL) {
+        struct rcu_retire *next = table->retired->next;
+        free_retired(table, table->retired);
+        table->retired = next;
+    }
+
+    struct rcu_buckets *buckets = atomic_load_explicit(&table->buckets, memory_order_relaxed);
+
+    for (size_t idx = 0; idx < buckets->size; idx++) {
+
+        struct rcu_node *current = atomic_load_explicit(&buckets->heads[idx], memory_order_relaxed);
+
+        while (current != NULL) {
+            struct rcu_node *next = atomic_load_explicit(&current->next, memory_order_relaxed);
+            current->retire.kind = RETIRE_ENTRY;
+            free_retired(table, &current->retire);
+            current = next;
+        }
+    }
+
+    free(buckets);
+
+    // Readers that were never unregistered.
+    while (table->readers != NULL) {
+        htable_rcu_reader_t *next = table->readers->next;
+        free(table->readers);
+        table->readers = next;
+    }
+
+    (void) pthread_mutex_destroy(&table->lock);
+    free(table);
+}
+
+/// @brief Register the calling thread as a reader, once per thread.
+htable_rcu_reader_t *htable_rcu_register (htable_rcu_t *table) {
+
+    if (table == NULL) {
+        return NULL;
+    }
+
+    htable_rcu_reader_t *reader = NULL;
+
+    if ((reader = aligned_alloc(CACHE_LINE, sizeof(*reader))) == NULL) {
+        return NULL;
+    }
+
+    atomic_init(&reader->active, 0U);
+    reader->nesting = 0;
+    reader->table = table;
+
+    (void) pthread_mutex_lock(&table->lock);
+
+    reader->next = table->readers;
+    table->readers = reader;
+
+    (void) pthread_mutex_unlock(&table->lock);
+
+    return reader;
+}
+
+/// @brief Unregister a reader, which must not be inside a read-side critical section.
+void htable_rcu_unregister (htable_rcu_reader_t *reader) {
+
+    if (reader == NULL) {
+        return;
+    }
+
+    htable_rcu_t *table = reader->table;
+
+    (void) pthread_mutex_lock(&table->lock);
+
+    htable_rcu_reader_t **link = &table->readers;
+
+    while (*link != reader) {
+        link = &(*link)->next;
+    }
+
+    *link = reader->next;
+
+    (void) pthread_mutex_unlock(&table->lock);
+
+    free(reader);
+}
+
+/// @brief Enter a read-side critical section, critical sections may be nested.
+void htable_rcu_read_lock (htable_rcu_reader_t *reader) {
+
+    if (reader->nesting++ != 0) {
+        return;
+    }
+
+    // Announce the epoch with a plain store, the fence orders it before every load of the critical section.
+    atomic_store_explicit(&reader->active, atomic_load_explicit(&reader->table->epoch, memory_order_relaxed), memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+/// @brief Leave a read-side critical section.
+void htable_rcu_read_unlock (htable_rcu_reader_t *reader) {
+
+    if (--reader->nesting != 0) {
+        return;
+    }
+
+    atomic_store_explicit(&reader->active, 0U, memory_order_release);
+}
+
+/// @brief Retrieve a value without locking, the caller must be inside a read-side critical section.
+void *htable_rcu_get (htable_rcu_t *table, const void *key) {
+
+    if (table == NULL) {
+        return NULL;
+    }
+
+    const unsigned long hash = htable_hash_key(&table->config, key);
+    const struct rcu_buckets *buckets = atomic_load_explicit(&table->buckets, memory_order_acquire);
+
+    struct rcu_node *current = atomic_load_explicit(&buckets->heads[hash % buckets->size], memory_order_acquire);
+
+    // Traverse the linked list, bounded by its length at the time of the loads.
+    for (; current != NULL; current = atomic_load_explicit(&current->next, memory_order_acquire)) {
+        if (current->hash == hash && table->config.keq(current->key, key)) {
+            return current->value;
+        }
+    }
+
+    return NULL;
+}
+
+/// @brief Insert or replace a key-value pair, replaced values are freed once no reader can see them.
+int htable_rcu_insert (htable_rcu_t *table, const void *key, const void *value) {
+
+    if (table == NULL || value == NULL) {
+        return -1;
+    }
+
+    const unsigned long hash = htable_hash_key(&table->config, key);
+
+    struct rcu_node *new_node = NULL;
+
+    if ((new_node = malloc(sizeof(*new_node))) == NULL) {
+        return -2;
+    }
+
+    new_node->value = table->config.cbs.vcpy(value);
+    new_node->hash = hash;
+
+    (void) pthread_mutex_lock(&table->lock);
+
+    struct rcu_buckets *buckets = atomic_load_explicit(&table->buckets, memory_order_relaxed);
+    _Atomic(struct rcu_node *) *link = find_link(table, buckets, key, hash);
+
+    if (link != NULL) {
+        // Replace the whole hash node, readers may still be reading the old value.
+        struct rcu_node *old = atomic_load_explicit(link, memory_order_relaxed);
+
+        new_node->key = old->key;
+        atomic_init(&new_node->next, atomic_load_explicit(&old->next, memory_order_relaxed));
+        atomic_store_explicit(link, new_node, memory_order_release);
+
+        retire(table, &old->retire, RETIRE_VALUE);
+    } else {
+        _Atomic(struct rcu_node *) *head = &buckets->heads[hash % buckets->size];
+
+        new_node->key = table->config.cbs.kcpy(key);
+        atomic_init(&new_node->next, atomic_load_explicit(head, memory_order_relaxed));
+        atomic_store_explicit(head, new_node, memory_order_release);
+
+        table->count++;
+
+        if (!(table->config.flags & HTABLE_FIXED_SIZE) && (float) table->count > table->max_load * (float) buckets->size) {
+            grow(table);
+        }
+    }
+
+    (void) pthread_mutex_unlock(&table->lock);
+
+    return 0;
+}
+
+/// @brief Remove a key-value pair, the key and value are freed once no reader can see them.
+int htable_rcu_remove (htable_rcu_t *table, const void *key) {
+
+    if (table == NULL) {
+        return -1;
+    }
+
+    const unsigned long hash = htable_hash_key(&table->config, key);
+
+    (void) pthread_mutex_lock(&table->lock);
+
+    struct rcu_buckets *buckets = atomic_load_explicit(&table->buckets, memory_order_relaxed);
+    _Atomic(struct rcu_node *) *link = find_link(table, buckets, key, hash);
+
+    if (link == NULL) {
+        (void) pthread_mutex_unlock(&table->lock);
+        return -1;
+    }
+
+    struct rcu_node *current = atomic_load_explicit(link, memory_order_relaxed);
+
+    // Unlink the hash node, readers already on it still find its successor.
+    atomic_store_explicit(link, atomic_load_explicit(&current->next, memory_order_relaxed), memory_order_release);
+
+    retire(table, &current->retire, RETIRE_ENTRY);
+    table->count--;
+
+    (void) pthread_mutex_unlock(&table->lock);
+
+    return 0;
+}
+
+/// @brief Wait until everything retired so far has been freed.
+void htable_rcu_synchronize (htable_rcu_t *table) {
+
+    if (table == NULL) {
+        return;
+    }
+
+    (void) pthread_mutex_lock(&table->lock);
+
+    while (table->retired != NULL) {
+
+        reclaim(table);
+
+        // Give readers still in an older epoch the chance to leave their critical section.
+        if (table->retired != NULL) {
+            (void) pthread_mutex_unlock(&table->lock);
+            (void) sched_yield();
+            (void) pthread_mutex_lock(&table->lock);
+        }
+    }
+
+    (void) pthread_mutex_unlock(&table->lock);
+}
+
+/// @brief Number of elements in the hash table.
+size_t htable_rcu_count (htable_rcu_t *table) {
+
+    if (table == NULL) {
+        return 0;
+    }
+
+    (void) pthread_mutex_lock(&table->lock);
+
+    const size_t count = table->count;
+
+    (void) pthread_mutex_unlock(&table->lock);
+
+    return count;
+}
@@ -0,0 +1,239 @@
+// ==============================================================================
+//                             Hash table capacity
+// ==============================================================================
+//
+// Description: Explicit capacity control on top of the automatic growth.
+// Reserving and shrinking only multiply or divide the bucket count by powers of
+// two, like growth does, so htable_scan cursors stay valid, and both reuse the
+// incremental migration of the chaining engine. Rehashing with a new hash
+// function rewrites the stored hashes and then migrates every bucket at once,
+// which is also how a seeded table draws a new seed.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "htable_internal.h"
+
+#include <fcntl.h>      // For opening the random device, e.g. open(2).
+#include <time.h>       // For the fallback seed, e.g. clock_gettime(2).
+#include <unistd.h>     // For reading the random device, e.g. read(2).
+
+// --- Static Function Definitions --- //
+
+/// @brief Finish the migration of the chaining engine in progress, if any.
+static void finish_migration (htable_t *table) {
+    while (table->rehash_table != NULL) {
+        htable_rehash_step(table, table->rehash_size);
+    }
+}
+
+/// @brief Check whether a number of entries fits a number of buckets or slots under the maximum load factor.
+static int fits (const htable_t *table, size_t count, size_t size) {
+    return (float) count <= table->max_load * (float) size;
+}
+
+/// @brief Resize a hash table stored in slots, see htable_robin_resize, htable_swiss_resize and htable_compact_resize.
+static int resize_slots (htable_t *table, size_t size) {
+    switch (table->engine) {
+        case HTABLE_ENGINE_SWISS:
+            return htable_swiss_resize(table, size);
+        case HTABLE_ENGINE_COMPACT:
+            return htable_compact_resize(table, size);
+        default:
+            return htable_robin_resize(table, size);
+    }
+}
+
+/// @brief Set the hash functions and the seed of a table at once.
+static void set_hashing (htable_t *table, htable_hash_t hash, htable_seeded_hash_t seeded_hash, unsigned long long seed) {
+    table->hash = hash;
+    table->seeded_hash = seeded_hash;
+    table->seed = seed;
+}
+
+/// @brief Rehash every key with a new hashing setup, restoring the previous one on failure.
+/// @return 0 on success, -2 on memory allocation failure.
+static int rehash (htable_t *table, htable_hash_t hash, htable_seeded_hash_t seeded_hash, unsigned long long seed) {
+
+    // A migration in progress hashes with the setup about to be replaced, so it has to finish first.
+    finish_migration(table);
+
+    const htable_hash_t previous = table->hash;
+    const htable_seeded_hash_t previous_seeded = table->seeded_hash;
+    const unsigned long long previous_seed = table->seed;
+
+    set_hashing(table, hash, seeded_hash, seed);
+
+    // Rewrite the stored hashes in place, then let a rebuild of the same size move every entry.
+    if (table->engine != HTABLE_ENGINE_CHAIN) {
+
+        HTABLE_STAT_CLOCK(start);
+
+        for (size_t idx = 0; idx < table->size; idx++) {
+            if (htable_slot_used(table, idx)) {
+                table->slots[idx].hash = htable_hash_key(table, table->slots[idx].key);
+            }
+        }
+
+        HTABLE_STAT_ELAPSED(table, start);
+
+        if (resize_slots(table, table->size) != 0) {
+            // The slot array still has the previous layout, so the previous hashes have to come back.
+            set_hashing(table, previous, previous_seeded, previous_seed);
+
+            for (size_t idx = 0; idx < table->size; idx++) {
+                if (htable_slot_used(table, idx)) {
+                    table->slots[idx].hash = htable_hash_key(table, table->slots[idx].key);
+                }
+            }
+
+            return -2;
+        }
+
+        return 0;
+    }
+
+    if (htable_chain_resize(table, table->size) != 0) {
+        set_hashing(table, previous, previous_seeded, previous_seed);
+        return -2;
+    }
+
+    // The migration steps rehash every hash node they move, lookups probe the previous array the previous way.
+    table->rehash_rekey = 1;
+    table->rehash_hash = previous;
+    table->rehash_seeded_hash = previous_seeded;
+    table->rehash_seed = previous_seed;
+
+    return 0;
+}
+
+// --- Function Definitions --- //
+
+/// @brief Grow the hash table ahead of time so that it holds n entries without resizing.
+int htable_reserve (htable_t *table, size_t n) {
+
+    if (table == NULL || (table->table == NULL && table->slots == NULL)) {
+        return -1;
+    }
+
+    size_t size = table->size;
+
+    // Double like the automatic growth, which also keeps the bucket count of the form base * 2^k.
+    while (!fits(table, n, size)) {
+        if (size > SIZE_MAX / 2U) {
+            return -2;
+        }
+
+        size *= 2U;
+    }
+
+    if (table->engine != HTABLE_ENGINE_CHAIN) {
+        return size != table->size ? resize_slots(table, size) : 0;
+    }
+
+    if (size != table->size && htable_chain_resize(table, size) != 0) {
+        return -2;
+    }
+
+    // Pay for the whole migration now rather than during the burst the reservation is made for.
+    finish_migration(table);
+
+    return 0;
+}
+
+/// @brief Shrink the bucket or slot array to the smallest size that holds the current entries.
+int htable_shrink_to_fit (htable_t *table) {
+
+    if (table == NULL || (table->table == NULL && table->slots == NULL)) {
+        return -1;
+    }
+
+    size_t size = table->size;
+
+    // Halve while the entries still fit, odd bucket counts are the base of the chaining engine and stay.
+    while ((size & 1U) == 0 && size > 1U && fits(table, table->count, size / 2U)) {
+        size /= 2U;
+    }
+
+    if (size == table->size) {
+        return 0;
+    }
+
+    // The open-addressing engines round the size back up to their minimum and keep a free slot.
+    if (table->engine != HTABLE_ENGINE_CHAIN) {
+        return resize_slots(table, size);
+    }
+
+    // The remaining hash nodes move over incrementally, the large array is freed once they have.
+    return htable_chain_resize(table, size);
+}
+
+/// @brief Draw a random, non-zero hash seed.
+unsigned long long htable_seed_random (void) {
+
+    unsigned long long seed = 0;
+    const int fd = open("/dev/urandom", O_RDONLY);
+
+    if (fd >= 0) {
+        if (read(fd, &seed, sizeof(seed)) != (ssize_t) sizeof(seed)) {
+            seed = 0;
+        }
+
+        (void) close(fd);
+    }
+
+    // Without a random device the clock and the stack address are the best guess an attacker has to make.
+    if (seed == 0) {
+        struct timespec ts;
+        (void) clock_gettime(CLOCK_REALTIME, &ts);
+        seed = htable_fmix64((uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec) ^ (uintptr_t) &ts;
+    }
+
+    return seed != 0 ? seed : 1U;
+}
+
+/// @brief Replace the hash function and rehash every key.
+int htable_rehash (htable_t *table, htable_hash_t hash) {
+
+    if (table == NULL || (table->table == NULL && table->slots == NULL) || hash == NULL) {
+        return -1;
+    }
+
+    return rehash(table, hash, NULL, 0);
+}
+
+/// @brief Draw a new seed and rehash every key with it.
+int htable_reseed (htable_t *table) {
+
+    if (table == NULL || (table->table == NULL && table->slots == NULL) || table->seeded_hash == NULL) {
+        return -1;
+    }
+
+    // Whatever the outcome, chains are not checked again until the table grows.
+    table->reseed_pending = 0;
+    table->reseed_size = table->size;
+
+    return rehash(table, table->hash, table->seeded_hash, htable_seed_random());
+}
@@ -0,0 +1,314 @@
+// ==============================================================================
+//                              Robin Hood Engine
+// ==============================================================================
+//
+// Description: Open-addressing storage engine for the generic hash table.
+// Entries are kept inline in a power-of-two slot array and collisions are
+// resolved by linear probing with Robin Hood displacement, so probe sequences
+// stay short and lookups for missing keys stop early. Removal uses backward-
+// shift deletion, which keeps the array free of tombstones.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#include "htable_internal.h"
+
+// --- Static Function Definitions --- //
+
+/// @brief Round the requested size up to the next power of two.
+/// @param size The requested number of slots.
+/// @return The number of slots to allocate.
+static size_t round_capacity (size_t size) {
+
+    size_t capacity = 8U;
+
+    while (capacity < size) {
+        capacity <<= 1U;
+    }
+
+    return capacity;
+}
+
+/// @brief Find the slot holding the key.
+/// @param table The hash table to search.
+/// @param key The key for the slot.
+/// @param hash The hash value of the key.
+/// @return Index of the slot, or the number of slots if the key is not present.
+static size_t find_slot (const htable_t *table, const void *key, unsigned long hash) {
+
+    const size_t mask = table->size - 1U;
+
+    size_t idx = hash & mask;
+    unsigned int dist = 1U;
+    size_t keqs = 0;
+
+    // An entry closer to its home slot than the probe means the key cannot be further along.
+    for (; table->slots[idx].dist >= dist; idx = (idx + 1U) & mask, dist++) {
+
+        const struct htable_slot *slot = &table->slots[idx];
+
+        if (slot->hash != hash) {
+            continue;
+        }
+
+        keqs++;
+
+        if (table->keq(slot->key, key)) {
+            HTABLE_CLOCK_REF(table, &table->slots[idx]);
+            HTABLE_STAT_SEARCH(table, dist, keqs);
+            return idx;
+        }
+    }
+
+    HTABLE_STAT_SEARCH(table, dist - 1U, keqs);
+
+    return table->size;
+}
+
+/// @brief Place an entry that is known to be absent, displacing richer entries along the way.
+/// @param slots The slot array to place the entry into.
+/// @param mask The number of slots minus one.
+/// @param entry The entry to place, its distance is overwritten.
+/// @return Index of the slot the entry ended up in.
+static size_t place_slot (struct htable_slot *slots, size_t mask, struct htable_slot entry) {
+
+    size_t idx = entry.hash & mask;
+    size_t placed = SIZE_MAX;
+    entry.dist = 1U;
+
+    while (slots[idx].dist != 0) {
+
+        // Robin Hood: the entry further from its home slot takes the position.
+        if (slots[idx].dist < entry.dist) {
+            const struct htable_slot displaced = slots[idx];
+            slots[idx] = entry;
+            entry = displaced;
+
+            // Only the first swap places the original entry, later ones move displaced entries.
+            placed = placed == SIZE_MAX ? idx : placed;
+        }
+
+        idx = (idx + 1U) & mask;
+        entry.dist++;
+    }
+
+    slots[idx] = entry;
+
+    return placed == SIZE_MAX ? idx : placed;
+}
+
+/// @brief Move every entry into a slot array of the given size.
+/// @param table The hash table to resize.
+/// @param size The new number of slots, a power of two.
+/// @return 0 on success, -2 on memory allocation failure.
+static int resize (htable_t *table, size_t size) {
+
+    struct htable_slot *slots = NULL;
+
+    HTABLE_STAT_RESIZE(table);
+    HTABLE_STAT_CLOCK(start);
+
+    if ((slots = calloc(size, sizeof(*slots))) == NULL) {
+        return -2;
+    }
+
+    // Reuse the stored hashes, the user hash function is not called again.
+    for (size_t idx = 0; idx < table->size; idx++) {
+        if (table->slots[idx].dist != 0) {
+            (void) place_slot(slots, size - 1U, table->slots[idx]);
+        }
+    }
+
+    free(table->slots);
+
+    table->slots = slots;
+    table->size = size;
+
+    HTABLE_STAT_ELAPSED(table, start);
+
+    return 0;
+}
+
+// --- Function Definitions --- //
+
+/// @brief Allocate the slot array of a Robin Hood hash table.
+int htable_robin_init (htable_t *table, size_t size) {
+
+    table->size = round_capacity(size);
+
+    if ((table->slots = calloc(table->size, sizeof(*table->slots))) == NULL) {
+        return -2;
+    }
+
+    return 0;
+}
+
+/// @brief Free every entry and the slot array of a Robin Hood hash table.
+void htable_robin_destroy (htable_t *table) {
+
+    for (size_t idx = 0; idx < table->size; idx++) {
+
+        struct htable_slot *slot = &table->slots[idx];
+
+        if (slot->dist != 0) {
+            table->cbs.kfree(slot->key);
+            table->cbs.vfree(slot->value);
+        }
+    }
+
+    free(table->slots);
+}
+
+/// @brief Find the value slot of a key in a Robin Hood hash table, claiming a slot if it is absent.
+void **htable_robin_upsert (htable_t *table, const void *key, unsigned long hash, int owned, int *inserted) {
+
+    const size_t found = find_slot(table, key, hash);
+
+    if (found != table->size) {
+        *inserted = 0;
+        return &table->slots[found].value;
+    }
+
+    // A full capacity-bounded table makes room before a slot is claimed, the freed slot keeps the claim from failing.
+    if (table->capacity > 0 && table->count >= table->capacity) {
+        htable_evict(table);
+    }
+
+    // Grow before the insertion would exceed the maximum load factor.
+    if ((float) (table->count + 1U) > table->max_load * (float) table->size && !(table->flags & HTABLE_FIXED_SIZE)) {
+        // Growing is best effort while there is still a free slot.
+        if (resize(table, table->size * 2U) != 0 && table->count + 1U >= table->size) {
+            return NULL;
+        }
+    }
+
+    // Always keep one free slot so probe loops terminate.
+    if (table->count + 1U >= table->size) {
+        return NULL;
+    }
+
+    const struct htable_slot entry = {
+        .key = owned ? (void *) key : table->cbs.kcpy(key),
+        .value = NULL,
+        .hash = hash,
+    };
+
+    const size_t idx = place_slot(table->slots, table->size - 1U, entry);
+    table->count++;
+
+    *inserted = 1;
+
+    return &table->slots[idx].value;
+}
+
+/// @brief Move every entry of a Robin Hood hash table into a slot array of at least the given size.
+int htable_robin_resize (htable_t *table, size_t size) {
+
+    size_t capacity = round_capacity(size);
+
+    // Always keep one free slot so probe loops terminate.
+    while (capacity <= table->count + 1U) {
+        capacity <<= 1U;
+    }
+
+    return resize(table, capacity);
+}
+
+/// @brief Insert a key-value pair into a Robin Hood hash table.
+int htable_robin_insert (htable_t *table, const void *key, const void *value, unsigned long hash) {
+
+    int inserted = 0;
+    void **slot = htable_robin_upsert(table, key, hash, 0, &inserted);
+
+    if (slot == NULL) {
+        return -2;
+    }
+
+    // Free the previous value and update it with the new value.
+    if (!inserted) {
+        table->cbs.vfree(*slot);
+    }
+
+    *slot = table->cbs.vcpy(value);
+
+    return 0;
+}
+
+/// @brief Unlink a key-value pair from a Robin Hood hash table without freeing it.
+int htable_robin_take (htable_t *table, const void *key, unsigned long hash, void **key_out, void **value_out) {
+
+    const size_t mask = table->size - 1U;
+    size_t idx = find_slot(table, key, hash);
+
+    if (idx == table->size) {
+        return -1;
+    }
+
+    // Hand the key and value over, the parts the caller does not want back are freed.
+    if (key_out != NULL) {
+        *key_out = table->slots[idx].key;
+    } else {
+        table->cbs.kfree(table->slots[idx].key);
+    }
+
+    if (value_out != NULL) {
+        *value_out = table->slots[idx].value;
+    } else {
+        table->cbs.vfree(table->slots[idx].value);
+    }
+
+    // Backward-shift deletion: pull displaced successors one slot closer to their home slot.
+    size_t next = (idx + 1U) & mask;
+
+    while (table->slots[next].dist > 1U) {
+        table->slots[idx] = table->slots[next];
+        table->slots[idx].dist--;
+
+        idx = next;
+        next = (next + 1U) & mask;
+    }
+
+    table->slots[idx].dist = 0;
+    table->count--;
+
+    return 0;
+}
+
+/// @brief Remove a key-value pair from a Robin Hood hash table.
+int htable_robin_remove (htable_t *table, const void *key, unsigned long hash) {
+    return htable_robin_take(table, key, hash, NULL, NULL);
+}
+
+/// @brief Retrieve a value from a Robin Hood hash table.
+void *htable_robin_get (const htable_t *table, const void *key, unsigned long hash) {
+
+    const size_t idx = find_slot(table, key, hash);
+
+    return idx != table->size ? table->slots[idx].value : NULL;
+}
+
+
+/// @brief Prefetch the home slot of a hash in a Robin Hood hash table.
+void htable_robin_prefetch (const htable_t *table, unsigned long hash) {
+    HTABLE_PREFETCH(&table->slots[hash & (table->size - 1U)]);
+}
\ No newline at end of file
@@ -0,0 +1,462 @@
+// ==============================================================================
+//                              Sharded Hash table
+// ==============================================================================
+//
+// Description: Implementation of the sharded front-end. NUMA nodes and their
+// CPUs are read from sysfs without depending on libnuma, and every shard is
+// created by a helper thread bound to its node, so the first-touch policy of the
+// kernel places the shard, its bucket array and the first chunk of its slab on
+// that node.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#define _GNU_SOURCE             // For CPU affinity, e.g. pthread_attr_setaffinity_np(3) and sched_setaffinity(2).
+
+#include "htable_shard.h"
+#include "htable_locked.h"
+
+#include <pthread.h>    // For the placement threads, e.g. pthread_create(3).
+#include <stdio.h>      // For reading sysfs, e.g. fopen(3).
+#include <unistd.h>     // For the page size, e.g. sysconf(3).
+
+#if defined(__linux__)
+    #include <sched.h>  // For CPU sets, e.g. CPU_SET(3).
+    #define SHARD_NUMA 1
+#endif
+
+// --- Structures --- //
+
+/// @brief Shard of a sharded hash table, allocated on its own so it can live on the memory of its node.
+struct shard {
+    struct htable_locked part;  // The locked hash table of the shard.
+    int node;                   // The NUMA node the shard was placed on, -1 if none.
+};
+
+/// @brief Sharded hash table structure.
+struct htable_shard {
+    struct shard **shards;      // The shards of the hash table.
+    struct htable_route route;  // The routing of keys to the shards.
+#if defined(SHARD_NUMA)
+    cpu_set_t *cpus;            // The CPUs of every NUMA node, indexed by node number.
+#endif
+};
+
+/// @brief Arguments of the creation of a shard, possibly on a thread bound to its node.
+struct shard_init {
+    size_t size;                        // The number of buckets of the shard.
+    htable_hash_t hash;                 // The hash function for the keys.
+    htable_keq_t keq;                   // The comparison function for the keys.
+    const struct callbacks *cbs;        // The callback functions.
+    const struct htable_opts *config;   // The configuration of the shard, as settled by htable_route_opts.
+    int node;                           // The node the shard is placed on, -1 if none.
+    struct shard *shard;                // The created shard, NULL on failure.
+};
+
+// --- Static Function Definitions --- //
+
+/// @brief Select the locked hash table of the shard of a hash value.
+static struct htable_locked *get_part (const htable_shard_t *table, unsigned long hash) {
+    return &table->shards[htable_route_part(&table->route, hash)]->part;
+}
+
+/// @brief Write one byte of every page of a memory range, so the pages are backed by the node of the caller.
+static void touch_pages (void *ptr, size_t bytes) {
+
+    const long page = sysconf(_SC_PAGESIZE);
+    volatile unsigned char *bytes_ptr = ptr;
+
+    for (size_t off = 0; ptr != NULL && page > 0 && off < bytes; off += (size_t) page) {
+        bytes_ptr[off] = 0;
+    }
+}
+
+/// @brief Create a shard, run by a thread bound to the node of the shard when it is placed.
+static void *create_shard (void *arg) {
+
+    struct shard_init *init = arg;
+    struct shard *shard = NULL;
+
+    if ((shard = aligned_alloc(HTABLE_CACHE_LINE, sizeof(*shard))) == NULL) {
+        return NULL;
+    }
+
+    // Every shard owns a slab for its hash nodes, unless the caller brings an allocator.
+    struct htable_opts opts = *init->config;
+    opts.flags |= opts.allocator == NULL ? HTABLE_SLAB : 0U;
+
+    shard->node = init->node;
+
+    if (htable_locked_init(&shard->part, init->size, init->hash, init->keq, init->cbs, &opts) != 0) {
+        free(shard);
+        return NULL;
+    }
+
+    // Fresh calloc(3) pages are only placed on a node once written, so write them here.
+    htable_t *ht = shard->part.table;
+
+    if (init->node >= 0) {
+        touch_pages(ht->table, ht->engine == HTABLE_ENGINE_CHAIN ? ht->size * sizeof(*ht->table) : 0U);
+        touch_pages(ht->slots, ht->engine != HTABLE_ENGINE_CHAIN ? ht->size * sizeof(*ht->slots) : 0U);
+        touch_pages(ht->ctrl, ht->engine == HTABLE_ENGINE_SWISS ? ht->size : 0U);
+        touch_pages(ht->heads, ht->engine == HTABLE_ENGINE_COMPACT ? ht->size * sizeof(*ht->heads) : 0U);
+
+        // Carve the first slab chunk here as well, the hash nodes inserted later come from it.
+        if (ht->slab != NULL && htable_slab_reserve(ht->slab, ht->slab->chunk_objs) == 0) {
+            touch_pages(ht->slab->bump, (size_t) (ht->slab->bump_end - ht->slab->bump));
+        }
+    }
+
+    init->shard = shard;
+
+    return NULL;
+}
+
+#if defined(SHARD_NUMA)
+
+/// @brief Parse a sysfs CPU list such as "0-3,8-11" into a CPU set.
+/// @return The number of CPUs in the set.
+static int parse_cpulist (FILE *file, cpu_set_t *cpus) {
+
+    unsigned long first = 0;
+    unsigned long last = 0;
+    int sep = 0;
+
+    CPU_ZERO(cpus);
+
+    while (fscanf(file, "%lu", &first) == 1) {
+
+        last = first;
+        sep = fgetc(file);
+
+        if (sep == '-' && fscanf(file, "%lu", &last) == 1) {
+            sep = fgetc(file);
+        }
+
+        for (unsigned long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, cpus);
+        }
+
+        if (sep != ',') {
+            break;
+        }
+    }
+
+    return CPU_COUNT(cpus);
+}
+
+/// @brief Read the CPUs of every NUMA node.
+/// @param cpus Output array of HTABLE_SHARD_MAX_NODES CPU sets, empty for missing nodes.
+/// @param nodes Output array receiving the numbers of the nodes that have CPUs.
+/// @return The number of nodes that have CPUs.
+static size_t read_nodes (cpu_set_t *cpus, int *nodes) {
+
+    size_t count = 0;
+
+    for (int node = 0; node < (int) HTABLE_SHARD_MAX_NODES; node++) {
+
+        char path[64];
+        (void) snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+
+        CPU_ZERO(&cpus[node]);
+
+        FILE *file = fopen(path, "r");
+
+        // Node numbers may have holes, and memory-only nodes have no CPUs to place shards with.
+        if (file == NULL) {
+            continue;
+        }
+
+        if (parse_cpulist(file, &cpus[node]) > 0) {
+            nodes[count++] = node;
+        }
+
+        (void) fclose(file);
+    }
+
+    return count;
+}
+
+/// @brief Create a shard on a thread bound to the CPUs of a node, on the calling thread if that fails.
+static void create_on_node (const cpu_set_t *cpus, struct shard_init *init) {
+
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    if (pthread_attr_init(&attr) == 0) {
+
+        const int bound = pthread_attr_setaffinity_np(&attr, sizeof(*cpus), cpus) == 0;
+
+        if (bound && pthread_create(&thread, &attr, create_shard, init) == 0) {
+            (void) pthread_join(thread, NULL);
+            (void) pthread_attr_destroy(&attr);
+            return;
+        }
+
+        (void) pthread_attr_destroy(&attr);
+    }
+
+    // Still usable, only without the node-local placement.
+    init->node = -1;
+    (void) create_shard(init);
+}
+
+#endif
+
+// --- Function Definitions --- //
+
+/// @brief Create a sharded hash table.
+htable_shard_t *htable_shard_create (size_t size, htable_hash_t hash, htable_keq_t keq, const struct callbacks *cbs, const struct htable_opts *opts, const struct htable_shard_opts *shard_opts) {
+
+    // Hits of a capacity-bounded table set reference bits, which the readers of a shard must not write.
+    // Multimaps take their values through htable_insert_multi only, which the front-end does not offer.
+    if (size == 0 || hash == NULL || keq == NULL || (opts != NULL && (opts->capacity > 0 || (opts->flags & HTABLE_MULTI)))) {
+        return NULL;
+    }
+
+    htable_shard_t *table = NULL;
+
+    if ((table = calloc(1U, sizeof(*table))) == NULL) {
+        return NULL;
+    }
+
+    const size_t requested = shard_opts != NULL && shard_opts->shards != 0 ? shard_opts->shards : HTABLE_SHARDS;
+    const int numa = shard_opts != NULL && (shard_opts->flags & HTABLE_SHARD_NUMA);
+
+    const struct htable_opts config = htable_route_opts(opts);
+    htable_route_init(&table->route, requested, hash, &config);
+
+    const size_t nshards = table->route.parts;
+
+    if ((table->shards = calloc(nshards, sizeof(*table->shards))) == NULL) {
+        free(table);
+        return NULL;
+    }
+
+    size_t nnodes = 0;
+    int nodes[HTABLE_SHARD_MAX_NODES];
+
+#if defined(SHARD_NUMA)
+    if (numa && (table->cpus = calloc(HTABLE_SHARD_MAX_NODES, sizeof(*table->cpus))) != NULL) {
+        nnodes = read_nodes(table->cpus, nodes);
+    }
+#else
+    (void) numa;
+    (void) nodes;
+#endif
+
+    const size_t shard_size = (size + nshards - 1U) / nshards;
+
+    for (size_t idx = 0; idx < nshards; idx++) {
+
+        struct shard_init init = {
+            .size = shard_size, .hash = hash, .keq = keq, .cbs = cbs, .config = &config,
+            .node = nnodes > 0 ? nodes[idx % nnodes] : -1,
+        };
+
+        // Shards go round robin over the nodes, so consecutive shards land on different sockets.
+#if defined(SHARD_NUMA)
+        if (init.node >= 0) {
+            create_on_node(&table->cpus[init.node], &init);
+        } else {
+            (void) create_shard(&init);
+        }
+#else
+        (void) create_shard(&init);
+#endif
+
+        if ((table->shards[idx] = init.shard) == NULL) {
+            // Unwind the shards created so far.
+            table->route.parts = idx;
+            htable_shard_destroy(table);
+            return NULL;
+        }
+    }
+
+    return table;
+}
+
+/// @brief Destroy the sharded hash table, no other thread may access it anymore.
+void htable_shard_destroy (htable_shard_t *table) {
+
+    if (table == NULL) {
+        return;
+    }
+
+    for (size_t idx = 0; idx < table->route.parts; idx++) {
+        htable_locked_destroy(&table->shards[idx]->part);
+        free(table->shards[idx]);
+    }
+
+#if defined(SHARD_NUMA)
+    free(table->cpus);
+#endif
+
+    free(table->shards);
+    free(table);
+}
+
+/// @brief Insert a key-value pair, taking the lock of its shard exclusively.
+int htable_shard_insert (htable_shard_t *table, const void *key, const void *value) {
+
+    if (table == NULL || value == NULL) {
+        return -1;
+    }
+
+    const unsigned long hash = htable_route_hash(&table->route, key);
+
+    return htable_locked_insert(get_part(table, hash), key, value, hash);
+}
+
+/// @brief Remove a key-value pair, taking the lock of its shard exclusively.
+int htable_shard_remove (htable_shard_t *table, const void *key) {
+
+    if (table == NULL) {
+        return -1;
+    }
+
+    const unsigned long hash = htable_route_hash(&table->route, key);
+
+    return htable_locked_remove(get_part(table, hash), key, hash);
+}
+
+/// @brief Retrieve a value under a shared lock of the shard of the key.
+void *htable_shard_get (htable_shard_t *table, const void *key) {
+
+    if (table == NULL) {
+        return NULL;
+    }
+
+    const unsigned long hash = htable_route_hash(&table->route, key);
+
+    return htable_locked_get(get_part(table, hash), key, hash, NULL, NULL);
+}
+
+/// @brief Count the elements of every shard.
+size_t htable_shard_count (htable_shard_t *table) {
+
+    if (table == NULL) {
+        return 0;
+    }
+
+    size_t count = 0;
+
+    for (size_t idx = 0; idx < table->route.parts; idx++) {
+        count += htable_locked_count(&table->shards[idx]->part);
+    }
+
+    return count;
+}
+
+/// @brief Aggregate the statistics of every shard.
+int htable_shard_stats (htable_shard_t *table, struct htable_shard_stats *out) {
+
+    if (table == NULL || out == NULL) {
+        return -1;
+    }
+
+    *out = (struct htable_shard_stats) { .collected = 1 };
+
+    double probe_total = 0.0;
+
+    for (size_t idx = 0; idx < table->route.parts; idx++) {
+
+        struct htable_locked *part = &table->shards[idx]->part;
+        struct htable_stats stats;
+
+        (void) pthread_rwlock_rdlock(&part->lock);
+
+        out->count += part->table->count;
+        out->max_count = part->table->count > out->max_count ? part->table->count : out->max_count;
+        out->buckets += part->table->size;
+
+        const int rc = htable_stats(part->table, &stats);
+
+        (void) pthread_rwlock_unlock(&part->lock);
+
+        // Without HTABLE_STATS only the sizes are aggregated.
+        if (rc != 0) {
+            out->collected = 0;
+            continue;
+        }
+
+        out->table.lookups += stats.lookups;
+        out->table.hits += stats.hits;
+        out->table.misses += stats.misses;
+        out->table.searches += stats.searches;
+        out->table.keq_calls += stats.keq_calls;
+        out->table.resizes += stats.resizes;
+        out->table.resize_ns += stats.resize_ns;
+        out->table.evictions += stats.evictions;
+        out->table.reseeds += stats.reseeds;
+
+        for (size_t bucket = 0; bucket < HTABLE_STATS_PROBES; bucket++) {
+            out->table.probes[bucket] += stats.probes[bucket];
+        }
+
+        probe_total += stats.avg_probes * (double) stats.searches;
+    }
+
+    const double searches = out->table.searches > 0 ? (double) out->table.searches : 1.0;
+
+    out->table.avg_probes = probe_total / searches;
+    out->table.avg_keq = (double) out->table.keq_calls / searches;
+
+    return 0;
+}
+
+/// @brief Number of shards of the hash table.
+size_t htable_shard_shards (const htable_shard_t *table) {
+    return table != NULL ? table->route.parts : 0U;
+}
+
+/// @brief Shard a key belongs to.
+size_t htable_shard_of (const htable_shard_t *table, const void *key) {
+
+    if (table == NULL) {
+        return 0;
+    }
+
+    return htable_route_part(&table->route, htable_route_hash(&table->route, key));
+}
+
+/// @brief NUMA node a shard was placed on.
+int htable_shard_node (const htable_shard_t *table, size_t shard) {
+    return table != NULL && shard < table->route.parts ? table->shards[shard]->node : -1;
+}
+
+/// @brief Bind the calling thread to the CPUs of the NUMA node of a shard.
+int htable_shard_bind (const htable_shard_t *table, size_t shard) {
+
+    const int node = htable_shard_node(table, shard);
+
+    if (node < 0) {
+        return -1;
+    }
+
+#if defined(SHARD_NUMA)
+    return sched_setaffinity(0, sizeof(table->cpus[node]), &table->cpus[node]) == 0 ? 0 : -1;
+#else
+    return -1;
+#endif
+}
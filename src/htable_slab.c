@@ -0,0 +1,172 @@
+// ==============================================================================
+//                                Slab Allocator
+// ==============================================================================
+//
+// Description: Fixed-size object allocator used for the hash nodes of the
+// chaining engine. Objects are carved out of large chunks and recycled through
+// an intrusive freelist, so inserting and removing keys does not hit malloc(3)
+// per node, and destroying the slab frees a handful of chunks instead of every
+// object.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#include "htable.h"
+
+#include <stdalign.h>   // For the alignof operator.
+
+// --- Macros --- //
+
+#define SLAB_ALIGN alignof(max_align_t)     // Alignment of the chunk header and every object.
+
+/// @brief Round a size up to the slab alignment.
+#define SLAB_ROUND(size) (((size) + SLAB_ALIGN - 1U) & ~(SLAB_ALIGN - 1U))
+
+// --- Static Function Definitions --- //
+
+static void *slab_alloc (void *ctx, size_t size) {
+    (void) size;
+    return htable_slab_alloc(ctx);
+}
+
+static void slab_free (void *ctx, void *ptr, size_t size) {
+    (void) size;
+    htable_slab_free(ctx, ptr);
+}
+
+/// @brief Allocate a new chunk and make it the bump region of the slab.
+/// @param slab The slab to grow.
+/// @param objs The number of objects the chunk holds.
+/// @return 0 on success, -2 on memory allocation failure.
+static int add_chunk (htable_slab_t *slab, size_t objs) {
+
+    char *chunk = NULL;
+
+    if ((chunk = malloc(SLAB_ROUND(sizeof(void *)) + objs * slab->obj_size)) == NULL) {
+        return -2;
+    }
+
+    // Link the chunk into the list of chunks through its header.
+    *(void **) chunk = slab->chunks;
+    slab->chunks = chunk;
+
+    slab->bump = chunk + SLAB_ROUND(sizeof(void *));
+    slab->bump_end = slab->bump + objs * slab->obj_size;
+
+    return 0;
+}
+
+// --- Function Definitions --- //
+
+/// @brief Create a slab allocator for objects of the specified size.
+htable_slab_t *htable_slab_create (size_t obj_size, size_t chunk_objs) {
+
+    if (obj_size == 0) {
+        return NULL;
+    }
+
+    htable_slab_t *slab = NULL;
+
+    if ((slab = calloc(1U, sizeof(*slab))) == NULL) {
+        return NULL;
+    }
+
+    // Every object must be able to hold the freelist link.
+    slab->obj_size = SLAB_ROUND(obj_size < sizeof(void *) ? sizeof(void *) : obj_size);
+    slab->chunk_objs = chunk_objs != 0 ? chunk_objs : HTABLE_SLAB_CHUNK;
+
+    return slab;
+}
+
+/// @brief Destroy the slab, freeing every chunk and thereby every object at once.
+void htable_slab_destroy (htable_slab_t *slab) {
+
+    if (slab == NULL) {
+        return;
+    }
+
+    void *chunk = slab->chunks;
+
+    while (chunk != NULL) {
+        void *next = *(void **) chunk;
+        free(chunk);
+        chunk = next;
+    }
+
+    free(slab);
+}
+
+/// @brief Allocate an object from the slab.
+void *htable_slab_alloc (htable_slab_t *slab) {
+
+    // Recycle freed objects first.
+    if (slab->freelist != NULL) {
+        void *ptr = slab->freelist;
+        slab->freelist = *(void **) ptr;
+        return ptr;
+    }
+
+    if (slab->bump == slab->bump_end && add_chunk(slab, slab->chunk_objs) != 0) {
+        return NULL;
+    }
+
+    void *ptr = slab->bump;
+    slab->bump += slab->obj_size;
+
+    return ptr;
+}
+
+/// @brief Make sure the next objs objects carved by the slab are contiguous.
+int htable_slab_reserve (htable_slab_t *slab, size_t objs) {
+
+    // The rest of the current chunk is abandoned if it is too small, it is still freed with the slab.
+    if (slab->bump != NULL && (size_t) (slab->bump_end - slab->bump) / slab->obj_size >= objs) {
+        return 0;
+    }
+
+    return add_chunk(slab, objs);
+}
+
+/// @brief Return an object to the freelist of the slab.
+void htable_slab_free (htable_slab_t *slab, void *ptr) {
+
+    if (ptr == NULL) {
+        return;
+    }
+
+    *(void **) ptr = slab->freelist;
+    slab->freelist = ptr;
+}
+
+/// @brief Wrap the slab into an allocator usable as struct htable_opts allocator.
+struct htable_allocator htable_slab_allocator (htable_slab_t *slab) {
+
+    const struct htable_allocator allocator = {
+        .alloc = slab_alloc,
+        .free = slab_free,
+        .release = NULL,
+        .ctx = slab,
+    };
+
+    return allocator;
+}
@@ -0,0 +1,361 @@
+// ==============================================================================
+//                           Copy-on-write Snapshots
+// ==============================================================================
+//
+// Description: Point-in-time snapshots of the chaining engine. A snapshot starts
+// out sharing every bucket of its table and keeps a bitmap of the buckets it has
+// its own copy of. Before the table writes to a bucket, every snapshot still
+// sharing it copies the chain, so taking a snapshot is O(1) and writes pay once
+// per bucket they touch.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#include "htable_internal.h"
+
+#include <limits.h>     // For the number of bits in a byte, CHAR_BIT.
+#include <string.h>     // For memory operations, e.g. memcpy(3).
+
+// --- Types --- //
+
+/// @brief Copy-on-write snapshot of a hash table.
+struct htable_snapshot {
+    htable_t *source;           // The hash table sharing the unpreserved buckets, NULL once detached.
+    htable_snapshot_t *next;    // The next snapshot of the same hash table.
+    htable_t shape;             // The configuration, size and count of the hash table when the snapshot was taken.
+    struct htable_node **buckets; // The chains copied by the snapshot, indexed by bucket.
+    unsigned char *preserved;   // Bitmap of the buckets the snapshot has copied.
+};
+
+// --- Static Function Definitions --- //
+
+static int is_preserved (const htable_snapshot_t *snap, size_t idx) {
+    return (snap->preserved[idx / CHAR_BIT] >> (idx % CHAR_BIT)) & 1U;
+}
+
+/// @brief The chain of a bucket as the snapshot sees it, NULL for a bucket lost to a forced detach.
+static const struct htable_node *bucket_chain (const htable_snapshot_t *snap, size_t idx) {
+
+    if (is_preserved(snap, idx)) {
+        return snap->buckets[idx];
+    }
+
+    return snap->source != NULL ? snap->source->table[idx] : NULL;
+}
+
+/// @brief Free a hash node copied by a snapshot, with its key and value.
+static void free_copy (const htable_snapshot_t *snap, struct htable_node *node) {
+
+    const htable_t *shape = &snap->shape;
+
+    if (shape->inline_size == 0 || node->key != (void *) node->data) {
+        if (node->key_len != 0) {
+            free(node->key);
+        }
+        else {
+            shape->cbs.kfree(node->key);
+        }
+    }
+
+    if (shape->flags & HTABLE_MULTI) {
+        struct htable_values *values = node->value;
+
+        for (size_t idx = 0; values != NULL && idx < values->count; idx++) {
+            shape->cbs.vfree(values->items[idx]);
+        }
+
+        free(values);
+    }
+    else if (node->value != NULL && (shape->inline_size == 0 || node->value != (void *) (node->data + shape->inline_size))) {
+        shape->cbs.vfree(node->value);
+    }
+
+    free(node);
+}
+
+static void free_chain (const htable_snapshot_t *snap, struct htable_node *node) {
+    while (node != NULL) {
+        struct htable_node *next = node->next;
+        free_copy(snap, node);
+        node = next;
+    }
+}
+
+/// @brief Copy a hash node, its key and its value, inline parts along with the node.
+/// Snapshot nodes come from malloc(3), not from the allocator of the table, since they may outlive it.
+static struct htable_node *copy_node (const htable_snapshot_t *snap, const struct htable_node *node) {
+
+    const htable_t *shape = &snap->shape;
+    struct htable_node *copy = NULL;
+
+    if ((copy = malloc(shape->node_size)) == NULL) {
+        return NULL;
+    }
+
+    memcpy(copy, node, shape->node_size);
+    copy->next = NULL;
+
+    if (shape->inline_size > 0 && node->key == (void *) node->data) {
+        copy->key = copy->data;
+    }
+    else if (node->key_len != 0) {
+        // Length-aware keys are copied byte for byte, like the table copies them.
+        if ((copy->key = malloc(node->key_len)) == NULL) {
+            free(copy);
+            return NULL;
+        }
+
+        memcpy(copy->key, node->key, node->key_len);
+    }
+    else {
+        copy->key = shape->cbs.kcpy(node->key);
+    }
+
+    if (shape->flags & HTABLE_MULTI) {
+        const struct htable_values *values = node->value;
+        struct htable_values *dup = NULL;
+
+        if (values != NULL) {
+            if ((dup = malloc(sizeof(*dup) + values->cap * sizeof(dup->items[0]))) == NULL) {
+                if (copy->key != (void *) copy->data) {
+                    shape->cbs.kfree(copy->key);
+                }
+
+                free(copy);
+                return NULL;
+            }
+
+            dup->count = values->count;
+            dup->cap = values->cap;
+
+            for (size_t idx = 0; idx < values->count; idx++) {
+                dup->items[idx] = shape->cbs.vcpy(values->items[idx]);
+            }
+        }
+
+        copy->value = dup;
+    }
+    else if (node->value != NULL && shape->inline_size > 0 && node->value == (void *) (node->data + shape->inline_size)) {
+        copy->value = copy->data + shape->inline_size;
+    }
+    else if (node->value != NULL) {
+        copy->value = shape->cbs.vcpy(node->value);
+    }
+
+    return copy;
+}
+
+/// @brief Copy a bucket of the source table into a snapshot.
+/// @return 0 on success, -2 on memory allocation failure.
+static int preserve (htable_snapshot_t *snap, size_t idx) {
+
+    struct htable_node *head = NULL;
+    struct htable_node **tail = &head;
+
+    // Keep the chain order, so the snapshot visits keys like the table did.
+    for (const struct htable_node *node = snap->source->table[idx]; node != NULL; node = node->next) {
+
+        if ((*tail = copy_node(snap, node)) == NULL) {
+            free_chain(snap, head);
+            return -2;
+        }
+
+        tail = &(*tail)->next;
+    }
+
+    snap->buckets[idx] = head;
+    snap->preserved[idx / CHAR_BIT] |= (unsigned char) (1U << (idx % CHAR_BIT));
+
+    return 0;
+}
+
+/// @brief Unlink a snapshot from the list of its source table.
+static void unlink_snapshot (htable_snapshot_t *snap) {
+
+    for (htable_snapshot_t **link = &snap->source->snapshots; *link != NULL; link = &(*link)->next) {
+        if (*link == snap) {
+            *link = snap->next;
+            break;
+        }
+    }
+
+    snap->source = NULL;
+    snap->next = NULL;
+}
+
+// --- Function Definitions --- //
+
+/// @brief Copy bucket idx into every snapshot that still shares it.
+int htable_snapshot_preserve (htable_t *table, size_t idx) {
+
+    for (htable_snapshot_t *snap = table->snapshots; snap != NULL; snap = snap->next) {
+        if (!is_preserved(snap, idx) && preserve(snap, idx) != 0) {
+            return -2;
+        }
+    }
+
+    return 0;
+}
+
+/// @brief Copy every bucket still shared into the snapshots and detach them from the hash table.
+int htable_snapshot_detach (htable_t *table, int force) {
+
+    int rc = 0;
+
+    for (htable_snapshot_t *snap = table->snapshots, *next = NULL; snap != NULL; snap = next) {
+
+        int failed = 0;
+
+        next = snap->next;
+
+        for (size_t idx = 0; idx < snap->shape.size && !failed; idx++) {
+            failed = !is_preserved(snap, idx) && preserve(snap, idx) != 0;
+        }
+
+        if (failed) {
+            rc = -2;
+        }
+
+        // An unforced detach keeps a snapshot that could not copy everything, it still shares the rest.
+        if (!failed || force) {
+            unlink_snapshot(snap);
+        }
+    }
+
+    return rc;
+}
+
+/// @brief Take a point-in-time snapshot of the hash table.
+htable_snapshot_t *htable_snapshot (htable_t *table) {
+
+    if (table == NULL || table->table == NULL || table->engine != HTABLE_ENGINE_CHAIN) {
+        return NULL;
+    }
+
+    // Preserved buckets are copied through kcpy and vcpy, which must not hand back what the table frees.
+    if (htable_copies_shared(table)) {
+        return NULL;
+    }
+
+    // A single bucket array keeps the preserved bitmap meaningful.
+    while (table->rehash_table != NULL) {
+        htable_rehash_step(table, table->rehash_size);
+    }
+
+    htable_snapshot_t *snap = NULL;
+
+    if ((snap = calloc(1U, sizeof(*snap))) == NULL) {
+        return NULL;
+    }
+
+    // Zeroed memory comes straight from the kernel for large tables, so neither array is touched until written.
+    snap->buckets = calloc(table->size, sizeof(*snap->buckets));
+    snap->preserved = calloc((table->size + CHAR_BIT - 1U) / CHAR_BIT, 1U);
+
+    if (snap->buckets == NULL || snap->preserved == NULL) {
+        free(snap->buckets);
+        free(snap->preserved);
+        free(snap);
+        return NULL;
+    }
+
+    snap->shape = (htable_t) {
+        .size = table->size,
+        .count = table->count,
+        .hash = table->hash,
+        .seeded_hash = table->seeded_hash,
+        .seed = table->seed,
+        .keq = table->keq,
+        .cbs = table->cbs,
+        .flags = table->flags,
+        .engine = table->engine,
+        .inline_size = table->inline_size,
+        .node_size = table->node_size,
+    };
+
+    snap->source = table;
+    snap->next = table->snapshots;
+    table->snapshots = snap;
+
+    return snap;
+}
+
+/// @brief Release a snapshot and the chains it copied.
+void htable_snapshot_release (htable_snapshot_t *snap) {
+
+    if (snap == NULL) {
+        return;
+    }
+
+    if (snap->source != NULL) {
+        unlink_snapshot(snap);
+    }
+
+    for (size_t idx = 0; idx < snap->shape.size; idx++) {
+        if (is_preserved(snap, idx)) {
+            free_chain(snap, snap->buckets[idx]);
+        }
+    }
+
+    free(snap->buckets);
+    free(snap->preserved);
+    free(snap);
+}
+
+/// @brief Retrieve the value a key had when the snapshot was taken.
+void *htable_snapshot_get (const htable_snapshot_t *snap, const void *key) {
+
+    if (snap == NULL) {
+        return NULL;
+    }
+
+    const unsigned long hash = htable_hash_key(&snap->shape, key);
+    const size_t idx = htable_bucket_index(&snap->shape, hash, snap->shape.size);
+
+    for (const struct htable_node *node = bucket_chain(snap, idx); node != NULL; node = node->next) {
+        if (node->hash == hash && node->key_len == 0 && snap->shape.keq(node->key, key)) {
+            return node->value;
+        }
+    }
+
+    return NULL;
+}
+
+/// @brief Count the entries of the snapshot.
+size_t htable_snapshot_count (const htable_snapshot_t *snap) {
+    return snap != NULL ? snap->shape.count : 0;
+}
+
+/// @brief Visit every key-value pair of the snapshot.
+void htable_snapshot_for_each (const htable_snapshot_t *snap, htable_scan_t fn, void *ctx) {
+
+    if (snap == NULL || fn == NULL) {
+        return;
+    }
+
+    for (size_t idx = 0; idx < snap->shape.size; idx++) {
+        for (const struct htable_node *node = bucket_chain(snap, idx); node != NULL; node = node->next) {
+            fn(node->key, node->value, ctx);
+        }
+    }
+}
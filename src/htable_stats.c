@@ -0,0 +1,165 @@
+// ==============================================================================
+//                            Hash Table Statistics
+// ==============================================================================
+//
+// Description: Opt-in instrumentation of the hash table hot paths. Lookups, hits
+// and misses, the probe length histogram, keq calls and resize counts and
+// durations are collected only when the library is built with HTABLE_STATS
+// defined, otherwise every hook compiles to nothing.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "htable_internal.h"
+
+#include <time.h>       // For the monotonic clock, e.g. clock_gettime(2).
+
+// --- Function Definitions --- //
+
+#if defined(HTABLE_STATS)
+
+/// @brief Record a lookup and whether it found its key.
+void htable_stats_lookup (const htable_t *table, int found) {
+
+    if (table->stats == NULL) {
+        return;
+    }
+
+    atomic_fetch_add_explicit(&table->stats->lookups, 1U, memory_order_relaxed);
+    atomic_fetch_add_explicit(found ? &table->stats->hits : &table->stats->misses, 1U, memory_order_relaxed);
+}
+
+/// @brief Record a key search.
+void htable_stats_search (const htable_t *table, size_t probes, size_t keqs) {
+
+    if (table->stats == NULL) {
+        return;
+    }
+
+    const size_t bucket = probes < HTABLE_STATS_PROBES ? probes : HTABLE_STATS_PROBES - 1U;
+
+    atomic_fetch_add_explicit(&table->stats->searches, 1U, memory_order_relaxed);
+    atomic_fetch_add_explicit(&table->stats->keq_calls, keqs, memory_order_relaxed);
+    atomic_fetch_add_explicit(&table->stats->probe_total, probes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&table->stats->probes[bucket], 1U, memory_order_relaxed);
+}
+
+/// @brief Record the start of a resize.
+void htable_stats_resize (const htable_t *table) {
+    if (table->stats != NULL) {
+        atomic_fetch_add_explicit(&table->stats->resizes, 1U, memory_order_relaxed);
+    }
+}
+
+/// @brief Record an eviction.
+void htable_stats_evict (const htable_t *table) {
+    if (table->stats != NULL) {
+        atomic_fetch_add_explicit(&table->stats->evictions, 1U, memory_order_relaxed);
+    }
+}
+
+/// @brief Record a re-seed forced by a long chain.
+void htable_stats_reseed (const htable_t *table) {
+    if (table->stats != NULL) {
+        atomic_fetch_add_explicit(&table->stats->reseeds, 1U, memory_order_relaxed);
+    }
+}
+
+/// @brief Add the time elapsed since start to the resize time.
+void htable_stats_elapsed (const htable_t *table, unsigned long long start) {
+    if (table->stats != NULL) {
+        atomic_fetch_add_explicit(&table->stats->resize_ns, htable_stats_now() - start, memory_order_relaxed);
+    }
+}
+
+/// @brief Monotonic clock in nanoseconds.
+unsigned long long htable_stats_now (void) {
+    struct timespec ts;
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + (unsigned long long) ts.tv_nsec;
+}
+
+/// @brief Allocate the statistics counters of a hash table.
+int htable_stats_attach (htable_t *table) {
+    return (table->stats = calloc(1U, sizeof(*table->stats))) != NULL ? 0 : -2;
+}
+
+/// @brief Free the statistics counters of a hash table.
+void htable_stats_detach (htable_t *table) {
+    free(table->stats);
+    table->stats = NULL;
+}
+
+/// @brief Read the statistics of the hash table.
+int htable_stats (const htable_t *table, struct htable_stats *out) {
+
+    if (table == NULL || table->stats == NULL || out == NULL) {
+        return -1;
+    }
+
+    const struct htable_stats_counters *stats = table->stats;
+
+    out->lookups = atomic_load_explicit(&stats->lookups, memory_order_relaxed);
+    out->hits = atomic_load_explicit(&stats->hits, memory_order_relaxed);
+    out->misses = atomic_load_explicit(&stats->misses, memory_order_relaxed);
+    out->searches = atomic_load_explicit(&stats->searches, memory_order_relaxed);
+    out->keq_calls = atomic_load_explicit(&stats->keq_calls, memory_order_relaxed);
+    out->resizes = atomic_load_explicit(&stats->resizes, memory_order_relaxed);
+    out->resize_ns = atomic_load_explicit(&stats->resize_ns, memory_order_relaxed);
+    out->evictions = atomic_load_explicit(&stats->evictions, memory_order_relaxed);
+    out->reseeds = atomic_load_explicit(&stats->reseeds, memory_order_relaxed);
+
+    for (size_t idx = 0; idx < HTABLE_STATS_PROBES; idx++) {
+        out->probes[idx] = atomic_load_explicit(&stats->probes[idx], memory_order_relaxed);
+    }
+
+    const double searches = out->searches > 0 ? (double) out->searches : 1.0;
+
+    out->avg_probes = (double) atomic_load_explicit(&stats->probe_total, memory_order_relaxed) / searches;
+    out->avg_keq = (double) out->keq_calls / searches;
+
+    return 0;
+}
+
+#else
+
+/// @brief Statistics are compiled out, tables carry no counters.
+int htable_stats_attach (htable_t *table) {
+    (void) table;
+    return 0;
+}
+
+void htable_stats_detach (htable_t *table) {
+    (void) table;
+}
+
+/// @brief Read the statistics of the hash table, always failing without HTABLE_STATS.
+int htable_stats (const htable_t *table, struct htable_stats *out) {
+    (void) table;
+    (void) out;
+    return -1;
+}
+
+#endif
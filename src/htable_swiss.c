@@ -0,0 +1,474 @@
+// ==============================================================================
+//                              SwissTable Engine
+// ==============================================================================
+//
+// Description: Open-addressing storage engine for the generic hash table
+// modelled after SwissTable. Every slot has a one byte control tag holding seven
+// bits of the hash or the empty/deleted state, kept in a separate array. Probing
+// loads a group of sixteen tags and matches them in parallel with SSE2 or NEON,
+// so the key comparison only runs for slots whose tag already matches, and a
+// missing key usually costs a single group compare.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#include "htable_internal.h"
+
+#include <string.h>     // For memory operations, e.g. memset(3).
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+#endif
+
+// --- Macros --- //
+
+#define CTRL_EMPTY ((unsigned char) 0x80)      // The slot has never been occupied.
+#define CTRL_DELETED ((unsigned char) 0xFE)    // The slot held an entry that was removed.
+
+#define GROUP_WIDTH 16U     // Number of control bytes matched at once.
+
+#if defined(__ARM_NEON) && !defined(__SSE2__)
+    #define MASK_SHIFT 2U   // NEON masks use one nibble per control byte.
+#else
+    #define MASK_SHIFT 0U   // One bit per control byte.
+#endif
+
+// --- Static Function Definitions --- //
+
+/// @brief Count the trailing zero bits of a non-zero mask.
+static unsigned int ctz64 (uint64_t mask) {
+#if defined(__GNUC__)
+    return (unsigned int) __builtin_ctzll(mask);
+#else
+    unsigned int count = 0;
+    for (; (mask & 1U) == 0; mask >>= 1U) {
+        count++;
+    }
+    return count;
+#endif
+}
+
+/// @brief Count the leading zero bits of a non-zero mask.
+static unsigned int clz64 (uint64_t mask) {
+#if defined(__GNUC__)
+    return (unsigned int) __builtin_clzll(mask);
+#else
+    unsigned int count = 0;
+    for (; (mask & (1ULL << 63U)) == 0; mask <<= 1U) {
+        count++;
+    }
+    return count;
+#endif
+}
+
+/// @brief Mix the user hash so that both the position and the tag bits are well distributed.
+static uint64_t mix_hash (unsigned long hash) {
+    return htable_fmix64(hash);
+}
+
+/// @brief Extract the seven tag bits stored in the control byte.
+static unsigned char hash_tag (uint64_t mixed) {
+    return (unsigned char) (mixed & 0x7FU);
+}
+
+/// @brief Match the control bytes of a group against a byte value.
+/// @param ctrl The first control byte of the group.
+/// @param value The byte value to match.
+/// @return A mask with one bit (or nibble) set per matching control byte.
+static uint64_t match_byte (const unsigned char *ctrl, unsigned char value) {
+#if defined(__SSE2__)
+    const __m128i group = _mm_loadu_si128((const __m128i *) ctrl);
+    return (uint64_t) (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char) value)));
+#elif defined(__ARM_NEON)
+    const uint8x16_t cmp = vceqq_u8(vld1q_u8(ctrl), vdupq_n_u8(value));
+    const uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0) & 0x8888888888888888ULL;
+#else
+    uint64_t mask = 0;
+    for (unsigned int idx = 0; idx < GROUP_WIDTH; idx++) {
+        mask |= (uint64_t) (ctrl[idx] == value) << idx;
+    }
+    return mask;
+#endif
+}
+
+/// @brief Match the control bytes of a group that are empty or deleted.
+/// @param ctrl The first control byte of the group.
+/// @return A mask with one bit (or nibble) set per free control byte.
+static uint64_t match_free (const unsigned char *ctrl) {
+#if defined(__SSE2__)
+    return (uint64_t) (unsigned int) _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) ctrl));
+#elif defined(__ARM_NEON)
+    const uint8x16_t cmp = vcltq_s8(vreinterpretq_s8_u8(vld1q_u8(ctrl)), vdupq_n_s8(0));
+    const uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0) & 0x8888888888888888ULL;
+#else
+    uint64_t mask = 0;
+    for (unsigned int idx = 0; idx < GROUP_WIDTH; idx++) {
+        mask |= (uint64_t) ((ctrl[idx] & 0x80U) != 0) << idx;
+    }
+    return mask;
+#endif
+}
+
+/// @brief Index of the lowest control byte set in a non-zero mask.
+static size_t mask_first (uint64_t mask) {
+    return ctz64(mask) >> MASK_SHIFT;
+}
+
+/// @brief Number of unset control bytes at the end of a non-zero group mask.
+static size_t mask_leading (uint64_t mask) {
+    return (clz64(mask) >> MASK_SHIFT) - (64U >> MASK_SHIFT) + GROUP_WIDTH;
+}
+
+/// @brief Set a control byte, keeping the cloned bytes past the end in sync.
+static void set_ctrl (htable_t *table, size_t idx, unsigned char value) {
+
+    table->ctrl[idx] = value;
+
+    // The first group is mirrored after the last slot so unaligned group loads never wrap.
+    if (idx < GROUP_WIDTH) {
+        table->ctrl[table->size + idx] = value;
+    }
+}
+
+/// @brief Find the slot holding the key.
+/// @param table The hash table to search.
+/// @param key The key for the slot.
+/// @param hash The hash value of the key.
+/// @return Index of the slot, or the number of slots if the key is not present.
+static size_t find_slot (const htable_t *table, const void *key, unsigned long hash) {
+
+    const size_t mask = table->size - 1U;
+    const uint64_t mixed = mix_hash(hash);
+    const unsigned char tag = hash_tag(mixed);
+
+    size_t pos = (size_t) (mixed >> 7U) & mask;
+    size_t groups = 0;
+    size_t keqs = 0;
+
+    // Triangular probing over groups visits every group of a power-of-two table.
+    for (size_t step = GROUP_WIDTH;; pos = (pos + step) & mask, step += GROUP_WIDTH) {
+
+        const unsigned char *ctrl = &table->ctrl[pos];
+
+        groups++;
+
+        for (uint64_t match = match_byte(ctrl, tag); match != 0; match &= match - 1U) {
+
+            const size_t idx = (pos + mask_first(match)) & mask;
+            const struct htable_slot *slot = &table->slots[idx];
+
+            if (slot->hash != hash) {
+                continue;
+            }
+
+            keqs++;
+
+            if (table->keq(slot->key, key)) {
+                HTABLE_CLOCK_REF(table, &table->slots[idx]);
+                HTABLE_STAT_SEARCH(table, groups, keqs);
+                return idx;
+            }
+        }
+
+        // An empty control byte ends every probe sequence that could contain the key.
+        if (match_byte(ctrl, CTRL_EMPTY) != 0) {
+            HTABLE_STAT_SEARCH(table, groups, keqs);
+            return table->size;
+        }
+    }
+}
+
+/// @brief Find the first empty or deleted slot of the probe sequence for a hash.
+/// @param ctrl The control bytes to search.
+/// @param mask The number of slots minus one.
+/// @param mixed The mixed hash value of the key.
+/// @return Index of the free slot.
+static size_t find_free (const unsigned char *ctrl, size_t mask, uint64_t mixed) {
+
+    size_t pos = (size_t) (mixed >> 7U) & mask;
+
+    for (size_t step = GROUP_WIDTH;; pos = (pos + step) & mask, step += GROUP_WIDTH) {
+
+        const uint64_t match = match_free(&ctrl[pos]);
+
+        if (match != 0) {
+            return (pos + mask_first(match)) & mask;
+        }
+    }
+}
+
+/// @brief Allocate empty control bytes and slots for the given number of slots.
+/// @return 0 on success, -2 on memory allocation failure.
+static int alloc_arrays (size_t size, unsigned char **ctrl, struct htable_slot **slots) {
+
+    if ((*ctrl = malloc(size + GROUP_WIDTH)) == NULL) {
+        return -2;
+    }
+
+    if ((*slots = malloc(size * sizeof(**slots))) == NULL) {
+        free(*ctrl);
+        return -2;
+    }
+
+    memset(*ctrl, CTRL_EMPTY, size + GROUP_WIDTH);
+
+    return 0;
+}
+
+/// @brief Move every entry into arrays of the given size, dropping all tombstones.
+/// @param table The hash table to resize.
+/// @param size The new number of slots, a power of two.
+/// @return 0 on success, -2 on memory allocation failure.
+static int resize (htable_t *table, size_t size) {
+
+    unsigned char *ctrl = NULL;
+    struct htable_slot *slots = NULL;
+
+    HTABLE_STAT_RESIZE(table);
+    HTABLE_STAT_CLOCK(start);
+
+    if (alloc_arrays(size, &ctrl, &slots) != 0) {
+        return -2;
+    }
+
+    htable_t resized = *table;
+
+    resized.ctrl = ctrl;
+    resized.slots = slots;
+    resized.size = size;
+
+    // Reuse the stored hashes, the user hash function is not called again.
+    for (size_t idx = 0; idx < table->size; idx++) {
+
+        if (table->ctrl[idx] & 0x80U) {
+            continue;
+        }
+
+        const uint64_t mixed = mix_hash(table->slots[idx].hash);
+        const size_t dst = find_free(ctrl, size - 1U, mixed);
+
+        set_ctrl(&resized, dst, hash_tag(mixed));
+        slots[dst] = table->slots[idx];
+    }
+
+    free(table->ctrl);
+    free(table->slots);
+
+    table->ctrl = ctrl;
+    table->slots = slots;
+    table->size = size;
+    table->tombstones = 0;
+
+    HTABLE_STAT_ELAPSED(table, start);
+
+    return 0;
+}
+
+// --- Function Definitions --- //
+
+/// @brief Allocate the control bytes and slots of a SwissTable hash table.
+int htable_swiss_init (htable_t *table, size_t size) {
+
+    size_t capacity = GROUP_WIDTH;
+
+    while (capacity < size) {
+        capacity <<= 1U;
+    }
+
+    if (alloc_arrays(capacity, &table->ctrl, &table->slots) != 0) {
+        return -2;
+    }
+
+    table->size = capacity;
+
+    return 0;
+}
+
+/// @brief Move every entry of a SwissTable hash table into arrays of at least the given size.
+int htable_swiss_resize (htable_t *table, size_t size) {
+
+    size_t capacity = GROUP_WIDTH;
+
+    // Always keep one empty slot so probe loops terminate.
+    while (capacity < size || capacity <= table->count + 1U) {
+        capacity <<= 1U;
+    }
+
+    return resize(table, capacity);
+}
+
+/// @brief Free every entry, the control bytes and slots of a SwissTable hash table.
+void htable_swiss_destroy (htable_t *table) {
+
+    for (size_t idx = 0; idx < table->size; idx++) {
+        if ((table->ctrl[idx] & 0x80U) == 0) {
+            table->cbs.kfree(table->slots[idx].key);
+            table->cbs.vfree(table->slots[idx].value);
+        }
+    }
+
+    free(table->ctrl);
+    free(table->slots);
+}
+
+/// @brief Find the value slot of a key in a SwissTable hash table, claiming a slot if it is absent.
+void **htable_swiss_upsert (htable_t *table, const void *key, unsigned long hash, int owned, int *inserted) {
+
+    const size_t found = find_slot(table, key, hash);
+
+    if (found != table->size) {
+        *inserted = 0;
+        return &table->slots[found].value;
+    }
+
+    // A full capacity-bounded table makes room before a slot is claimed, the freed slot keeps the claim from failing.
+    if (table->capacity > 0 && table->count >= table->capacity) {
+        htable_evict(table);
+    }
+
+    // Tombstones lengthen probe sequences just like entries, so both count towards the load.
+    if ((float) (table->count + table->tombstones + 1U) > table->max_load * (float) table->size) {
+
+        size_t size = table->size;
+
+        // Grow if the live entries alone are heavy, otherwise only purge the tombstones.
+        if (!(table->flags & HTABLE_FIXED_SIZE) && (float) (table->count + 1U) > table->max_load * (float) table->size * 0.5f) {
+            size *= 2U;
+        }
+
+        // Resizing is best effort while there is still a free slot.
+        if (size != table->size || table->tombstones > 0) {
+            (void) resize(table, size);
+        }
+    }
+
+    const uint64_t mixed = mix_hash(hash);
+    const size_t idx = find_free(table->ctrl, table->size - 1U, mixed);
+
+    // Always keep one empty slot so probe loops terminate.
+    if (table->ctrl[idx] == CTRL_EMPTY && table->count + table->tombstones + 1U >= table->size) {
+        return NULL;
+    }
+
+    if (table->ctrl[idx] == CTRL_DELETED) {
+        table->tombstones--;
+    }
+
+    table->slots[idx].key = owned ? (void *) key : table->cbs.kcpy(key);
+    table->slots[idx].value = NULL;
+    table->slots[idx].hash = hash;
+    table->slots[idx].ref = 0;
+
+    set_ctrl(table, idx, hash_tag(mixed));
+    table->count++;
+
+    *inserted = 1;
+
+    return &table->slots[idx].value;
+}
+
+/// @brief Insert a key-value pair into a SwissTable hash table.
+int htable_swiss_insert (htable_t *table, const void *key, const void *value, unsigned long hash) {
+
+    int inserted = 0;
+    void **slot = htable_swiss_upsert(table, key, hash, 0, &inserted);
+
+    if (slot == NULL) {
+        return -2;
+    }
+
+    // Free the previous value and update it with the new value.
+    if (!inserted) {
+        table->cbs.vfree(*slot);
+    }
+
+    *slot = table->cbs.vcpy(value);
+
+    return 0;
+}
+
+/// @brief Unlink a key-value pair from a SwissTable hash table without freeing it.
+int htable_swiss_take (htable_t *table, const void *key, unsigned long hash, void **key_out, void **value_out) {
+
+    const size_t mask = table->size - 1U;
+    const size_t idx = find_slot(table, key, hash);
+
+    if (idx == table->size) {
+        return -1;
+    }
+
+    // Hand the key and value over, the parts the caller does not want back are freed.
+    if (key_out != NULL) {
+        *key_out = table->slots[idx].key;
+    } else {
+        table->cbs.kfree(table->slots[idx].key);
+    }
+
+    if (value_out != NULL) {
+        *value_out = table->slots[idx].value;
+    } else {
+        table->cbs.vfree(table->slots[idx].value);
+    }
+
+    const uint64_t empty_after = match_byte(&table->ctrl[idx], CTRL_EMPTY);
+    const uint64_t empty_before = match_byte(&table->ctrl[(idx - GROUP_WIDTH) & mask], CTRL_EMPTY);
+
+    // If no group-wide window of full slots covers this slot, no probe ever passed it and it can become empty again.
+    if (empty_before != 0 && empty_after != 0 && mask_first(empty_after) + mask_leading(empty_before) < GROUP_WIDTH) {
+        set_ctrl(table, idx, CTRL_EMPTY);
+    } else {
+        set_ctrl(table, idx, CTRL_DELETED);
+        table->tombstones++;
+    }
+
+    table->count--;
+
+    return 0;
+}
+
+/// @brief Remove a key-value pair from a SwissTable hash table.
+int htable_swiss_remove (htable_t *table, const void *key, unsigned long hash) {
+    return htable_swiss_take(table, key, hash, NULL, NULL);
+}
+
+/// @brief Retrieve a value from a SwissTable hash table.
+void *htable_swiss_get (const htable_t *table, const void *key, unsigned long hash) {
+
+    const size_t idx = find_slot(table, key, hash);
+
+    return idx != table->size ? table->slots[idx].value : NULL;
+}
+
+
+/// @brief Prefetch the first control group and slot of a hash in a SwissTable hash table.
+void htable_swiss_prefetch (const htable_t *table, unsigned long hash) {
+
+    const size_t pos = (size_t) (mix_hash(hash) >> 7U) & (table->size - 1U);
+
+    HTABLE_PREFETCH(&table->ctrl[pos]);
+    HTABLE_PREFETCH(&table->slots[pos]);
+}
\ No newline at end of file
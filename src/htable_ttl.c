@@ -0,0 +1,307 @@
+// ==============================================================================
+//                                 Entry Expiry
+// ==============================================================================
+//
+// Description: Time to live of the chaining engine. Every entry with a time to
+// live stores its expiry tick, lookups check it, and a hierarchical timing wheel
+// of six levels of 64 slots schedules one timer per expiry. Advancing the wheel
+// visits only the slots of the elapsed ticks, moving timers of the upper levels
+// down as their slots come due, so expiring costs O(expired) instead of a scan
+// of every bucket.
+//
+// MIT License
+//
+// Copyright (c) 2024 Erik A. Rapp
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// ==============================================================================
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "htable_internal.h"
+
+#include <time.h>       // For the monotonic clock, e.g. clock_gettime(2).
+
+// --- Constants --- //
+
+/// @brief Each level of the timing wheel has 2^WHEEL_BITS slots.
+#define WHEEL_BITS 6U
+#define WHEEL_SLOTS (1U << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1U)
+
+/// @brief Six levels span 2^36 ticks, beyond the longest time to live of 2^31 milliseconds.
+#define WHEEL_LEVELS 6U
+
+// --- Types --- //
+
+/// @brief Timer of one expiry, the hash leads to the bucket of the entry without holding on to its hash node.
+struct wheel_timer {
+    unsigned long hash;         // The hash value of the key.
+    unsigned long long deadline; // The tick the entry expires at.
+};
+
+/// @brief Slot of the timing wheel, a growable array of timers.
+struct wheel_slot {
+    struct wheel_timer *timers; // The timers of the slot.
+    size_t count;               // The number of timers.
+    size_t cap;                 // The capacity of the timer array.
+};
+
+/// @brief Hierarchical timing wheel, level L slots span 2^(WHEEL_BITS * L) ticks each.
+struct htable_wheel {
+    unsigned long long epoch_ns; // The monotonic time of tick 0.
+    unsigned long long tick;    // The next tick to process, every earlier one has been processed.
+    size_t pending;             // The number of timers in the wheel.
+    struct wheel_slot slots[WHEEL_LEVELS][WHEEL_SLOTS];
+};
+
+// --- Static Function Definitions --- //
+
+/// @brief Monotonic clock in nanoseconds.
+static unsigned long long now_ns (void) {
+    struct timespec ts;
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + (unsigned long long) ts.tv_nsec;
+}
+
+/// @brief Add a timer to the slot of its deadline, at the lowest level whose span covers it.
+/// @return 0 on success, -2 on memory allocation failure.
+static int wheel_add (struct htable_wheel *wheel, struct wheel_timer timer) {
+
+    // A deadline that has already passed is due at the next processed tick.
+    const unsigned long long deadline = timer.deadline > wheel->tick ? timer.deadline : wheel->tick;
+    const unsigned long long delta = deadline - wheel->tick;
+    unsigned int level = 0;
+
+    while (level < WHEEL_LEVELS - 1U && delta >= 1ULL << (WHEEL_BITS * (level + 1U))) {
+        level++;
+    }
+
+    struct wheel_slot *slot = &wheel->slots[level][(deadline >> (WHEEL_BITS * level)) & WHEEL_MASK];
+
+    if (slot->count == slot->cap) {
+        const size_t cap = slot->cap > 0 ? slot->cap * 2U : 4U;
+        struct wheel_timer *timers = realloc(slot->timers, cap * sizeof(*timers));
+
+        if (timers == NULL) {
+            return -2;
+        }
+
+        slot->timers = timers;
+        slot->cap = cap;
+    }
+
+    slot->timers[slot->count++] = timer;
+    wheel->pending++;
+
+    return 0;
+}
+
+/// @brief Move the timers of an upper level slot that came due down the wheel.
+static void wheel_cascade (struct htable_wheel *wheel, unsigned int level, size_t idx) {
+
+    struct wheel_slot due = wheel->slots[level][idx];
+
+    // Detach the timers first, some of them may land in the very same slot again.
+    wheel->slots[level][idx] = (struct wheel_slot) { 0 };
+    wheel->pending -= due.count;
+
+    for (size_t pos = 0; pos < due.count; pos++) {
+        // The timers already own a slot entry, moving them only fails if no array can grow.
+        // Such a timer is dropped and its entry expires lazily.
+        (void) wheel_add(wheel, due.timers[pos]);
+    }
+
+    free(due.timers);
+}
+
+/// @brief Free the expired hash nodes with the hash in one bucket.
+static size_t expire_chain (htable_t *table, struct htable_node **link, unsigned long hash, unsigned long long tick) {
+
+    size_t freed = 0;
+
+    while (*link != NULL) {
+
+        struct htable_node *node = *link;
+
+        if (node->hash != hash || !htable_ttl_due(node->expires, tick)) {
+            link = &node->next;
+            continue;
+        }
+
+        *link = node->next;
+        table->count--;
+
+        htable_free_node(table, node);
+        freed++;
+    }
+
+    return freed;
+}
+
+/// @brief Free the expired hash nodes with the hash, in both bucket arrays while a migration is in progress.
+static size_t expire_hash (htable_t *table, unsigned long hash, unsigned long long tick) {
+
+    // Expired entries wait for a later tick or write if the bucket cannot be copied into the snapshots.
+    if (htable_cow(table, hash) != 0) {
+        return 0;
+    }
+
+    size_t freed = expire_chain(table, &table->table[htable_bucket_index(table, hash, table->size)], hash, tick);
+
+    if (table->rehash_table != NULL && htable_bucket_index(table, hash, table->rehash_size) >= table->rehash_idx) {
+        freed += expire_chain(table, &table->rehash_table[htable_bucket_index(table, hash, table->rehash_size)], hash, tick);
+    }
+
+    return freed;
+}
+
+/// @brief Process one tick of the timing wheel.
+/// @return The number of hash nodes freed.
+static size_t wheel_tick (htable_t *table, unsigned long long tick) {
+
+    struct htable_wheel *wheel = table->wheel;
+
+    // Every upper level slot whose span starts at this tick comes due.
+    for (unsigned int level = 1; level < WHEEL_LEVELS && (tick & ((1ULL << (WHEEL_BITS * level)) - 1U)) == 0; level++) {
+        wheel_cascade(wheel, level, (size_t) (tick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    }
+
+    struct wheel_slot *slot = &wheel->slots[0][tick & WHEEL_MASK];
+    size_t freed = 0;
+
+    // Timers of refreshed or removed keys find no node that is due, they are simply dropped.
+    for (size_t pos = 0; pos < slot->count; pos++) {
+        freed += expire_hash(table, slot->timers[pos].hash, tick);
+    }
+
+    wheel->pending -= slot->count;
+    slot->count = 0;
+
+    return freed;
+}
+
+// --- Function Definitions --- //
+
+/// @brief Read the current tick of the timing wheel.
+unsigned long long htable_ttl_now (const htable_t *table) {
+    return (now_ns() - table->wheel->epoch_ns) / 1000000ULL;
+}
+
+/// @brief Schedule the expiry of a key, creating the timing wheel on first use.
+int htable_ttl_schedule (htable_t *table, unsigned long hash, unsigned long long ttl_ms, unsigned long long *expires) {
+
+    if (table->wheel == NULL) {
+        if ((table->wheel = calloc(1U, sizeof(*table->wheel))) == NULL) {
+            return -2;
+        }
+
+        table->wheel->epoch_ns = now_ns();
+    }
+
+    // The time to live is at least one tick, so the deadline is never the 0 of entries that do not expire.
+    const unsigned long long deadline = htable_ttl_now(table) + ttl_ms;
+
+    if (wheel_add(table->wheel, (struct wheel_timer) { .hash = hash, .deadline = deadline }) != 0) {
+        return -2;
+    }
+
+    *expires = deadline;
+
+    return 0;
+}
+
+/// @brief Schedule every hash node with an expiry tick again.
+int htable_ttl_reschedule (htable_t *table) {
+
+    struct htable_wheel *wheel = table->wheel;
+
+    if (wheel == NULL) {
+        return 0;
+    }
+
+    // Drop the timers with the previous hashes, keeping the arrays for the new ones.
+    for (unsigned int level = 0; level < WHEEL_LEVELS; level++) {
+        for (size_t idx = 0; idx < WHEEL_SLOTS; idx++) {
+            wheel->slots[level][idx].count = 0;
+        }
+    }
+
+    wheel->pending = 0;
+
+    int rc = 0;
+
+    for (size_t idx = 0; idx < table->size; idx++) {
+        for (struct htable_node *node = table->table[idx]; node != NULL; node = node->next) {
+
+            if (node->expires == 0) {
+                continue;
+            }
+
+            // Entries already due are expired at the next tick.
+            if (wheel_add(wheel, (struct wheel_timer) { .hash = node->hash, .deadline = node->expires }) != 0) {
+                rc = -2;
+            }
+        }
+    }
+
+    return rc;
+}
+
+/// @brief Free the timing wheel of a hash table.
+void htable_ttl_destroy (htable_t *table) {
+
+    if (table->wheel == NULL) {
+        return;
+    }
+
+    for (unsigned int level = 0; level < WHEEL_LEVELS; level++) {
+        for (size_t idx = 0; idx < WHEEL_SLOTS; idx++) {
+            free(table->wheel->slots[level][idx].timers);
+        }
+    }
+
+    free(table->wheel);
+    table->wheel = NULL;
+}
+
+/// @brief Free every entry whose time to live has passed.
+size_t htable_expire (htable_t *table) {
+
+    if (table == NULL || table->table == NULL || table->wheel == NULL) {
+        return 0;
+    }
+
+    struct htable_wheel *wheel = table->wheel;
+    const unsigned long long now = htable_ttl_now(table);
+    size_t freed = 0;
+
+    for (; wheel->tick <= now; wheel->tick++) {
+
+        // An empty wheel has nothing to cascade, so the idle ticks are skipped at once.
+        if (wheel->pending == 0) {
+            wheel->tick = now + 1U;
+            break;
+        }
+
+        freed += wheel_tick(table, wheel->tick);
+    }
+
+    return freed;
+}
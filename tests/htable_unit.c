@@ -30,10 +30,23 @@
 // SOFTWARE.
 // ==============================================================================
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "htable.h"
+#include "htable_conc.h"
+#include "htable_hash.h"
+#include "htable_part.h"
+#include "htable_rcu.h"
+#include "htable_shard.h"
+#include "htable_tmpl.h"
 
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 static int passed;          /* number of passing tests */
 static int test_index;     /* ordinal of current test */
@@ -83,11 +96,11 @@ unsigned long hash_string (const void *key) {
 // --- Comparison functions for integer and string keys --- //
 
 int compare_int (const void *key1, const void *key2) {
-    return *(int *) key1 - *(int *) key2;
+    return *(int *) key1 == *(int *) key2;
 }
 
 int compare_string (const void *key1, const void *key2) {
-    return strcmp((const char *) key1, (const char *) key2);
+    return strcmp((const char *) key1, (const char *) key2) == 0;
 }
 
 // --- Unit tests for hash table functions --- //
@@ -96,7 +109,7 @@ int compare_string (const void *key1, const void *key2) {
 
 void test_htable_create (void) {
 
-    htable_t *map = htable_create(HASH_MAX, NULL, NULL, NULL);
+    htable_t *map = htable_create(HASH_MAX, hash_int, compare_int, NULL);
 
     TEST(map != NULL); // 1
     TEST(map->table != NULL); // 2
@@ -123,16 +136,16 @@ void test_htable_insert_int (void) {
 
 void test_htable_insert_string (void) {
 
-    htable_t *map = htable_create(1, hash_string, strcmp, NULL);
+    htable_t *map = htable_create(1, hash_string, compare_string, NULL);
 
     char *key = "hello";
     char *value = "world";
 
-    TEST(htable_insert(map, &key, &value) == 0); // 1
+    TEST(htable_insert(map, key, value) == 0); // 1
 
-    int *result = htable_get(map, &key);
+    char *result = htable_get(map, key);
 
-    TEST(*result == value); // 2
+    TEST(result == value); // 2
 
     htable_destroy(map);
 }
@@ -191,6 +204,2099 @@ void test_htable_collision_string (void) {
     htable_destroy(map);
 }
 
+void test_htable_resize_int (void) {
+
+    htable_t *map = htable_create(4, hash_int, compare_int, NULL);
+
+    static int keys[HASH_MAX];
+    int found = 0;
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        keys[i] = i;
+        (void) htable_insert(map, &keys[i], &keys[i]);
+    }
+
+    TEST(map->count == HASH_MAX); // 1
+    TEST(map->size >= HASH_MAX); // 2
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        int *result = htable_get(map, &keys[i]);
+        found += result != NULL && *result == i;
+    }
+
+    TEST(found == HASH_MAX); // 3
+    TEST(map->rehash_table == NULL); // 4
+
+    for (int i = 0; i < HASH_MAX; i += 2) {
+        (void) htable_remove(map, &keys[i]);
+    }
+
+    TEST(map->count == HASH_MAX / 2); // 5
+    TEST(htable_get(map, &keys[0]) == NULL); // 6
+    TEST(*(int *) htable_get(map, &keys[1]) == 1); // 7
+
+    htable_destroy(map);
+}
+
+void test_htable_fixed_size (void) {
+
+    struct htable_opts opts = { .flags = HTABLE_FIXED_SIZE };
+    htable_t *map = htable_create_ex(2, hash_int, compare_int, NULL, &opts);
+
+    static int keys[16];
+
+    for (int i = 0; i < 16; i++) {
+        keys[i] = i;
+        (void) htable_insert(map, &keys[i], &keys[i]);
+    }
+
+    TEST(map->size == 2); // 1
+    TEST(map->count == 16); // 2
+    TEST(*(int *) htable_get(map, &keys[15]) == 15); // 3
+
+    htable_destroy(map);
+}
+
+static int hash_calls;
+static int keq_calls;
+
+unsigned long hash_int_counted (const void *key) {
+    hash_calls++;
+    return hash_int(key);
+}
+
+int compare_int_counted (const void *key1, const void *key2) {
+    keq_calls++;
+    return compare_int(key1, key2);
+}
+
+void test_htable_cached_hash (void) {
+
+    htable_t *map = htable_create(1, hash_int_counted, compare_int_counted, NULL);
+
+    static int keys[64];
+    int missing = 64;
+
+    hash_calls = 0;
+
+    for (int i = 0; i < 64; i++) {
+        keys[i] = i;
+        (void) htable_insert(map, &keys[i], &keys[i]);
+    }
+
+    TEST(hash_calls == 64); // 1 (rehashing reuses the stored hashes)
+
+    keq_calls = 0;
+
+    TEST(htable_get(map, &missing) == NULL); // 2
+    TEST(keq_calls == 0); // 3
+    TEST(*(int *) htable_get(map, &keys[7]) == 7); // 4
+    TEST(keq_calls == 1); // 5
+
+    htable_destroy(map);
+}
+
+unsigned long hash_int_clustered (const void *key) {
+    return *(int *) key / 8;
+}
+
+void test_htable_robin_hood (void) {
+
+    struct htable_opts opts = { .engine = HTABLE_ENGINE_ROBIN_HOOD };
+    htable_t *map = htable_create_ex(4, hash_int_clustered, compare_int, NULL, &opts);
+
+    static int keys[HASH_MAX];
+    int found = 0;
+    int missing = 0;
+
+    TEST(map != NULL); // 1
+    TEST(map->slots != NULL); // 2
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        keys[i] = i;
+        (void) htable_insert(map, &keys[i], &keys[i]);
+    }
+
+    TEST(map->count == HASH_MAX); // 3
+    TEST((float) map->count <= map->max_load * (float) map->size); // 4
+
+    // Removing every other key exercises the backward-shift deletion.
+    for (int i = 0; i < HASH_MAX; i += 2) {
+        (void) htable_remove(map, &keys[i]);
+    }
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        int *result = htable_get(map, &keys[i]);
+        found += result != NULL && *result == i;
+        missing += result == NULL;
+    }
+
+    TEST(map->count == HASH_MAX / 2); // 5
+    TEST(found == HASH_MAX / 2); // 6
+    TEST(missing == HASH_MAX / 2); // 7
+    TEST(htable_remove(map, &keys[0]) == -1); // 8
+    TEST(htable_insert(map, &keys[1], &keys[3]) == 0); // 9
+    TEST(*(int *) htable_get(map, &keys[1]) == 3); // 10
+
+    htable_destroy(map);
+}
+
+void test_htable_robin_hood_full (void) {
+
+    struct htable_opts opts = { .engine = HTABLE_ENGINE_ROBIN_HOOD, .flags = HTABLE_FIXED_SIZE };
+    htable_t *map = htable_create_ex(8, hash_int, compare_int, NULL, &opts);
+
+    static int keys[8];
+    int inserted = 0;
+
+    for (int i = 0; i < 8; i++) {
+        keys[i] = i;
+        inserted += htable_insert(map, &keys[i], &keys[i]) == 0;
+    }
+
+    TEST(map->size == 8); // 1
+    TEST(inserted == 7); // 2
+    TEST(htable_insert(map, &keys[7], &keys[7]) == -2); // 3
+    TEST(htable_insert(map, &keys[0], &keys[1]) == 0); // 4
+
+    htable_destroy(map);
+
+    opts.max_load = 1.0f;
+
+    TEST(htable_create_ex(8, hash_int, compare_int, NULL, &opts) == NULL); // 5
+}
+
+void test_htable_swiss (void) {
+
+    struct htable_opts opts = { .engine = HTABLE_ENGINE_SWISS };
+    htable_t *map = htable_create_ex(4, hash_int_clustered, compare_int, NULL, &opts);
+
+    static int keys[HASH_MAX];
+    int found = 0;
+    int missing = 0;
+
+    TEST(map != NULL); // 1
+    TEST(map->ctrl != NULL); // 2
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        keys[i] = i;
+        (void) htable_insert(map, &keys[i], &keys[i]);
+    }
+
+    TEST(map->count == HASH_MAX); // 3
+
+    for (int i = 0; i < HASH_MAX; i += 2) {
+        (void) htable_remove(map, &keys[i]);
+    }
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        int *result = htable_get(map, &keys[i]);
+        found += result != NULL && *result == i;
+        missing += result == NULL;
+    }
+
+    TEST(map->count == HASH_MAX / 2); // 4
+    TEST(found == HASH_MAX / 2); // 5
+    TEST(missing == HASH_MAX / 2); // 6
+
+    // Churn through the removed keys so tombstones are reused and purged.
+    for (int round = 0; round < 8; round++) {
+        for (int i = 0; i < HASH_MAX; i += 2) {
+            (void) htable_insert(map, &keys[i], &keys[i]);
+        }
+        for (int i = 0; i < HASH_MAX; i += 2) {
+            (void) htable_remove(map, &keys[i]);
+        }
+    }
+
+    found = 0;
+
+    for (int i = 1; i < HASH_MAX; i += 2) {
+        int *result = htable_get(map, &keys[i]);
+        found += result != NULL && *result == i;
+    }
+
+    TEST(found == HASH_MAX / 2); // 7
+    TEST(map->count + map->tombstones < map->size); // 8
+    TEST(htable_get(map, &keys[0]) == NULL); // 9
+
+    htable_destroy(map);
+}
+
+static int alloc_calls;
+static int dealloc_calls;
+
+void *counting_alloc (void *ctx, size_t size) {
+    (void) ctx;
+    alloc_calls++;
+    return malloc(size);
+}
+
+void counting_dealloc (void *ctx, void *ptr, size_t size) {
+    (void) ctx;
+    (void) size;
+    dealloc_calls++;
+    free(ptr);
+}
+
+void test_htable_slab (void) {
+
+    htable_slab_t *slab = htable_slab_create(sizeof(struct htable_node), 4);
+
+    void *first = htable_slab_alloc(slab);
+    void *second = htable_slab_alloc(slab);
+
+    TEST(first != NULL && second != NULL && first != second); // 1
+
+    htable_slab_free(slab, first);
+
+    TEST(htable_slab_alloc(slab) == first); // 2 (freed objects are recycled)
+
+    int carved = 0;
+
+    // Spans several chunks of four objects.
+    for (int i = 0; i < 16; i++) {
+        carved += htable_slab_alloc(slab) != NULL;
+    }
+
+    TEST(carved == 16); // 3
+
+    htable_slab_destroy(slab);
+
+    struct htable_opts opts = { .flags = HTABLE_SLAB };
+    htable_t *map = htable_create_ex(4, hash_int, compare_int, NULL, &opts);
+
+    static int keys[HASH_MAX];
+    int found = 0;
+
+    TEST(map != NULL && map->slab != NULL); // 4
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        keys[i] = i;
+        (void) htable_insert(map, &keys[i], &keys[i]);
+    }
+
+    for (int i = 0; i < HASH_MAX; i += 2) {
+        (void) htable_remove(map, &keys[i]);
+    }
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        int *result = htable_get(map, &keys[i]);
+        found += result != NULL && *result == i;
+    }
+
+    TEST(found == HASH_MAX / 2); // 5
+
+    htable_destroy(map);
+}
+
+void test_htable_allocator (void) {
+
+    const struct htable_allocator allocator = { .alloc = counting_alloc, .free = counting_dealloc };
+    struct htable_opts opts = { .allocator = &allocator };
+    htable_t *map = htable_create_ex(4, hash_int, compare_int, NULL, &opts);
+
+    static int keys[32];
+
+    alloc_calls = 0;
+    dealloc_calls = 0;
+
+    for (int i = 0; i < 32; i++) {
+        keys[i] = i;
+        (void) htable_insert(map, &keys[i], &keys[i]);
+    }
+
+    (void) htable_remove(map, &keys[3]);
+
+    TEST(alloc_calls == 32); // 1
+    TEST(dealloc_calls == 1); // 2
+
+    htable_destroy(map);
+
+    TEST(dealloc_calls == 32); // 3
+}
+
+static size_t longest_chain (const htable_t *map) {
+
+    size_t longest = 0;
+
+    for (size_t idx = 0; idx < map->size; idx++) {
+        size_t length = 0;
+        for (const struct htable_node *node = map->table[idx]; node != NULL; node = node->next) {
+            length++;
+        }
+        longest = length > longest ? length : longest;
+    }
+
+    return longest;
+}
+
+void test_htable_pow2_mix (void) {
+
+    struct htable_opts opts = { .flags = HTABLE_POW2 | HTABLE_FIXED_SIZE };
+    htable_t *map = htable_create_ex(1000, hash_int, compare_int, NULL, &opts);
+
+    static int keys[64];
+
+    TEST(map->size == 1024); // 1
+
+    // Multiples of the bucket count all land in bucket zero under a bare mask.
+    for (int i = 0; i < 64; i++) {
+        keys[i] = i * 1024;
+        (void) htable_insert(map, &keys[i], &keys[i]);
+    }
+
+    TEST(longest_chain(map) == 64); // 2
+
+    htable_destroy(map);
+
+    opts.flags |= HTABLE_MIX_HASH;
+    map = htable_create_ex(1000, hash_int, compare_int, NULL, &opts);
+
+    for (int i = 0; i < 64; i++) {
+        (void) htable_insert(map, &keys[i], &keys[i]);
+    }
+
+    TEST(longest_chain(map) <= 4); // 3
+    TEST(*(int *) htable_get(map, &keys[63]) == 63 * 1024); // 4
+    TEST(htable_remove(map, &keys[10]) == 0); // 5
+    TEST(htable_get(map, &keys[10]) == NULL); // 6
+
+    htable_destroy(map);
+}
+
+void test_htable_batch (void) {
+
+    const enum htable_engine engines[] = { HTABLE_ENGINE_CHAIN, HTABLE_ENGINE_ROBIN_HOOD, HTABLE_ENGINE_SWISS, HTABLE_ENGINE_COMPACT };
+
+    static int keys[HASH_MAX];
+    static const void *key_ptrs[HASH_MAX + 1];
+    static void *values[HASH_MAX + 1];
+
+    int missing = -1;
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        keys[i] = i;
+        key_ptrs[i] = &keys[i];
+    }
+
+    key_ptrs[HASH_MAX] = &missing;
+
+    for (size_t e = 0; e < sizeof(engines) / sizeof(*engines); e++) {
+
+        struct htable_opts opts = { .engine = engines[e] };
+        htable_t *map = htable_create_ex(4, hash_int, compare_int, NULL, &opts);
+
+        int matched = 0;
+
+        TEST(htable_insert_many(map, key_ptrs, (const void *const *) key_ptrs, HASH_MAX) == 0); // 1, 4, 7, 10
+        TEST(htable_get_many(map, key_ptrs, HASH_MAX + 1, values) == HASH_MAX); // 2, 5, 8, 11
+
+        for (int i = 0; i < HASH_MAX; i++) {
+            matched += values[i] == &keys[i];
+        }
+
+        TEST(matched == HASH_MAX && values[HASH_MAX] == NULL); // 3, 6, 9, 12
+
+        htable_destroy(map);
+    }
+}
+
+#define CONC_THREADS 4
+#define CONC_KEYS 4096
+
+static int conc_keys[CONC_THREADS * CONC_KEYS];
+
+struct conc_args {
+    htable_conc_t *map;
+    int thread;
+    int found;
+};
+
+void *conc_writer (void *arg) {
+
+    struct conc_args *args = arg;
+
+    for (int i = 0; i < CONC_KEYS; i++) {
+        int *key = &conc_keys[args->thread * CONC_KEYS + i];
+        (void) htable_conc_insert(args->map, key, key);
+    }
+
+    // Remove every fourth key again while the other writers are still growing the stripes.
+    for (int i = 0; i < CONC_KEYS; i += 4) {
+        (void) htable_conc_remove(args->map, &conc_keys[args->thread * CONC_KEYS + i]);
+    }
+
+    return NULL;
+}
+
+void *conc_reader (void *arg) {
+
+    struct conc_args *args = arg;
+
+    for (int i = 0; i < CONC_THREADS * CONC_KEYS; i++) {
+        int *result = htable_conc_get(args->map, &conc_keys[i]);
+        args->found += result != NULL && *result == i;
+    }
+
+    return NULL;
+}
+
+void test_htable_conc (void) {
+
+    struct htable_opts opts = { .flags = HTABLE_SLAB };
+    htable_conc_t *map = htable_conc_create(16, 8, hash_int, compare_int, NULL, &opts);
+
+    pthread_t writers[CONC_THREADS];
+    pthread_t readers[CONC_THREADS];
+    struct conc_args args[CONC_THREADS * 2];
+
+    int found = 0;
+
+    TEST(map != NULL); // 1
+
+    for (int i = 0; i < CONC_THREADS * CONC_KEYS; i++) {
+        conc_keys[i] = i;
+    }
+
+    for (int t = 0; t < CONC_THREADS; t++) {
+        args[t] = (struct conc_args) { .map = map, .thread = t };
+        args[CONC_THREADS + t] = (struct conc_args) { .map = map, .thread = t };
+        (void) pthread_create(&writers[t], NULL, conc_writer, &args[t]);
+        (void) pthread_create(&readers[t], NULL, conc_reader, &args[CONC_THREADS + t]);
+    }
+
+    for (int t = 0; t < CONC_THREADS; t++) {
+        (void) pthread_join(writers[t], NULL);
+        (void) pthread_join(readers[t], NULL);
+    }
+
+    for (int i = 0; i < CONC_THREADS * CONC_KEYS; i++) {
+        int *result = htable_conc_get(map, &conc_keys[i]);
+        found += (i % 4 == 0) ? result == NULL : result != NULL && *result == i;
+    }
+
+    TEST(htable_conc_count(map) == CONC_THREADS * CONC_KEYS * 3 / 4); // 2
+    TEST(found == CONC_THREADS * CONC_KEYS); // 3
+
+    htable_conc_destroy(map);
+}
+
+void *copy_int (const void *src) {
+
+    int *copy = malloc(sizeof(*copy));
+
+    if (copy != NULL) {
+        *copy = *(const int *) src;
+    }
+
+    return copy;
+}
+
+#define RCU_KEYS 512
+
+static int rcu_keys[RCU_KEYS];
+static atomic_int rcu_stop;
+
+struct rcu_args {
+    htable_rcu_t *map;
+    int wrong;
+};
+
+void *rcu_reader (void *arg) {
+
+    struct rcu_args *args = arg;
+    htable_rcu_reader_t *reader = htable_rcu_register(args->map);
+
+    while (!atomic_load(&rcu_stop)) {
+        for (int i = 0; i < RCU_KEYS; i++) {
+            htable_rcu_read_lock(reader);
+
+            // Values are owned by the table, dereferencing a freed one trips the sanitizers.
+            int *result = htable_rcu_get(args->map, &rcu_keys[i]);
+            args->wrong += result != NULL && *result % RCU_KEYS != i;
+
+            htable_rcu_read_unlock(reader);
+        }
+    }
+
+    htable_rcu_unregister(reader);
+
+    return NULL;
+}
+
+void test_htable_rcu (void) {
+
+    const struct callbacks cbs = { .vcpy = copy_int, .vfree = free };
+    htable_rcu_t *map = htable_rcu_create(2, hash_int, compare_int, &cbs, NULL);
+
+    pthread_t readers[CONC_THREADS];
+    struct rcu_args args[CONC_THREADS];
+
+    int found = 0;
+
+    TEST(map != NULL); // 1
+
+    for (int i = 0; i < RCU_KEYS; i++) {
+        rcu_keys[i] = i;
+    }
+
+    atomic_store(&rcu_stop, 0);
+
+    for (int t = 0; t < CONC_THREADS; t++) {
+        args[t] = (struct rcu_args) { .map = map };
+        (void) pthread_create(&readers[t], NULL, rcu_reader, &args[t]);
+    }
+
+    // Grow, replace and remove while the readers are walking the chains.
+    for (int round = 0; round < 16; round++) {
+        for (int i = 0; i < RCU_KEYS; i++) {
+            int value = i + round * RCU_KEYS;
+            (void) htable_rcu_insert(map, &rcu_keys[i], &value);
+        }
+        for (int i = round % 2; i < RCU_KEYS; i += 2) {
+            (void) htable_rcu_remove(map, &rcu_keys[i]);
+        }
+    }
+
+    atomic_store(&rcu_stop, 1);
+
+    for (int t = 0; t < CONC_THREADS; t++) {
+        (void) pthread_join(readers[t], NULL);
+        found += args[t].wrong;
+    }
+
+    TEST(found == 0); // 2
+    TEST(htable_rcu_count(map) == RCU_KEYS / 2); // 3
+
+    htable_rcu_reader_t *reader = htable_rcu_register(map);
+
+    htable_rcu_read_lock(reader);
+    TEST(htable_rcu_get(map, &rcu_keys[0]) != NULL); // 4
+    TEST(htable_rcu_get(map, &rcu_keys[1]) == NULL); // 5
+    htable_rcu_read_unlock(reader);
+
+    htable_rcu_unregister(reader);
+    htable_rcu_synchronize(map);
+    htable_rcu_destroy(map);
+}
+
+static inline unsigned long hash_tmpl (int key) {
+    return (unsigned long) key;
+}
+
+#define EQ_TMPL(a, b) ((a) == (b))
+
+HTABLE_DEFINE(imap, int, long, hash_tmpl, EQ_TMPL)
+
+void test_htable_tmpl (void) {
+
+    imap_t *map = imap_create(4);
+
+    int found = 0;
+
+    TEST(map != NULL && map->size == 8); // 1
+
+    for (int i = 0; i < HASH_MAX * 4; i++) {
+        found += imap_insert(map, i, (long) i * 3) == 0;
+    }
+
+    TEST(found == HASH_MAX * 4 && imap_count(map) == HASH_MAX * 4); // 2
+    TEST(imap_count(map) * HTABLE_TMPL_LOAD_DEN <= map->size * HTABLE_TMPL_LOAD_NUM); // 3
+
+    // Overwriting keeps the count, removing every other key shifts the survivors back.
+    (void) imap_insert(map, 7, -1);
+
+    for (int i = 0; i < HASH_MAX * 4; i += 2) {
+        (void) imap_remove(map, i);
+    }
+
+    found = 0;
+
+    for (int i = 0; i < HASH_MAX * 4; i++) {
+        long *value = imap_get(map, i);
+        found += i % 2 == 0 ? value == NULL : value != NULL && *value == (i == 7 ? -1 : (long) i * 3);
+    }
+
+    TEST(found == HASH_MAX * 4); // 4
+    TEST(imap_count(map) == HASH_MAX * 2); // 5
+    TEST(imap_remove(map, 0) == -1); // 6
+
+    imap_destroy(map);
+}
+
+static int copy_calls;
+
+void *copy_string_counted (const void *src) {
+    copy_calls++;
+    return strdup(src);
+}
+
+size_t size_string (const void *src) {
+    return strlen(src) + 1U;
+}
+
+size_t size_int (const void *src) {
+    (void) src;
+    return sizeof(int);
+}
+
+const struct htable_node *find_node (const htable_t *map, const char *key) {
+
+    // Search both bucket arrays, the table may be in the middle of a rehash.
+    for (size_t idx = 0; idx < map->size + map->rehash_size; idx++) {
+        const struct htable_node *node = idx < map->size ? map->table[idx] : map->rehash_table[idx - map->size];
+
+        for (; node != NULL; node = node->next) {
+            if (strcmp(node->key, key) == 0) {
+                return node;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+void test_htable_inline (void) {
+
+    const struct callbacks cbs = {
+        .kcpy = copy_string_counted, .vcpy = copy_int, .kfree = free, .vfree = free,
+        .ksize = size_string, .vsize = size_int,
+    };
+
+    struct htable_opts opts = { .inline_size = 16, .flags = HTABLE_SLAB };
+    htable_t *map = htable_create_ex(2, hash_string, compare_string, &cbs, &opts);
+
+    char keys[HASH_MAX][32];
+    int found = 0;
+
+    TEST(map != NULL && map->inline_size == 16); // 1
+
+    // Every fourth key is too long to be stored inline and goes through the copy callback.
+    copy_calls = 0;
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        (void) snprintf(keys[i], sizeof(keys[i]), i % 4 == 0 ? "session:long:%08d" : "s:%d", i);
+        (void) htable_insert(map, keys[i], &i);
+    }
+
+    TEST(copy_calls == HASH_MAX / 4); // 2
+
+    const struct htable_node *node = find_node(map, keys[1]);
+
+    TEST(node != NULL && node->key == (void *) node->data && htable_get(map, keys[1]) == node->data + 16); // 3
+
+    // Overwrite, remove and look up while the table is being rehashed.
+    for (int i = 0; i < HASH_MAX; i += 2) {
+        const int value = -i;
+        (void) htable_insert(map, keys[i], &value);
+        (void) htable_remove(map, keys[i + 1]);
+    }
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        int *value = htable_get(map, keys[i]);
+        found += i % 2 == 0 ? value != NULL && *value == -i : value == NULL;
+    }
+
+    TEST(found == HASH_MAX); // 4
+    TEST(map->count == HASH_MAX / 2); // 5
+
+    // Inline storage is only available to the chaining engine.
+    opts.engine = HTABLE_ENGINE_SWISS;
+    TEST(htable_create_ex(2, hash_string, compare_string, &cbs, &opts) == NULL); // 6
+
+    htable_destroy(map);
+}
+
+#define BUILD_KEYS (HASH_MAX * 64)
+
+static int build_keys[BUILD_KEYS];
+
+void test_htable_build (void) {
+
+    static const void *key_ptrs[BUILD_KEYS + 2];
+    static const void *value_ptrs[BUILD_KEYS + 2];
+
+    for (int i = 0; i < BUILD_KEYS; i++) {
+        build_keys[i] = i;
+        key_ptrs[i] = &build_keys[i];
+        value_ptrs[i] = &build_keys[BUILD_KEYS - 1 - i];
+    }
+
+    // Two trailing duplicates, the later pair wins.
+    key_ptrs[BUILD_KEYS] = &build_keys[5];
+    value_ptrs[BUILD_KEYS] = &build_keys[0];
+    key_ptrs[BUILD_KEYS + 1] = &build_keys[5];
+    value_ptrs[BUILD_KEYS + 1] = &build_keys[1];
+
+    htable_t *map = htable_build(key_ptrs, value_ptrs, BUILD_KEYS + 2, hash_int, compare_int, NULL, NULL);
+
+    int found = 0;
+    int adjacent = 1;
+
+    TEST(map != NULL && map->count == BUILD_KEYS); // 1
+    TEST(map->size > BUILD_KEYS && map->rehash_table == NULL); // 2
+
+    for (int i = 0; i < BUILD_KEYS; i++) {
+        int *value = htable_get(map, &build_keys[i]);
+        found += value != NULL && *value == (i == 5 ? 1 : BUILD_KEYS - 1 - i);
+    }
+
+    TEST(found == BUILD_KEYS); // 3
+
+    // Consecutive buckets were carved back to back out of one chunk.
+    const struct htable_node *prev = NULL;
+
+    for (size_t idx = 0; idx < map->size; idx++) {
+        for (const struct htable_node *node = map->table[idx]; node != NULL; node = node->next) {
+            adjacent &= prev == NULL || (const char *) node - (const char *) prev == (ptrdiff_t) map->slab->obj_size;
+            prev = node;
+        }
+    }
+
+    TEST(adjacent); // 4
+
+    // The table keeps working as a regular one.
+    TEST(htable_remove(map, &build_keys[7]) == 0 && htable_insert(map, &build_keys[7], &build_keys[7]) == 0); // 5
+    TEST(*(int *) htable_get(map, &build_keys[7]) == 7); // 6
+
+    htable_destroy(map);
+
+    // Unique keys and the open-addressing engines.
+    struct htable_opts opts = { .flags = HTABLE_UNIQUE_KEYS | HTABLE_POW2 };
+    map = htable_build(key_ptrs, value_ptrs, BUILD_KEYS, hash_int, compare_int, NULL, &opts);
+
+    TEST(map != NULL && map->count == BUILD_KEYS && *(int *) htable_get(map, &build_keys[0]) == BUILD_KEYS - 1); // 7
+
+    htable_destroy(map);
+
+    opts = (struct htable_opts) { .engine = HTABLE_ENGINE_SWISS };
+    map = htable_build(key_ptrs, value_ptrs, BUILD_KEYS + 2, hash_int, compare_int, NULL, &opts);
+
+    TEST(map != NULL && map->count == BUILD_KEYS && *(int *) htable_get(map, &build_keys[5]) == 1); // 8
+
+    htable_destroy(map);
+
+    // Building never evicts, so a capacity-bounded table is only built from pairs that fit.
+    opts = (struct htable_opts) { .flags = HTABLE_UNIQUE_KEYS, .capacity = BUILD_KEYS - 1 };
+    TEST(htable_build(key_ptrs, value_ptrs, BUILD_KEYS, hash_int, compare_int, NULL, &opts) == NULL); // 9
+
+    opts.capacity = BUILD_KEYS;
+    map = htable_build(key_ptrs, value_ptrs, BUILD_KEYS, hash_int, compare_int, NULL, &opts);
+
+    TEST(map != NULL && map->count == BUILD_KEYS && htable_insert(map, &build_keys[0], &build_keys[0]) == 0 && map->count == BUILD_KEYS); // 10
+
+    htable_destroy(map);
+
+    value_ptrs[3] = NULL;
+    TEST(htable_build(key_ptrs, value_ptrs, BUILD_KEYS, hash_int, compare_int, NULL, NULL) == NULL); // 11
+}
+
+static void sleep_ms (long ms) {
+    const struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L };
+    (void) nanosleep(&ts, NULL);
+}
+
+void test_htable_image (void) {
+
+    const struct callbacks cbs = { .ksize = size_string, .vsize = size_int };
+    struct htable_opts opts = { .flags = HTABLE_MIX_HASH };
+    htable_t *map = htable_create_ex(16, hash_string, compare_string, &cbs, &opts);
+
+    static char keys[HASH_MAX][24];
+    static int values[HASH_MAX];
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        (void) snprintf(keys[i], sizeof(keys[i]), "image:%d", i);
+        values[i] = i * 7;
+        (void) htable_insert(map, keys[i], &values[i]);
+    }
+
+    char path[] = "/tmp/htable_image_XXXXXX";
+    const int fd = mkstemp(path);
+
+    TEST(fd >= 0 && htable_save(map, fd) == 0); // 1
+    (void) close(fd);
+    htable_destroy(map);
+
+    // The saved table is gone, every lookup below reads the mapping.
+    htable_t *image = htable_open_mmap(path, hash_string, compare_string);
+    int found = 0;
+
+    TEST(image != NULL && image->count == HASH_MAX); // 2
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        const int *value = htable_get(image, keys[i]);
+        found += value != NULL && *value == i * 7;
+    }
+
+    TEST(found == HASH_MAX); // 3
+    TEST(htable_get(image, "image:missing") == NULL); // 4
+    TEST(htable_insert(image, "image:new", &values[0]) == -1 && htable_remove(image, keys[0]) == -1); // 5
+
+    const void *batch[3] = { keys[1], "image:missing", keys[2] };
+    void *results[3];
+
+    TEST(htable_get_many(image, batch, 3, results) == 2 && *(int *) results[2] == 14); // 6
+
+    htable_destroy(image);
+
+    // Any engine can be saved, but only with the size callbacks.
+    opts.engine = HTABLE_ENGINE_SWISS;
+    map = htable_create_ex(16, hash_string, compare_string, &cbs, &opts);
+    (void) htable_insert(map, keys[3], &values[3]);
+
+    const int swiss_fd = open(path, O_WRONLY | O_TRUNC);
+    TEST(htable_save(map, swiss_fd) == 0); // 7
+    (void) close(swiss_fd);
+
+    map->cbs.vsize = NULL;
+    TEST(htable_save(map, 1) == -1); // 8
+    htable_destroy(map);
+
+    image = htable_open_mmap(path, hash_string, compare_string);
+    TEST(image != NULL && image->count == 1 && *(int *) htable_get(image, keys[3]) == 21); // 9
+    htable_destroy(image);
+
+    // Files that are not images are rejected.
+    FILE *file = fopen(path, "w");
+    (void) fputs("not a hash table image, just some text that is long enough for a header", file);
+    (void) fclose(file);
+
+    TEST(htable_open_mmap(path, hash_string, compare_string) == NULL); // 10
+
+    // Expired entries are left out of the image, and multimaps cannot be saved at all.
+    map = htable_create(16, hash_string, compare_string, &cbs);
+    (void) htable_insert_ttl(map, keys[4], &values[4], 1);
+    (void) htable_insert(map, keys[5], &values[5]);
+    sleep_ms(5);
+
+    const int ttl_fd = open(path, O_WRONLY | O_TRUNC);
+    TEST(htable_save(map, ttl_fd) == 0); // 11
+    (void) close(ttl_fd);
+    htable_destroy(map);
+
+    opts = (struct htable_opts) { .flags = HTABLE_MULTI };
+    map = htable_create_ex(16, hash_string, compare_string, &cbs, &opts);
+    TEST(map != NULL && htable_save(map, 1) == -1); // 12
+    htable_destroy(map);
+
+    image = htable_open_mmap(path, hash_string, compare_string);
+    TEST(image != NULL && image->count == 1 && htable_get(image, keys[4]) == NULL && *(int *) htable_get(image, keys[5]) == 35); // 13
+    htable_destroy(image);
+
+    // A corrupted key length whose padding wraps around ends the walk of its bucket, the single one here.
+    const uint64_t key_len = UINT64_MAX - 3U;
+    const int bad_fd = open(path, O_WRONLY);
+    TEST(pwrite(bad_fd, &key_len, sizeof(key_len), 64 + 3 * sizeof(uint64_t)) == (ssize_t) sizeof(key_len)); // 14
+    (void) close(bad_fd);
+
+    image = htable_open_mmap(path, hash_string, compare_string);
+    TEST(image != NULL && htable_get(image, keys[5]) == NULL); // 15
+    htable_destroy(image);
+
+    (void) unlink(path);
+}
+
+#define SCAN_KEYS (HASH_MAX * 4)
+
+static int scan_keys[SCAN_KEYS * 2];
+static unsigned char scan_seen[SCAN_KEYS * 2];
+
+void scan_mark (const void *key, void *value, void *ctx) {
+    (void) value;
+    (void) ctx;
+    scan_seen[*(const int *) key] = 1;
+}
+
+void scan_count (const void *key, void *value, void *ctx) {
+    (void) key;
+    (void) value;
+    atomic_fetch_add((atomic_int *) ctx, 1);
+}
+
+void test_htable_scan (void) {
+
+    const enum htable_engine engines[] = { HTABLE_ENGINE_CHAIN, HTABLE_ENGINE_CHAIN, HTABLE_ENGINE_SWISS };
+    const unsigned flags[] = { 0U, HTABLE_POW2, 0U };
+
+    for (int i = 0; i < SCAN_KEYS * 2; i++) {
+        scan_keys[i] = i;
+    }
+
+    for (int e = 0; e < 3; e++) {
+
+        struct htable_opts opts = { .engine = engines[e], .flags = flags[e] };
+        htable_t *map = htable_create_ex(3, hash_int, compare_int, NULL, &opts);
+
+        for (int i = 0; i < SCAN_KEYS; i++) {
+            (void) htable_insert(map, &scan_keys[i], &scan_keys[i]);
+        }
+
+        memset(scan_seen, 0, sizeof(scan_seen));
+
+        // The chaining engine keeps growing and rehashing between the calls, the others are left alone.
+        size_t cursor = 0;
+        int calls = 0;
+        int next = SCAN_KEYS;
+
+        do {
+            cursor = htable_scan(map, cursor, 2, scan_mark, NULL);
+            calls++;
+
+            if (engines[e] == HTABLE_ENGINE_CHAIN && next < SCAN_KEYS * 2) {
+                (void) htable_insert(map, &scan_keys[next], &scan_keys[next]);
+                next++;
+            }
+        } while (cursor != 0);
+
+        int missed = 0;
+
+        for (int i = 0; i < SCAN_KEYS; i++) {
+            missed += !scan_seen[i];
+        }
+
+        TEST(missed == 0 && calls > 1); // 1, 3, 5
+
+        atomic_int visited = 0;
+
+        TEST(htable_for_each_parallel(map, 4, scan_count, &visited) == 0 && (size_t) visited == map->count); // 2, 4, 6
+
+        htable_destroy(map);
+    }
+}
+
+void test_htable_stats (void) {
+
+    const enum htable_engine engines[] = { HTABLE_ENGINE_CHAIN, HTABLE_ENGINE_ROBIN_HOOD, HTABLE_ENGINE_SWISS };
+
+    for (int e = 0; e < 3; e++) {
+
+        struct htable_opts opts = { .engine = engines[e] };
+        htable_t *map = htable_create_ex(4, hash_int, compare_int, NULL, &opts);
+
+        static int keys[HASH_MAX * 2];
+
+        for (int i = 0; i < HASH_MAX * 2; i++) {
+            keys[i] = i;
+        }
+
+        for (int i = 0; i < HASH_MAX; i++) {
+            (void) htable_insert(map, &keys[i], &keys[i]);
+        }
+
+        // Every key once, half of them missing.
+        for (int i = 0; i < HASH_MAX * 2; i++) {
+            (void) htable_get(map, &keys[i]);
+        }
+
+        struct htable_stats stats;
+        const int rc = htable_stats(map, &stats);
+
+#if defined(HTABLE_STATS)
+        unsigned long long histogram = 0;
+
+        for (size_t idx = 0; idx < HTABLE_STATS_PROBES; idx++) {
+            histogram += stats.probes[idx];
+        }
+
+        TEST(rc == 0 && stats.lookups == HASH_MAX * 2); // 1, 5, 9
+        TEST(stats.hits == HASH_MAX && stats.misses == HASH_MAX); // 2, 6, 10
+        TEST(histogram == stats.searches && stats.keq_calls >= HASH_MAX && stats.avg_keq > 0.0); // 3, 7, 11
+        TEST(stats.resizes > 0); // 4, 8, 12
+#else
+        TEST(rc == -1 && map->stats == NULL); // 1, 2, 3 (built without HTABLE_STATS)
+#endif
+
+        htable_destroy(map);
+    }
+}
+
+HTABLE_DEFINE_HASH_FIXED(uuid, 16)
+
+void test_htable_hash (void) {
+
+    unsigned char buf[256];
+    unsigned long long state = 0x243F6A8885A308D3ULL;
+
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        buf[i] = (unsigned char) (state >> 56U);
+    }
+
+    // Flipping any input bit should flip about half of the output bits, at every length and code path.
+    double worst = 0.0;
+    int distinct_lengths = 1;
+
+    for (size_t len = 1; len <= 200; len++) {
+
+        const uint64_t base = htable_hash_bytes(buf, len, HTABLE_HASH_SEED);
+        unsigned long long flipped = 0;
+
+        for (size_t bit = 0; bit < len * 8U; bit++) {
+            buf[bit / 8U] ^= (unsigned char) (1U << (bit % 8U));
+            flipped += (unsigned long long) __builtin_popcountll(base ^ htable_hash_bytes(buf, len, HTABLE_HASH_SEED));
+            buf[bit / 8U] ^= (unsigned char) (1U << (bit % 8U));
+        }
+
+        const double avg = (double) flipped / (double) (len * 8U);
+        const double dev = avg > 32.0 ? avg - 32.0 : 32.0 - avg;
+
+        worst = dev < worst ? worst : dev;
+        distinct_lengths &= base != htable_hash_bytes(buf, len - 1U, HTABLE_HASH_SEED);
+    }
+
+    TEST(worst < 4.0); // 1 (average within 4 bits of 32)
+    TEST(distinct_lengths); // 2
+    TEST(htable_hash_bytes(buf, 40, 1) != htable_hash_bytes(buf, 40, 2)); // 3
+
+    // Integer and string keys plug into the table directly.
+    htable_t *map = htable_create(16, htable_hash_str, htable_keq_str, NULL);
+    static char keys[HASH_MAX][64];
+    int found = 0;
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        (void) snprintf(keys[i], sizeof(keys[i]), "user:%d:session:%032d", i, i * 31);
+        (void) htable_insert(map, keys[i], keys[i]);
+    }
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        found += htable_get(map, keys[i]) == keys[i];
+    }
+
+    TEST(found == HASH_MAX && longest_chain(map) <= 8); // 4
+
+    htable_destroy(map);
+
+    static uint64_t ints[HASH_MAX];
+    struct htable_opts opts = { .flags = HTABLE_POW2 };
+    map = htable_create_ex(HASH_MAX, htable_hash_u64, htable_keq_u64, NULL, &opts);
+
+    // Strided keys that collide under an identity hash with mask indexing.
+    for (int i = 0; i < HASH_MAX; i++) {
+        ints[i] = (uint64_t) i << 20U;
+        (void) htable_insert(map, &ints[i], &ints[i]);
+    }
+
+    TEST(longest_chain(map) <= 8 && htable_get(map, &ints[5]) == &ints[5]); // 5
+
+    htable_destroy(map);
+
+    // Length-prefixed strings compare their lengths, fixed-size keys their bytes.
+    static struct { uint32_t len; char data[8]; } abc = { 3, "abcdefg" }, abcd = { 4, "abcdefg" };
+
+    TEST(!htable_keq_lpstr(&abc, &abcd) && htable_hash_lpstr(&abc) == htable_hash_bytes("abc", 3, HTABLE_HASH_SEED)); // 6
+    TEST(htable_size_lpstr(&abcd) == sizeof(uint32_t) + 4U && htable_size_str("abc") == 4U); // 7
+    TEST(uuid_keq(buf, buf) && uuid_hash(buf) != uuid_hash(buf + 1)); // 8
+}
+
+// Hash every length-aware key to the same bucket, so only the length and bytes tell them apart.
+static unsigned long hash_n_const (const void *key, size_t len) {
+    (void) key;
+    (void) len;
+    return 42;
+}
+
+// Hash every plain key to the bucket of the length-aware keys above.
+static unsigned long hash_const (const void *key) {
+    (void) key;
+    return 42;
+}
+
+void test_htable_keys_n (void) {
+
+    // Binary keys with embedded NUL bytes, one a prefix of the other.
+    static const unsigned char bin[] = { 'a', 'b', 0, 'c', 0, 'd' };
+    static const char *values[] = { "four", "six", "two" };
+
+    htable_t *map = htable_create(4, hash_string, compare_string, NULL);
+
+    TEST(htable_insert_n(map, bin, 4, values[0]) == 0 && htable_insert_n(map, bin, 6, values[1]) == 0); // 1
+    TEST(htable_get_n(map, bin, 4) == values[0] && htable_get_n(map, bin, 6) == values[1] && htable_get_n(map, bin, 5) == NULL); // 2
+
+    // Every key collides, the stored lengths reject the candidates of the wrong length.
+    htable_destroy(map);
+
+    struct htable_opts opts = { .hash_n = hash_n_const, .inline_size = 8 };
+    map = htable_create_ex(4, hash_string, compare_string, NULL, &opts);
+
+    unsigned char key[8] = { 'a', 'b', 0, 'c', 0, 'd' };
+
+    (void) htable_insert_n(map, key, 2, values[2]);
+    (void) htable_insert_n(map, key, 4, values[0]);
+    (void) htable_insert_n(map, key, 6, values[1]);
+
+    // Short keys are copied inline, so the caller may reuse its buffer.
+    memset(key, 'x', sizeof(key));
+
+    TEST(htable_get_n(map, bin, 2) == values[2] && htable_get_n(map, bin, 4) == values[0] && map->count == 3); // 3
+    TEST(htable_remove_n(map, bin, 4) == 0 && htable_get_n(map, bin, 4) == NULL && htable_get_n(map, bin, 6) == values[1]); // 4
+
+    htable_destroy(map);
+
+    // Keys stay reachable while the table grows.
+    static char keys[1000][16];
+    int found = 0;
+    map = htable_create(1, hash_string, compare_string, NULL);
+
+    for (int i = 0; i < 1000; i++) {
+        (void) snprintf(keys[i], sizeof(keys[i]), "key-%d", i);
+        (void) htable_insert_n(map, keys[i], strlen(keys[i]), keys[i]);
+    }
+
+    for (int i = 0; i < 1000; i++) {
+        found += htable_get_n(map, keys[i], strlen(keys[i])) == keys[i];
+    }
+
+    TEST(found == 1000); // 5
+
+    htable_destroy(map);
+
+    // The open-addressing engines do not store key lengths.
+    opts = (struct htable_opts) { .engine = HTABLE_ENGINE_SWISS };
+    map = htable_create_ex(4, hash_string, compare_string, NULL, &opts);
+
+    TEST(htable_insert_n(map, bin, 4, values[0]) == -1 && htable_get_n(map, bin, 4) == NULL); // 6
+
+    htable_destroy(map);
+
+    // Plain keys store a length of 0, so an empty length-aware key would match them.
+    opts = (struct htable_opts) { .hash_n = hash_n_const };
+    map = htable_create_ex(4, hash_const, compare_string, NULL, &opts);
+
+    TEST(htable_insert(map, "plain", values[0]) == 0 && htable_insert_n(map, bin, 0, values[1]) == -1); // 7
+    TEST(htable_get_n(map, bin, 0) == NULL && htable_remove_n(map, bin, 0) == -1 && htable_get(map, "plain") == values[0]); // 8
+
+    htable_destroy(map);
+
+    // Keys past the inline storage are copied by length, a strdup(3) kcpy would stop at the embedded NUL byte.
+    static const char wide[] = "a key\0with an embedded NUL";
+    char probe[sizeof(wide)];
+    const struct callbacks cbs = { .kcpy = copy_string_counted, .kfree = free };
+
+    opts = (struct htable_opts) { .inline_size = 8 };
+    map = htable_create_ex(4, hash_string, compare_string, &cbs, &opts);
+    memcpy(probe, wide, sizeof(wide));
+    copy_calls = 0;
+
+    TEST(htable_insert_n(map, wide, sizeof(wide), values[0]) == 0 && copy_calls == 0 && htable_get_n(map, probe, sizeof(probe)) == values[0]); // 9
+
+    probe[sizeof(probe) - 2] = 'x';
+
+    TEST(htable_get_n(map, probe, sizeof(probe)) == NULL && htable_remove_n(map, wide, sizeof(wide)) == 0 && map->count == 0); // 10
+
+    htable_destroy(map);
+}
+
+// Count occurrences in place, a value of 3 is dropped from the table.
+static void count_update (void **value, void *ctx) {
+    *value = (void *) ((uintptr_t) *value + 1U);
+    *value = *value == (void *) (uintptr_t) 3U ? NULL : *value;
+    (void) ctx;
+}
+
+void test_htable_upsert (void) {
+
+    static int keys[64];
+    const enum htable_engine engines[] = { HTABLE_ENGINE_CHAIN, HTABLE_ENGINE_ROBIN_HOOD, HTABLE_ENGINE_SWISS };
+
+    for (int i = 0; i < 64; i++) {
+        keys[i] = i;
+    }
+
+    for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++) {
+
+        struct htable_opts opts = { .engine = engines[e] };
+        htable_t *map = htable_create_ex(4, hash_int_counted, compare_int, NULL, &opts);
+        int ok = 1;
+
+        // Count key i % 64 over a stream that grows the table, one hash per occurrence.
+        hash_calls = 0;
+
+        for (int i = 0; i < 64 * 5; i++) {
+            void **slot = NULL;
+            const int rc = htable_get_or_insert(map, &keys[i % 64], &slot);
+
+            ok &= rc == (i < 64) && (rc == 0 || *slot == NULL);
+            *slot = (void *) ((uintptr_t) *slot + 1U);
+        }
+
+        TEST(ok && hash_calls == 64 * 5 && map->count == 64 && htable_get(map, &keys[7]) == (void *) (uintptr_t) 5U); // 1, 4, 7
+
+        // Updates insert, increment and remove in place.
+        htable_t *counts = htable_create_ex(4, hash_int, compare_int, NULL, &opts);
+
+        int rc = htable_update(counts, &keys[1], count_update, NULL);
+        rc = rc * 10 + htable_update(counts, &keys[1], count_update, NULL);
+
+        TEST(rc == 10 && htable_get(counts, &keys[1]) == (void *) (uintptr_t) 2U); // 2, 5, 8
+
+        (void) htable_update(counts, &keys[1], count_update, NULL);
+
+        TEST(htable_get(counts, &keys[1]) == NULL && counts->count == 0); // 3, 6, 9
+
+        htable_destroy(counts);
+        htable_destroy(map);
+    }
+
+    TEST(htable_get_or_insert(NULL, &keys[0], NULL) == -1); // 10
+}
+
+void test_htable_owned (void) {
+
+    const struct callbacks cbs = { .kcpy = copy_string_counted, .vcpy = copy_string_counted, .kfree = free, .vfree = free };
+    const enum htable_engine engines[] = { HTABLE_ENGINE_CHAIN, HTABLE_ENGINE_ROBIN_HOOD, HTABLE_ENGINE_SWISS };
+
+    for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++) {
+
+        struct htable_opts opts = { .engine = engines[e] };
+        htable_t *map = htable_create_ex(4, hash_string, compare_string, &cbs, &opts);
+        char *keys[HASH_MAX];
+        char *values[HASH_MAX];
+        int ok = 1;
+
+        // Handed over keys and values are stored as is, the copy callbacks never run.
+        copy_calls = 0;
+
+        for (int i = 0; i < HASH_MAX; i++) {
+            char buf[32];
+            (void) snprintf(buf, sizeof(buf), "owned:%d", i);
+            keys[i] = strdup(buf);
+            values[i] = strdup(buf);
+            ok &= htable_insert_owned(map, keys[i], values[i]) == 0;
+        }
+
+        TEST(ok && copy_calls == 0 && htable_get(map, "owned:3") == values[3]); // 1, 5, 9
+
+        // An equal key handed over again is freed, the stored key stays.
+        char *value = strdup("replaced");
+        (void) htable_insert_owned(map, strdup("owned:3"), value);
+
+        void *key = NULL;
+        void *taken = NULL;
+
+        TEST(htable_take(map, "owned:3", &key, &taken) == 0 && key == keys[3] && taken == value); // 2, 6, 10
+
+        free(key);
+        free(taken);
+
+        // Parts that are not asked for are freed by the table.
+        TEST(htable_take(map, "owned:4", NULL, &taken) == 0 && taken == values[4] && htable_get(map, "owned:4") == NULL); // 3, 7, 11
+        TEST(htable_take(map, "owned:4", &key, &taken) == -1 && map->count == HASH_MAX - 2); // 4, 8, 12
+
+        free(taken);
+        htable_destroy(map);
+    }
+
+    // Inline keys and values are taken out as copies, the hash node is freed with them.
+    const struct callbacks inline_cbs = { .kcpy = copy_string_counted, .kfree = free, .ksize = size_string, .vsize = size_int };
+    struct htable_opts opts = { .inline_size = 16 };
+    htable_t *map = htable_create_ex(4, hash_string, compare_string, &inline_cbs, &opts);
+    const int answer = 42;
+
+    (void) htable_insert(map, "inline", &answer);
+
+    void *key = NULL;
+    void *taken = NULL;
+
+    TEST(htable_take(map, "inline", &key, &taken) == 0 && strcmp(key, "inline") == 0 && *(int *) taken == 42); // 13
+
+    free(key);
+    free(taken);
+    htable_destroy(map);
+}
+
+// Rehash target, the identity hash of hash_int scrambled by a multiply.
+static unsigned long hash_int_scrambled (const void *key) {
+    return (unsigned long) *(const int *) key * 0x9E3779B97F4A7C15UL;
+}
+
+void test_htable_capacity (void) {
+
+    static int keys[HASH_MAX * 16];
+    const enum htable_engine engines[] = { HTABLE_ENGINE_CHAIN, HTABLE_ENGINE_ROBIN_HOOD, HTABLE_ENGINE_SWISS };
+
+    for (int i = 0; i < HASH_MAX * 16; i++) {
+        keys[i] = i;
+    }
+
+    for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++) {
+
+        struct htable_opts opts = { .engine = engines[e] };
+        htable_t *map = htable_create_ex(8, hash_int, compare_int, NULL, &opts);
+
+        // A reservation is migrated completely, the inserts that follow never resize.
+        const int rc = htable_reserve(map, HASH_MAX * 16);
+        const size_t reserved = map->size;
+        int found = 0;
+
+        for (int i = 0; i < HASH_MAX * 16; i++) {
+            (void) htable_insert(map, &keys[i], &keys[i]);
+        }
+
+        TEST(rc == 0 && map->rehash_table == NULL && map->size == reserved && reserved >= HASH_MAX * 16); // 1, 5, 9
+
+        // Remove all but a few keys and give the memory back, the chaining engine halving its original size.
+        for (int i = 8; i < HASH_MAX * 16; i++) {
+            (void) htable_remove(map, &keys[i]);
+        }
+
+        TEST(htable_shrink_to_fit(map) == 0 && map->size < reserved / 64U && (map->size & (map->size - 1U)) == 0); // 2, 6, 10
+
+        for (int i = 0; i < HASH_MAX * 16; i++) {
+            found += i < 8 ? htable_get(map, &keys[i]) == &keys[i] : htable_get(map, &keys[i]) == NULL;
+        }
+
+        TEST(found == HASH_MAX * 16 && map->rehash_table == NULL); // 3, 7, 11
+
+        // Swap in another hash function, every key is hashed again and stays reachable.
+        for (int i = 8; i < HASH_MAX; i++) {
+            (void) htable_insert(map, &keys[i], &keys[i]);
+        }
+
+        found = htable_rehash(map, hash_int_scrambled) == 0;
+
+        for (int i = 0; i < HASH_MAX; i++) {
+            found += htable_get(map, &keys[i]) == &keys[i];
+        }
+
+        TEST(found == HASH_MAX + 1 && map->hash == hash_int_scrambled); // 4, 8, 12
+
+        htable_destroy(map);
+    }
+}
+
+struct shard_args {
+    htable_shard_t *map;
+    int thread;
+    int bound;
+};
+
+void *shard_writer (void *arg) {
+
+    struct shard_args *args = arg;
+    const size_t shards = htable_shard_shards(args->map);
+
+    // Every writer owns the shards congruent to its number and runs on their node.
+    args->bound = htable_shard_bind(args->map, (size_t) args->thread % shards) == 0;
+
+    for (int i = 0; i < CONC_THREADS * CONC_KEYS; i++) {
+        if (htable_shard_of(args->map, &conc_keys[i]) % CONC_THREADS == (size_t) args->thread) {
+            (void) htable_shard_insert(args->map, &conc_keys[i], &conc_keys[i]);
+        }
+    }
+
+    for (int i = 0; i < CONC_THREADS * CONC_KEYS; i += 4) {
+        if (htable_shard_of(args->map, &conc_keys[i]) % CONC_THREADS == (size_t) args->thread) {
+            (void) htable_shard_remove(args->map, &conc_keys[i]);
+        }
+    }
+
+    return NULL;
+}
+
+void test_htable_shard (void) {
+
+    const struct htable_shard_opts shard_opts = { .shards = 6, .flags = HTABLE_SHARD_NUMA };
+    htable_shard_t *map = htable_shard_create(64, hash_int, compare_int, NULL, NULL, &shard_opts);
+
+    pthread_t writers[CONC_THREADS];
+    struct shard_args args[CONC_THREADS];
+    int found = 0;
+    int bound = 1;
+
+    TEST(map != NULL && htable_shard_shards(map) == 8); // 1
+
+    for (int t = 0; t < CONC_THREADS; t++) {
+        args[t] = (struct shard_args) { .map = map, .thread = t };
+        (void) pthread_create(&writers[t], NULL, shard_writer, &args[t]);
+    }
+
+    for (int t = 0; t < CONC_THREADS; t++) {
+        (void) pthread_join(writers[t], NULL);
+        bound &= args[t].bound == (htable_shard_node(map, (size_t) t) >= 0);
+    }
+
+    for (int i = 0; i < CONC_THREADS * CONC_KEYS; i++) {
+        int *result = htable_shard_get(map, &conc_keys[i]);
+        found += (i % 4 == 0) ? result == NULL : result != NULL && *result == i;
+    }
+
+    struct htable_shard_stats stats;
+
+    TEST(found == CONC_THREADS * CONC_KEYS && bound); // 2
+    TEST(htable_shard_stats(map, &stats) == 0 && stats.count == htable_shard_count(map) && stats.count == CONC_THREADS * CONC_KEYS * 3 / 4); // 3
+    TEST(stats.max_count >= stats.count / 8U && stats.max_count < stats.count / 4U && stats.buckets >= stats.count); // 4
+
+#if defined(HTABLE_STATS)
+    TEST(stats.collected && stats.table.lookups == CONC_THREADS * CONC_KEYS && stats.table.hits == stats.count); // 5
+#else
+    TEST(!stats.collected); // 5 (built without HTABLE_STATS)
+#endif
+
+    htable_shard_destroy(map);
+}
+
+// Eviction hook counting the evicted entries, values hold the index of their key.
+static void count_evict (const void *key, void *value, void *ctx) {
+    size_t *evicted = ctx;
+    char buf[32];
+
+    (void) snprintf(buf, sizeof(buf), "evict:%d", *(int *) value);
+    *evicted += strcmp(buf, key) == 0;
+}
+
+// Node allocator that fails once its budget of allocations is spent.
+static void *limited_alloc (void *ctx, size_t size) {
+    size_t *budget = ctx;
+    if (*budget == 0) {
+        return NULL;
+    }
+
+    (*budget)--;
+    return malloc(size);
+}
+
+static void limited_dealloc (void *ctx, void *ptr, size_t size) {
+    (void) ctx;
+    (void) size;
+    free(ptr);
+}
+
+// Eviction hook counting every call.
+static void count_calls (const void *key, void *value, void *ctx) {
+    (void) key;
+    (void) value;
+    (*(size_t *) ctx)++;
+}
+
+void test_htable_evict (void) {
+
+    const enum htable_engine engines[] = { HTABLE_ENGINE_CHAIN, HTABLE_ENGINE_ROBIN_HOOD, HTABLE_ENGINE_SWISS };
+    const struct callbacks cbs = { .kcpy = copy_string_counted, .vcpy = copy_int, .kfree = free, .vfree = free };
+
+    for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++) {
+
+        size_t evicted = 0;
+        struct htable_opts opts = { .engine = engines[e], .capacity = 32, .evict = count_evict, .evict_ctx = &evicted };
+        htable_t *map = htable_create_ex(8, hash_string, compare_string, &cbs, &opts);
+        char buf[32];
+        int ok = 1;
+
+        for (int i = 0; i < 32; i++) {
+            (void) snprintf(buf, sizeof(buf), "evict:%d", i);
+            (void) htable_insert(map, buf, &i);
+        }
+
+        TEST(map->count == 32 && evicted == 0); // 1, 6, 11
+
+        // Referenced keys are passed over once, the hand clears their bits before it could come back.
+        for (int i = 0; i < 8; i++) {
+            (void) snprintf(buf, sizeof(buf), "evict:%d", i);
+            ok &= htable_get(map, buf) != NULL;
+        }
+
+        for (int i = 32; i < 48; i++) {
+            (void) snprintf(buf, sizeof(buf), "evict:%d", i);
+            ok &= htable_insert(map, buf, &i) == 0 && map->count <= 32;
+        }
+
+        TEST(ok && map->count == 32 && evicted == 16); // 2, 7, 12
+
+        for (int i = 0; i < 8; i++) {
+            (void) snprintf(buf, sizeof(buf), "evict:%d", i);
+            ok &= htable_get(map, buf) != NULL;
+        }
+
+        TEST(ok); // 3, 8, 13
+
+        // Updating a present key never evicts.
+        (void) htable_insert(map, "evict:0", &(int){ 0 });
+
+        TEST(map->count == 32 && evicted == 16); // 4, 9, 14
+
+        struct htable_stats stats;
+        const int rc = htable_stats(map, &stats);
+
+#if defined(HTABLE_STATS)
+        TEST(rc == 0 && stats.evictions == 16); // 5, 10, 15
+#else
+        TEST(rc == -1); // 5, 10, 15 (built without HTABLE_STATS)
+#endif
+
+        htable_destroy(map);
+    }
+
+    // Readers under a shared lock would race on the reference bits, so the locked front-ends refuse a capacity.
+    const struct htable_opts opts = { .capacity = 32 };
+
+    TEST(htable_conc_create(64, 4, hash_string, compare_string, &cbs, &opts) == NULL); // 16
+    TEST(htable_shard_create(64, hash_string, compare_string, &cbs, &opts, NULL) == NULL); // 17
+
+    // The new hash node is allocated before a victim is chosen, so a failed allocation evicts nothing.
+    size_t budget = 4;
+    size_t lost = 0;
+    const struct htable_allocator limited = { .alloc = limited_alloc, .free = limited_dealloc, .ctx = &budget };
+    const struct htable_opts bounded = { .capacity = 4, .allocator = &limited, .evict = count_calls, .evict_ctx = &lost };
+    htable_t *map = htable_create_ex(8, hash_int, compare_int, NULL, &bounded);
+    static int keys[5] = { 0, 1, 2, 3, 4 };
+    int ok = 1;
+
+    for (int i = 0; i < 4; i++) {
+        ok &= htable_insert(map, &keys[i], &keys[i]) == 0;
+    }
+
+    TEST(ok && htable_insert(map, &keys[4], &keys[4]) == -2 && lost == 0 && map->count == 4); // 18
+
+    for (int i = 0; i < 4; i++) {
+        ok &= htable_get(map, &keys[i]) == &keys[i];
+    }
+
+    budget = 1;
+
+    TEST(ok && htable_insert(map, &keys[4], &keys[4]) == 0 && lost == 1 && map->count == 4); // 19
+
+    htable_destroy(map);
+}
+
+void test_htable_ttl (void) {
+
+    const struct callbacks cbs = { .kcpy = copy_string_counted, .vcpy = copy_int, .kfree = free, .vfree = free };
+    struct htable_opts opts = { .engine = HTABLE_ENGINE_ROBIN_HOOD };
+    htable_t *robin = htable_create_ex(8, hash_string, compare_string, &cbs, &opts);
+    htable_t *map = htable_create(8, hash_string, compare_string, &cbs);
+    const int one = 1;
+
+    TEST(htable_insert_ttl(robin, "key", &one, 10) == -1 && htable_expire(robin) == 0); // 1
+    TEST(htable_insert_ttl(map, "key", &one, 0) == -1 && htable_insert_ttl(map, "key", &one, HTABLE_TTL_MAX_MS + 1U) == -1); // 2
+
+    htable_destroy(robin);
+
+    (void) htable_insert_ttl(map, "short", &one, 1);
+    (void) htable_insert_ttl(map, "long", &one, 100000);
+    (void) htable_insert_ttl(map, "rewritten", &one, 1);
+    (void) htable_insert_ttl(map, "persisted", &one, 1);
+    (void) htable_insert(map, "persisted", &one);
+    (void) htable_insert(map, "plain", &one);
+
+    sleep_ms(5);
+
+    // Expired entries are hidden at once but only freed by a write to their key or by htable_expire.
+    TEST(htable_get(map, "short") == NULL && htable_get(map, "long") != NULL && map->count == 5); // 3
+
+    (void) htable_insert(map, "rewritten", &one);
+
+    TEST(htable_get(map, "rewritten") != NULL && map->count == 5); // 4
+    TEST(htable_expire(map) == 1 && map->count == 4 && htable_get(map, "persisted") != NULL); // 5
+
+    // Timers of the upper wheel levels cascade down before they come due.
+    static int keys[HASH_MAX];
+    char buf[32];
+    int ok = 1;
+    size_t freed = 0;
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        keys[i] = i;
+        (void) snprintf(buf, sizeof(buf), "ttl:%d", i);
+        ok &= htable_insert_ttl(map, buf, &keys[i], i % 2 == 0 ? 70 : 100000) == 0;
+    }
+
+    for (int round = 0; round < 10 && freed < HASH_MAX / 2; round++) {
+        sleep_ms(20);
+        freed += htable_expire(map);
+    }
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        (void) snprintf(buf, sizeof(buf), "ttl:%d", i);
+        ok &= (htable_get(map, buf) == NULL) == (i % 2 == 0);
+    }
+
+    TEST(ok && freed == HASH_MAX / 2 && map->count == 4 + HASH_MAX / 2); // 6
+
+    // Move the clock 3 * 2^30 milliseconds ahead by moving back the epoch, the first member of the timing wheel.
+    // Entries left untouched for longer than 2^31 milliseconds stay expired.
+    *(unsigned long long *) (void *) map->wheel -= (3ULL << 30U) * 1000000ULL;
+
+    TEST(htable_get(map, "long") == NULL && htable_get(map, "ttl:1") == NULL && htable_get(map, "plain") != NULL); // 7
+
+    htable_destroy(map);
+}
+
+static atomic_size_t async_frees;
+
+// Free callback of the background teardown, which runs on another thread.
+static void free_async_counted (void *src) {
+    atomic_fetch_add(&async_frees, 1U);
+    free(src);
+}
+
+void test_htable_destroy_async (void) {
+
+    const struct callbacks cbs = { .kcpy = copy_int, .vcpy = copy_int, .kfree = free_async_counted, .vfree = free_async_counted };
+    struct htable_opts opts = { .flags = HTABLE_SLAB };
+    htable_t *maps[2] = { htable_create(8, hash_int, compare_int, &cbs), htable_create_ex(8, hash_int, compare_int, &cbs, &opts) };
+    int rc = 0;
+
+    for (int i = 0; i < HASH_MAX * 16; i++) {
+        (void) htable_insert(maps[0], &i, &i);
+        (void) htable_insert(maps[1], &i, &i);
+    }
+
+    atomic_store(&async_frees, 0U);
+
+    // Both tables are handed over at once, the slab table frees its nodes in bulk.
+    rc |= htable_destroy_async(maps[0]);
+    rc |= htable_destroy_async(maps[1]);
+
+    htable_destroy_wait();
+
+    TEST(rc == 0 && atomic_load(&async_frees) == HASH_MAX * 16 * 4); // 1
+    TEST(htable_destroy_async(NULL) == 0); // 2
+
+    // Snapshots are detached on the calling thread, the teardown never touches what they are reading.
+    static int keys[HASH_MAX];
+    htable_t *map = htable_create(8, hash_int, compare_int, NULL);
+    int found = 0;
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        keys[i] = i;
+        (void) htable_insert(map, &keys[i], &keys[i]);
+    }
+
+    htable_snapshot_t *snap = htable_snapshot(map);
+
+    rc = htable_destroy_async(map);
+
+    for (int i = 0; snap != NULL && i < HASH_MAX; i++) {
+        found += htable_snapshot_get(snap, &keys[i]) == &keys[i];
+    }
+
+    TEST(rc == 0 && found == HASH_MAX && htable_snapshot_count(snap) == HASH_MAX); // 3
+
+    htable_destroy_wait();
+    htable_snapshot_release(snap);
+}
+
+void test_htable_multi (void) {
+
+    const struct callbacks cbs = { .kcpy = copy_int, .vcpy = copy_int, .kfree = free, .vfree = free };
+    struct htable_opts opts = { .flags = HTABLE_MULTI };
+    htable_t *map = htable_create_ex(4, hash_int, compare_int, &cbs, &opts);
+    htable_t *plain = htable_create(4, hash_int, compare_int, &cbs);
+    int ok = 1;
+
+    opts.engine = HTABLE_ENGINE_SWISS;
+
+    TEST(htable_create_ex(4, hash_int, compare_int, &cbs, &opts) == NULL && htable_insert_multi(plain, &ok, &ok) == -1); // 1
+
+    // Every even key gets as many values as its index, enough to grow the value array several times.
+    for (int key = 0; key < 64; key += 2) {
+        for (int value = 0; value < key; value++) {
+            ok &= htable_insert_multi(map, &key, &value) == 0;
+        }
+    }
+
+    TEST(ok && map->count == 31); // 2
+
+    size_t n = 0;
+    void *const *values = htable_get_all(map, &(int){ 62 }, &n);
+
+    for (size_t idx = 0; values != NULL && idx < n; idx++) {
+        ok &= *(int *) values[idx] == (int) idx;
+    }
+
+    TEST(ok && n == 62 && htable_count_key(map, &(int){ 2 }) == 2); // 3
+    TEST(htable_get_all(map, &(int){ 3 }, &n) == NULL && n == 0 && htable_count_key(map, &(int){ 0 }) == 0); // 4
+
+    // Removing a key drops all its values at once.
+    TEST(htable_remove(map, &(int){ 62 }) == 0 && htable_count_key(map, &(int){ 62 }) == 0 && map->count == 30); // 5
+
+    // The single-value writes would store a plain value where the value array belongs.
+    int key = 2;
+    const void *batch[1] = { &key };
+    void **slot = NULL;
+
+    TEST(htable_insert(map, &key, &ok) == -1 && htable_insert_owned(map, &key, &ok) == -1); // 6
+    TEST(htable_insert_ttl(map, &key, &ok, 100) == -1 && htable_insert_n(map, "key", 3, &ok) == -1 && htable_insert_many(map, batch, batch, 1) == -1); // 7
+    TEST(htable_get_or_insert(map, &key, &slot) == -1 && htable_update(map, &key, count_update, NULL) == -1 && htable_count_key(map, &key) == 2); // 8
+
+    opts = (struct htable_opts) { .flags = HTABLE_MULTI };
+
+    TEST(htable_conc_create(64, 4, hash_int, compare_int, &cbs, &opts) == NULL && htable_shard_create(64, hash_int, compare_int, &cbs, &opts, NULL) == NULL); // 9
+
+    htable_destroy(plain);
+    htable_destroy(map);
+}
+
+void test_htable_probe (void) {
+
+    static int keys[HASH_MAX * 2];
+    static const void *build[HASH_MAX];
+    static const void *probes[HASH_MAX * 2];
+    static unsigned long hashes[HASH_MAX * 2];
+    static size_t sel[HASH_MAX * 2];
+    static size_t part_sel[HASH_MAX * 2];
+    static void *values[HASH_MAX * 2];
+    static void *part_values[HASH_MAX * 2];
+
+    // The odd keys are built, the probe column holds every key in reverse.
+    for (int i = 0; i < HASH_MAX * 2; i++) {
+        keys[i] = i;
+    }
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        build[i] = &keys[2 * i + 1];
+    }
+
+    for (int i = 0; i < HASH_MAX * 2; i++) {
+        probes[i] = &keys[HASH_MAX * 2 - 1 - i];
+        hashes[i] = hash_int(probes[i]);
+    }
+
+    htable_t *map = htable_build(build, build, HASH_MAX, hash_int, compare_int, NULL, NULL);
+    size_t found = htable_probe_batch(map, probes, hashes, HASH_MAX * 2, sel, values);
+    int ok = 1;
+
+    for (size_t idx = 0; idx < found; idx++) {
+        ok &= sel[idx] == 2U * idx && values[idx] == probes[sel[idx]];
+    }
+
+    TEST(ok && found == HASH_MAX); // 1
+
+    // Partitioned builds, with 8 partitions and sized automatically, match the single table probe for probe.
+    htable_part_t *part = htable_part_build(build, build, HASH_MAX, hash_int, compare_int, NULL, NULL, 3);
+    htable_part_t *auto_part = htable_part_build(build, build, HASH_MAX, hash_int, compare_int, NULL, NULL, 0);
+    size_t count = 0;
+
+    for (size_t p = 0; part != NULL && p < part->partitions; p++) {
+        count += part->tables[p]->count;
+        ok &= part->tables[p]->count < HASH_MAX / 2;
+    }
+
+    TEST(ok && part->partitions == 8 && count == HASH_MAX && auto_part->partitions == 1); // 2
+
+    const size_t part_found = htable_part_probe_batch(part, probes, hashes, HASH_MAX * 2, part_sel, part_values);
+
+    ok &= memcmp(sel, part_sel, found * sizeof(sel[0])) == 0 && memcmp(values, part_values, found * sizeof(values[0])) == 0;
+
+    TEST(ok && part_found == found && htable_part_probe_batch(auto_part, probes, hashes, HASH_MAX * 2, part_sel, NULL) == found); // 3
+    TEST(htable_part_get(part, &keys[7]) == &keys[7] && htable_part_get(part, &keys[8]) == NULL); // 4
+
+    htable_part_destroy(part);
+    htable_part_destroy(auto_part);
+    htable_destroy(map);
+}
+
+void sum_snapshot (const void *key, void *value, void *ctx) {
+    (void) key;
+    *(long *) ctx += *(int *) value;
+}
+
+void test_htable_snapshot (void) {
+
+    const struct callbacks cbs = { .kcpy = copy_string_counted, .vcpy = copy_int, .kfree = free, .vfree = free, .ksize = size_string, .vsize = size_int };
+    struct htable_opts opts = { .inline_size = 0 };
+
+    // 1-5, 6-10: keys and values owned by the table, then stored inline in the hash nodes.
+    for (size_t inline_size = 0; inline_size <= 16; inline_size += 16) {
+
+        opts.inline_size = inline_size;
+
+        htable_t *map = htable_create_ex(HASH_MAX, hash_string, compare_string, &cbs, &opts);
+        char keys[HASH_MAX][16];
+        int ok = 1;
+
+        for (int i = 0; i < HASH_MAX; i++) {
+            (void) snprintf(keys[i], sizeof(keys[i]), "key:%d", i);
+            (void) htable_insert(map, keys[i], &i);
+        }
+
+        htable_snapshot_t *snap = htable_snapshot(map);
+        const int minus = -1;
+
+        // Replace the even keys, remove every third key and add new ones, the snapshot keeps the old picture.
+        for (int i = 0; i < HASH_MAX; i++) {
+            if (i % 2 == 0) {
+                (void) htable_insert(map, keys[i], &minus);
+            }
+            if (i % 3 == 0) {
+                (void) htable_remove(map, keys[i]);
+            }
+        }
+
+        (void) htable_insert(map, "new", &minus);
+
+        for (int i = 0; i < HASH_MAX; i++) {
+            const int *old = htable_snapshot_get(snap, keys[i]);
+            const int *now = htable_get(map, keys[i]);
+
+            ok &= old != NULL && *old == i;
+            ok &= i % 3 == 0 ? now == NULL : *now == (i % 2 == 0 ? -1 : i);
+        }
+
+        TEST(ok && htable_snapshot_get(snap, "new") == NULL && htable_get(map, "new") != NULL); // 1, 6
+
+        long sum = 0;
+
+        htable_snapshot_for_each(snap, sum_snapshot, &sum);
+
+        TEST(htable_snapshot_count(snap) == HASH_MAX && sum == (long) HASH_MAX * (HASH_MAX - 1) / 2); // 2, 7
+
+        // A second snapshot sees the table as it is now, while the first one is still attached.
+        htable_snapshot_t *later = htable_snapshot(map);
+
+        (void) htable_remove(map, keys[1]);
+
+        TEST(htable_snapshot_get(later, keys[0]) == NULL && *(int *) htable_snapshot_get(later, keys[1]) == 1); // 3, 8
+
+        // Resizing copies every shared bucket, the snapshots then stand alone and outlive the table.
+        TEST(htable_reserve(map, HASH_MAX * 8) == 0 && *(int *) htable_snapshot_get(snap, keys[0]) == 0); // 4, 9
+
+        htable_destroy(map);
+
+        ok = htable_snapshot_count(later) == HASH_MAX - (HASH_MAX + 2) / 3 + 1;
+
+        for (int i = 0; i < HASH_MAX; i++) {
+            const int *old = htable_snapshot_get(snap, keys[i]);
+            ok &= old != NULL && *old == i;
+        }
+
+        TEST(ok); // 5, 10
+
+        htable_snapshot_release(later);
+        htable_snapshot_release(snap);
+    }
+
+    opts.engine = HTABLE_ENGINE_SWISS;
+
+    htable_t *swiss = htable_create_ex(4, hash_string, compare_string, NULL, &opts);
+
+    TEST(htable_snapshot(swiss) == NULL && htable_snapshot(NULL) == NULL && htable_snapshot_count(NULL) == 0); // 11
+
+    htable_destroy(swiss);
+
+    // Owned keys and values under the default copy callbacks would be freed by the table under the snapshot.
+    const struct callbacks owning = { .kfree = free, .vfree = free };
+    htable_t *owned = htable_create(4, hash_string, compare_string, &owning);
+    int ok = htable_insert_owned(owned, copy_string_counted("owned"), copy_int(&(int){ 1 })) == 0;
+
+    TEST(ok && htable_snapshot(owned) == NULL); // 12
+
+    htable_destroy(owned);
+
+    // With copying callbacks the snapshot keeps its own copy of an owned entry that is overwritten and removed.
+    owned = htable_create(4, hash_string, compare_string, &cbs);
+    ok = htable_insert_owned(owned, copy_string_counted("owned"), copy_int(&(int){ 1 })) == 0;
+
+    htable_snapshot_t *snap = htable_snapshot(owned);
+
+    ok &= snap != NULL && htable_insert_owned(owned, copy_string_counted("owned"), copy_int(&(int){ 2 })) == 0;
+    ok &= htable_remove(owned, "owned") == 0;
+
+    TEST(ok && *(int *) htable_snapshot_get(snap, "owned") == 1 && htable_get(owned, "owned") == NULL); // 13
+
+    htable_snapshot_release(snap);
+    htable_destroy(owned);
+}
+
+/// @brief Seeded hash that floods a single bucket under seed 42, like a user hash an attacker has worked out.
+unsigned long hash_int_flooded (const void *key, unsigned long long seed) {
+    return seed == 42U ? 7U : htable_hash_u32_seeded(key, seed);
+}
+
+// Stored hash of the first hash node of a chaining table, 0 if it is empty.
+static unsigned long first_hash (const htable_t *map) {
+    for (size_t idx = 0; idx < map->size; idx++) {
+        if (map->table[idx] != NULL) {
+            return map->table[idx]->hash;
+        }
+    }
+
+    return 0;
+}
+
+void test_htable_seed (void) {
+
+    struct htable_opts opts = { .seeded_hash = htable_hash_u32_seeded };
+    htable_t *seeded = htable_create_ex(64, NULL, htable_keq_u32, NULL, &opts);
+    htable_t *other = htable_create_ex(64, NULL, htable_keq_u32, NULL, &opts);
+    uint32_t keys[HASH_MAX];
+    int ok = 1;
+
+    for (uint32_t i = 0; i < HASH_MAX; i++) {
+        keys[i] = i;
+        ok &= htable_insert(seeded, &keys[i], &keys[i]) == 0 && htable_insert(other, &keys[i], &keys[i]) == 0;
+    }
+
+    // Every table draws its own seed, so the same keys land in different buckets.
+    TEST(ok && seeded->seed != 0 && other->seed != 0 && seeded->seed != other->seed); // 1
+    TEST(htable_reseed(seeded) == 0 && *(uint32_t *) htable_get(seeded, &keys[HASH_MAX - 1]) == HASH_MAX - 1); // 2
+    TEST(htable_reseed(NULL) == -1 && htable_save(seeded, 1) == -1); // 3
+
+    // A flooded chain re-seeds the table on the next insert.
+    opts = (struct htable_opts) { .seeded_hash = hash_int_flooded, .seed = 42U, .max_chain = 8, .flags = HTABLE_FIXED_SIZE };
+
+    htable_t *flooded = htable_create_ex(HASH_MAX, NULL, htable_keq_u32, NULL, &opts);
+
+    for (uint32_t i = 0; i < 16; i++) {
+        (void) htable_insert(flooded, &keys[i], &keys[i]);
+    }
+
+    for (uint32_t i = 0; i < HASH_MAX; i++) {
+        ok &= (htable_get(flooded, &keys[i]) != NULL) == (i < 16);
+    }
+
+    TEST(ok && flooded->seed != 42U && longest_chain(flooded) < 8 && flooded->count == 16); // 4
+
+#if defined(HTABLE_STATS)
+    struct htable_stats stats;
+
+    TEST(htable_stats(flooded, &stats) == 0 && stats.reseeds == 1); // 5
+#else
+    TEST(htable_stats(flooded, NULL) == -1); // 5 (built without HTABLE_STATS)
+#endif
+
+    // Re-seeding needs a seeded hash and chains, and builds draw the seed their hashes were computed with.
+    opts = (struct htable_opts) { .max_chain = 8 };
+    TEST(htable_create_ex(4, hash_int, compare_int, NULL, &opts) == NULL && htable_create_ex(4, NULL, compare_int, NULL, NULL) == NULL); // 6
+
+    const void *build[HASH_MAX];
+
+    for (uint32_t i = 0; i < HASH_MAX; i++) {
+        build[i] = &keys[i];
+    }
+
+    opts = (struct htable_opts) { .seeded_hash = htable_hash_u32_seeded };
+
+    htable_t *built = htable_build(build, build, HASH_MAX, NULL, htable_keq_u32, NULL, &opts);
+
+    for (uint32_t i = 0; built != NULL && i < HASH_MAX; i++) {
+        ok &= htable_get(built, &keys[i]) != NULL;
+    }
+
+    TEST(ok && built->seed != 0 && built->count == HASH_MAX); // 7
+
+    // Stripes and shards share the seed the front-end hashes with, and leave max_chain to plain tables.
+    opts = (struct htable_opts) { .seeded_hash = htable_hash_u32_seeded, .max_chain = 8 };
+
+    htable_conc_t *conc = htable_conc_create(64, 16, htable_hash_u32, htable_keq_u32, NULL, &opts);
+    htable_shard_t *shard = htable_shard_create(64, htable_hash_u32, htable_keq_u32, NULL, &opts, NULL);
+
+    for (uint32_t i = 0; conc != NULL && shard != NULL && i < HASH_MAX; i++) {
+        ok &= htable_conc_insert(conc, &keys[i], &keys[i]) == 0 && htable_shard_insert(shard, &keys[i], &keys[i]) == 0;
+    }
+
+    for (uint32_t i = 0; conc != NULL && shard != NULL && i < HASH_MAX; i++) {
+        ok &= htable_conc_get(conc, &keys[i]) == &keys[i] && htable_shard_get(shard, &keys[i]) == &keys[i];
+    }
+
+    TEST(ok && conc != NULL && htable_conc_count(conc) == HASH_MAX); // 8
+    TEST(shard != NULL && htable_shard_count(shard) == HASH_MAX); // 9
+
+    htable_shard_destroy(shard);
+    htable_conc_destroy(conc);
+
+    // Length-aware keys are hashed under the seed as well, and re-seeding rehashes them.
+    opts = (struct htable_opts) { .seeded_hash = htable_hash_u32_seeded, .seed = 1U };
+    htable_t *bytes = htable_create_ex(64, NULL, htable_keq_u32, NULL, &opts);
+
+    (void) htable_insert_n(bytes, "length-aware", 12, &keys[1]);
+
+    TEST(first_hash(bytes) == htable_hash_bytes("length-aware", 12, 1U)); // 10
+
+    ok = htable_reseed(bytes) == 0 && htable_get_n(bytes, "length-aware", 12) == &keys[1];
+    ok &= htable_reserve(bytes, 1U) == 0 && first_hash(bytes) == htable_hash_bytes("length-aware", 12, bytes->seed);
+
+    TEST(ok); // 11
+
+    // A custom hash_n takes no seed, so re-seeding could never break its chains.
+    opts = (struct htable_opts) { .seeded_hash = htable_hash_u32_seeded, .hash_n = hash_n_const, .max_chain = 8 };
+
+    TEST(htable_create_ex(4, NULL, htable_keq_u32, NULL, &opts) == NULL); // 12
+
+    // Re-seeding leaves the work to the migration steps, keys still in the previous array are found the previous way.
+    ok = htable_reseed(seeded) == 0 && seeded->rehash_table != NULL && seeded->rehash_idx == 0;
+
+    for (uint32_t i = 0; i < HASH_MAX; i++) {
+        ok &= i % 2 == 0 ? htable_remove(seeded, &keys[i]) == 0 : htable_get(seeded, &keys[i]) == &keys[i];
+    }
+
+    TEST(ok && seeded->rehash_table == NULL && seeded->count == HASH_MAX / 2); // 13
+
+    for (size_t idx = 0; idx < seeded->size; idx++) {
+        for (const struct htable_node *node = seeded->table[idx]; node != NULL; node = node->next) {
+            ok &= node->hash == htable_hash_u32_seeded(node->key, seeded->seed);
+        }
+    }
+
+    TEST(ok); // 14
+
+    htable_destroy(bytes);
+    htable_destroy(built);
+    htable_destroy(flooded);
+    htable_destroy(other);
+    htable_destroy(seeded);
+}
+
+void test_htable_compact (void) {
+
+    struct htable_opts opts = { .engine = HTABLE_ENGINE_COMPACT };
+    htable_t *map = htable_create_ex(4, hash_int_clustered, compare_int, NULL, &opts);
+
+    static int keys[HASH_MAX];
+    int ok = 1;
+
+    TEST(map != NULL && map->heads != NULL && map->table == NULL); // 1
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        keys[i] = i;
+        ok &= htable_insert(map, &keys[i], &keys[i]) == 0;
+    }
+
+    TEST(ok && map->count == HASH_MAX && map->size == HASH_MAX); // 2
+
+    // Removing from the front keeps moving the last entry into the hole, clustered keys share their chains.
+    for (int i = 0; i < HASH_MAX; i += 3) {
+        ok &= htable_remove(map, &keys[i]) == 0;
+    }
+
+    for (int i = 0; i < HASH_MAX; i++) {
+        const int *result = htable_get(map, &keys[i]);
+        ok &= i % 3 == 0 ? result == NULL : result != NULL && *result == i;
+    }
+
+    TEST(ok && map->count == HASH_MAX - (HASH_MAX + 2) / 3); // 3
+
+    // The slots stay dense, every one below the count holds an entry.
+    atomic_int visited = 0;
+
+    TEST(htable_for_each_parallel(map, 2, scan_count, &visited) == 0 && (size_t) visited == map->count && htable_remove(map, &keys[0]) == -1); // 4
+
+    void *key = NULL;
+    void *value = NULL;
+
+    TEST(htable_take(map, &keys[1], &key, &value) == 0 && key == &keys[1] && value == &keys[1] && htable_get(map, &keys[1]) == NULL); // 5
+
+    // Shrinking and rehashing rebuild the bucket heads from the stored hashes.
+    TEST(htable_shrink_to_fit(map) == 0 && map->size == HASH_MAX && htable_rehash(map, hash_int) == 0); // 6
+
+    for (int i = 2; i < HASH_MAX; i++) {
+        const int *result = htable_get(map, &keys[i]);
+        ok &= i % 3 == 0 ? result == NULL : result != NULL && *result == i;
+    }
+
+    TEST(ok); // 7
+
+    // Only a load of at most 1 fits the slots, and inline storage needs entries that never move.
+    opts.max_load = 1.5f;
+    TEST(htable_create_ex(4, hash_int, compare_int, NULL, &opts) == NULL); // 8
+
+    opts = (struct htable_opts) { .engine = HTABLE_ENGINE_COMPACT, .inline_size = 16 };
+    TEST(htable_create_ex(4, hash_int, compare_int, NULL, &opts) == NULL); // 9
+
+    htable_destroy(map);
+}
+
 // --- Main function to run the unit tests --- //
 
 int main (void) {
@@ -202,6 +2308,38 @@ int main (void) {
     test_htable_insert_string();
     test_htable_collision_int();
     test_htable_collision_string();
+    test_htable_resize_int();
+    test_htable_fixed_size();
+    test_htable_cached_hash();
+    test_htable_robin_hood();
+    test_htable_robin_hood_full();
+    test_htable_swiss();
+    test_htable_slab();
+    test_htable_allocator();
+    test_htable_pow2_mix();
+    test_htable_batch();
+    test_htable_conc();
+    test_htable_rcu();
+    test_htable_tmpl();
+    test_htable_inline();
+    test_htable_build();
+    test_htable_image();
+    test_htable_scan();
+    test_htable_stats();
+    test_htable_hash();
+    test_htable_keys_n();
+    test_htable_upsert();
+    test_htable_owned();
+    test_htable_capacity();
+    test_htable_shard();
+    test_htable_evict();
+    test_htable_ttl();
+    test_htable_destroy_async();
+    test_htable_multi();
+    test_htable_probe();
+    test_htable_snapshot();
+    test_htable_seed();
+    test_htable_compact();
 
     printf("Passed: %d, Failed: %d\n", passed, test_index - passed);
 